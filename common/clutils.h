@@ -0,0 +1,163 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Host helpers shared by the examples: event timing, kernel sources and the
+ * programs of the kernels that are only needed by one mode. The hosts include
+ * this file after the OpenCL header.
+ */
+
+#ifndef COMMON_CLUTILS_H
+#define COMMON_CLUTILS_H
+
+#include <algorithm>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "kernelinfo.h"
+
+inline long getTime(cl_event event) {
+    clWaitForEvents(1, &event);
+    cl_ulong time_start, time_end;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
+    return (time_end - time_start);
+}
+
+inline char *readsource(const char *sourceFilename) {
+    FILE *fp;
+    int err;
+    int size;
+    char *source;
+
+    fp = fopen(sourceFilename, "rb");
+
+    if (fp == NULL) {
+        printf("Could not open kernel file: %s\n", sourceFilename);
+        exit(-1);
+    }
+
+    err = fseek(fp, 0, SEEK_END);
+
+    if (err != 0) {
+        printf("Error seeking to end of file\n");
+        exit(-1);
+
+    }
+    size = ftell(fp);
+
+    if (size < 0) {
+        printf("Error getting file position\n");
+        exit(-1);
+    }
+
+    err = fseek(fp, 0, SEEK_SET);
+    if (err != 0) {
+        printf("Error seeking to start of file\n");
+        exit(-1);
+
+    }
+
+    source = (char *) malloc(size + 1);
+
+    if (source == NULL) {
+        printf("Error allocating %d bytes for the program source\n", size + 1);
+        exit(-1);
+    }
+
+    err = fread(source, 1, size, fp);
+    if (err != size) {
+        printf("only read %d bytes\n", err);
+        exit(0);
+    }
+
+    source[size] = '\0';
+    return source;
+}
+
+inline double median(std::vector<long> data) {
+    if (data.empty()) {
+        return 0;
+    } else {
+        std::sort(data.begin(), data.end());
+        if (data.size() % 2 == 0) {
+            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
+        } else {
+            return double(data[data.size() / 2]);
+        }
+    }
+}
+
+inline double median(std::vector<double> data) {
+    if (data.empty()) {
+        return 0;
+    } else {
+        std::sort(data.begin(), data.end());
+        if (data.size() % 2 == 0) {
+            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
+        } else {
+            return double(data[data.size() / 2]);
+        }
+    }
+}
+
+// Builds an additional program from the concatenation of `count` source files,
+// for kernels that are only needed by one mode (e.g. storage.cl with
+// --storage). With `report`, prints the resources of its kernels
+// (--kernel-report). The sources must be freed by the caller.
+inline cl_program buildProgramFromFiles(cl_context context, cl_device_id device, int count, const char **fileNames, const char *options, bool report, char **programSources, cl_int *status) {
+    for (int i = 0; i < count; i++) {
+        programSources[i] = readsource(fileNames[i]);
+    }
+    cl_program extraProgram = clCreateProgramWithSource(context, count, (const char **) programSources, NULL, status);
+    if (CL_SUCCESS != *status) {
+        std::cout << "Error in clCreateProgramWithSource" << std::endl;
+        return NULL;
+    }
+    *status = clBuildProgram(extraProgram, 1, &device, options, NULL, NULL);
+    if (CL_SUCCESS != *status) {
+        std::cout << "Error in clBuildProgram, " << fileNames[count - 1] << std::endl;
+        printBuildLog(extraProgram, device);
+        return NULL;
+    }
+    if (report) {
+        printProgramReport(extraProgram, device, fileNames[count - 1]);
+    }
+    return extraProgram;
+}
+
+inline cl_program buildProgramFromFile(cl_context context, cl_device_id device, const char *fileName, const char *options, bool report, char **programSource, cl_int *status) {
+    return buildProgramFromFiles(context, device, 1, &fileName, options, report, programSource, status);
+}
+
+#endif
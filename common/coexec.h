@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Co-execution of a data-parallel job on the OpenCL devices and on host worker
+ * threads (--coexec). The job is a range of items, records or matrix rows.
+ * Every worker owns a deque of items, a range it takes chunks from the front
+ * of, and an idle worker steals the back half of the largest range left. A
+ * worker sizes its chunks from its own throughput so that one takes about
+ * COEXEC_CHUNK_TARGET_NS. The hosts include this file after the OpenCL header
+ * and build with -pthread.
+ */
+
+#ifndef COMMON_COEXEC_H
+#define COMMON_COEXEC_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+const double COEXEC_CHUNK_TARGET_NS = 2e6;
+
+// A worker of the co-execution: an OpenCL device or a host thread, with its
+// deque of items [begin, end)
+struct CoexecWorker {
+    std::string name;
+    bool device;
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem d_input;
+    cl_mem d_output;
+    // Largest chunk (the items the device buffers hold), the chunk before the
+    // first throughput estimate and the smallest chunk
+    size_t capacity;
+    size_t firstChunk;
+    size_t minChunk;
+    // Items per ns of the last chunk; before the first one, the estimate of
+    // the device profile or 0
+    double throughput;
+    double profiledThroughput;
+    size_t items;
+    size_t chunks;
+    size_t steals;
+    double busyTime;
+};
+
+// Runs the items [begin, end) on the worker
+typedef cl_int (*CoexecChunkFunction)(CoexecWorker &worker, size_t begin, size_t end);
+
+inline size_t coexecChunkSize(const CoexecWorker &worker) {
+    size_t chunk = worker.firstChunk;
+    if (worker.throughput > 0) {
+        chunk = std::max(worker.minChunk, (size_t) (worker.throughput * COEXEC_CHUNK_TARGET_NS));
+    }
+    return std::min(chunk, worker.capacity);
+}
+
+// Takes the next chunk from the front of the worker's own deque
+inline bool takeChunk(CoexecWorker &worker, size_t *begin, size_t *end) {
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (worker.begin >= worker.end) {
+        return false;
+    }
+    *begin = worker.begin;
+    *end = std::min(worker.end, worker.begin + coexecChunkSize(worker));
+    worker.begin = *end;
+    return true;
+}
+
+// Moves the back half of the largest deque to the empty deque of the thief
+inline bool stealWork(std::vector<CoexecWorker> &workers, int thief) {
+    while (true) {
+        int victim = -1;
+        size_t largest = 0;
+        for (size_t w = 0; w < workers.size(); w++) {
+            std::lock_guard<std::mutex> guard(workers[w].lock);
+            size_t left = workers[w].end - workers[w].begin;
+            if ((int) w != thief && left > largest) {
+                victim = w;
+                largest = left;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+        size_t begin;
+        size_t end;
+        {
+            std::lock_guard<std::mutex> guard(workers[victim].lock);
+            size_t left = workers[victim].end - workers[victim].begin;
+            if (left == 0) {
+                // Taken by its owner or by another thief in the meantime
+                continue;
+            }
+            end = workers[victim].end;
+            begin = left < 2 * workers[victim].minChunk ? workers[victim].begin : workers[victim].begin + left / 2;
+            workers[victim].end = begin;
+        }
+        std::lock_guard<std::mutex> guard(workers[thief].lock);
+        workers[thief].begin = begin;
+        workers[thief].end = end;
+        workers[thief].steals++;
+        return true;
+    }
+}
+
+inline void runCoexecWorker(std::vector<CoexecWorker> *workers, int id, CoexecChunkFunction processChunk, cl_int *status) {
+    CoexecWorker &worker = (*workers)[id];
+    size_t begin;
+    size_t end;
+    while (takeChunk(worker, &begin, &end) || (stealWork(*workers, id) && takeChunk(worker, &begin, &end))) {
+        auto start = std::chrono::high_resolution_clock::now();
+        cl_int chunkStatus = processChunk(worker, begin, end);
+        double time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+        if (CL_SUCCESS != chunkStatus) {
+            *status = chunkStatus;
+            return;
+        }
+        worker.throughput = time > 0 ? (end - begin) / time : 0;
+        worker.items += end - begin;
+        worker.chunks++;
+        worker.busyTime += time;
+    }
+}
+
+// Runs processChunk on the items [0, n) with the workers [first, last), each
+// starting with an equal share, and returns the wall time
+inline double runCoexecConfiguration(std::vector<CoexecWorker> &workers, int first, int last, size_t n, CoexecChunkFunction processChunk, cl_int *status) {
+    int active = last - first;
+    for (int w = 0; w < (int) workers.size(); w++) {
+        int share = w - first;
+        workers[w].begin = w >= first && w < last ? n * share / active : 0;
+        workers[w].end = w >= first && w < last ? n * (share + 1) / active : 0;
+        workers[w].throughput = workers[w].profiledThroughput;
+        workers[w].items = 0;
+        workers[w].chunks = 0;
+        workers[w].steals = 0;
+        workers[w].busyTime = 0;
+    }
+    *status = CL_SUCCESS;
+    std::vector<cl_int> workerStatus(workers.size(), CL_SUCCESS);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int w = first; w < last; w++) {
+        threads.push_back(std::thread(runCoexecWorker, &workers, w, processChunk, &workerStatus[w]));
+    }
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    double wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+    for (int w = first; w < last; w++) {
+        *status |= workerStatus[w];
+    }
+    return wallTime;
+}
+
+// Items, chunks, steals and busy time of every worker of the last configuration
+inline void printCoexecWorkers(const std::vector<CoexecWorker> &workers, size_t n, const char *unit) {
+    for (size_t w = 0; w < workers.size(); w++) {
+        const CoexecWorker &worker = workers[w];
+        std::cout << "  " << worker.name << ": " << worker.items << " " << unit << " (" << 100.0 * worker.items / n << "%), "
+                  << worker.chunks << " chunks of " << (worker.chunks > 0 ? worker.items / worker.chunks : 0) << " on average, "
+                  << worker.steals << " steals, busy " << worker.busyTime << " (ns)" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Generation of the input data of the examples (--seed <n>). The hosts include
+ * this file after the OpenCL header and build with -fopenmp.
+ */
+
+#ifndef COMMON_HOSTDATA_H
+#define COMMON_HOSTDATA_H
+
+#include <chrono>
+#include <iostream>
+#include <omp.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+// Counter-based generator for the input data: every value is a hash of the
+// seed and of its index (SplitMix64 finalizer), so the data does not depend on
+// the number of threads that generate it.
+inline cl_ulong hashCounter(cl_ulong seed, cl_ulong counter) {
+    cl_ulong z = seed + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform float in [0, 1) from the top 24 bits of the hash
+inline float randomFloat(cl_ulong seed, cl_ulong counter) {
+    return (hashCounter(seed, counter) >> 40) * (1.0f / 16777216.0f);
+}
+
+// Calls generate(i) for every i in [0, n) in parallel. The schedule is static,
+// so the pages of every chunk are first touched by the thread that generates
+// it, and a later loop with the same split reads them from the memory of its
+// own NUMA node.
+template <typename Generator>
+inline void generateInParallel(long n, Generator generate) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++) {
+        generate(i);
+    }
+}
+
+// Runs the host data initialization of the example and prints its time
+template <typename Size>
+inline void timeHostDataInitialization(void (*hostDataInitialization)(Size), Size elements) {
+    auto init_start = std::chrono::high_resolution_clock::now();
+    hostDataInitialization(elements);
+    auto init_end = std::chrono::high_resolution_clock::now();
+    std::cout << "Host data initialization: " << std::chrono::duration_cast<std::chrono::nanoseconds>(init_end - init_start).count() << " (ns), "
+              << omp_get_max_threads() << " threads" << std::endl;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Build logs and kernel resource reports shared by the examples. The hosts
+ * include this file after the OpenCL header.
+ */
+
+#ifndef COMMON_KERNELINFO_H
+#define COMMON_KERNELINFO_H
+
+#include <iostream>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+// Prints the build log of a program on a device: the compiler errors when
+// clBuildProgram fails, its warnings otherwise
+inline void printBuildLog(cl_program builtProgram, cl_device_id device) {
+    size_t logSize = 0;
+    clGetProgramBuildInfo(builtProgram, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &logSize);
+    if (logSize > 1) {
+        std::vector<char> log(logSize);
+        clGetProgramBuildInfo(builtProgram, device, CL_PROGRAM_BUILD_LOG, logSize, &log[0], NULL);
+        std::cout << "Build log:" << std::endl << &log[0] << std::endl;
+    }
+}
+
+// Warns when a kernel is launched with a local work size (the number of
+// work-items of a work-group) over its CL_KERNEL_WORK_GROUP_SIZE or that is not
+// a multiple of its preferred work-group size multiple. Called once per kernel,
+// before its launches.
+inline void checkLocalWorkSize(cl_kernel checkedKernel, cl_device_id device, const char *name, size_t localWorkSize) {
+    size_t workGroupSize = 0;
+    size_t preferredMultiple = 0;
+    clGetKernelWorkGroupInfo(checkedKernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize), &workGroupSize, NULL);
+    clGetKernelWorkGroupInfo(checkedKernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(preferredMultiple), &preferredMultiple, NULL);
+    if (workGroupSize > 0 && localWorkSize > workGroupSize) {
+        std::cout << "[WARNING] " << name << " is launched with a local work size of " << localWorkSize << ", over its limit of " << workGroupSize << std::endl;
+    } else if (preferredMultiple > 0 && localWorkSize % preferredMultiple != 0) {
+        std::cout << "[WARNING] " << name << " is launched with a local work size of " << localWorkSize
+                  << ", not a multiple of its preferred work-group size multiple " << preferredMultiple << std::endl;
+    }
+}
+
+// Resource report of every kernel of a program on a device (--kernel-report):
+// work-group limits, private and local memory, and the build log
+inline void printProgramReport(cl_program reportedProgram, cl_device_id device, const char *fileName) {
+    cl_uint numberOfKernels = 0;
+    clCreateKernelsInProgram(reportedProgram, 0, NULL, &numberOfKernels);
+    std::vector<cl_kernel> programKernels(numberOfKernels);
+    if (numberOfKernels > 0) {
+        clCreateKernelsInProgram(reportedProgram, numberOfKernels, &programKernels[0], NULL);
+    }
+    std::cout << "Kernel report, " << fileName << ":" << std::endl;
+    for (cl_uint k = 0; k < numberOfKernels; k++) {
+        char name[256];
+        size_t workGroupSize = 0;
+        size_t preferredMultiple = 0;
+        cl_ulong privateMemory = 0;
+        cl_ulong localMemory = 0;
+        clGetKernelInfo(programKernels[k], CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+        clGetKernelWorkGroupInfo(programKernels[k], device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(workGroupSize), &workGroupSize, NULL);
+        clGetKernelWorkGroupInfo(programKernels[k], device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(preferredMultiple), &preferredMultiple, NULL);
+        clGetKernelWorkGroupInfo(programKernels[k], device, CL_KERNEL_PRIVATE_MEM_SIZE, sizeof(privateMemory), &privateMemory, NULL);
+        clGetKernelWorkGroupInfo(programKernels[k], device, CL_KERNEL_LOCAL_MEM_SIZE, sizeof(localMemory), &localMemory, NULL);
+        std::cout << "\t" << name << ": work-group size <= " << workGroupSize << ", preferred multiple " << preferredMultiple
+                  << ", private memory " << privateMemory << " bytes, local memory " << localMemory << " bytes" << std::endl;
+        clReleaseKernel(programKernels[k]);
+    }
+    printBuildLog(reportedProgram, device);
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Kernel timing and the FMA micro-benchmark of roofline/roofline.cl, shared by
+ * the roofline report and the device characterization. The hosts include this
+ * file after the OpenCL header and build roofline.cl into their program.
+ */
+
+#ifndef COMMON_PEAKS_H
+#define COMMON_PEAKS_H
+
+#include <iostream>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "clutils.h"
+
+// fmaPeak: work-items and fma iterations per work-item. Every iteration is
+// 8 chains x 4 lanes x 2 FLOPs.
+const int FMA_WORK_ITEMS = 1 << 18;
+const int FMA_ITERATIONS = 1024;
+const int FMA_FLOPS_PER_ITERATION = 8 * 4 * 2;
+const double FMA_FLOPS = (double) FMA_WORK_ITEMS * FMA_ITERATIONS * FMA_FLOPS_PER_ITERATION;
+
+// One launch that is not timed, so that the timed launches do not include the
+// costs of the first one
+inline cl_int warmUpKernel(cl_command_queue queue, cl_kernel kernel, size_t globalWorkSize, const size_t *localWorkSize) {
+    cl_int status = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, localWorkSize, 0, NULL, NULL);
+    status |= clFinish(queue);
+    if (CL_SUCCESS != status) {
+        std::cout << "Error in clEnqueueNDRangeKernel" << std::endl;
+    }
+    return status;
+}
+
+// Median device time of `iterations` launches
+inline double medianKernelTime(cl_command_queue queue, cl_kernel kernel, size_t globalWorkSize, const size_t *localWorkSize, int iterations, cl_int *status) {
+    std::vector<long> timers;
+    for (int i = 0; i < iterations; i++) {
+        cl_event event;
+        *status = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &globalWorkSize, localWorkSize, 0, NULL, &event);
+        if (CL_SUCCESS != *status) {
+            std::cout << "Error in clEnqueueNDRangeKernel" << std::endl;
+            return 0;
+        }
+        timers.push_back(getTime(event));
+        clReleaseEvent(event);
+    }
+    return median(timers);
+}
+
+// Median device time of `iterations` launches after one warm-up launch
+inline double timeKernel(cl_command_queue queue, cl_kernel kernel, size_t globalWorkSize, const size_t *localWorkSize, int iterations, cl_int *status) {
+    *status = warmUpKernel(queue, kernel, globalWorkSize, localWorkSize);
+    if (CL_SUCCESS != *status) {
+        return 0;
+    }
+    return medianKernelTime(queue, kernel, globalWorkSize, localWorkSize, iterations, status);
+}
+
+// fmaPeak, writing one float per work-item to output. With a multiplier below
+// one the chains converge instead of overflowing.
+inline cl_kernel createFmaPeakKernel(cl_program program, cl_mem output, cl_int *status) {
+    cl_kernel fmaKernel = clCreateKernel(program, "fmaPeak", status);
+    if (CL_SUCCESS != *status) {
+        std::cout << "Error in clCreateKernel, fmaPeak kernel" << std::endl;
+        return NULL;
+    }
+    cl_int iterations = FMA_ITERATIONS;
+    float multiplier = 0.999f;
+    float addend = 0.001f;
+    *status = clSetKernelArg(fmaKernel, 0, sizeof(cl_mem), &output);
+    *status |= clSetKernelArg(fmaKernel, 1, sizeof(cl_int), &iterations);
+    *status |= clSetKernelArg(fmaKernel, 2, sizeof(cl_float), &multiplier);
+    *status |= clSetKernelArg(fmaKernel, 3, sizeof(cl_float), &addend);
+    if (CL_SUCCESS != *status) {
+        std::cout << "Error in clSetKernelArg, fmaPeak kernel" << std::endl;
+        clReleaseKernel(fmaKernel);
+        return NULL;
+    }
+    return fmaKernel;
+}
+
+#endif
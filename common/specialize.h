@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Specialization of kernels on their arguments (--specialize), shared by the
+ * examples: variants of a program built with selected arguments turned into -D
+ * constants, and the A/B benchmark of a generic kernel against its variant.
+ * The hosts include this file after the OpenCL header.
+ */
+
+#ifndef COMMON_SPECIALIZE_H
+#define COMMON_SPECIALIZE_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "clutils.h"
+
+const int SPECIALIZATION_ITERATIONS = 10;
+
+// Kernel variants, cached by the options they were built with
+struct SpecializationCache {
+    std::map<std::string, cl_program> programs;
+    std::map<std::string, cl_kernel> kernels;
+};
+
+// Builds, or takes from the cache, kernelName of the program of `count` sources
+// built with baseOptions (e.g. the precision mode of the generic kernel) and
+// the constants
+inline cl_kernel getSpecializedKernel(SpecializationCache &cache, cl_context context, cl_device_id device, cl_uint count, const char **sources,
+                                      const char *baseOptions, const char *kernelName, const std::map<std::string, std::string> &constants, cl_int *status) {
+    std::string options = std::string(baseOptions) + " ";
+    for (std::map<std::string, std::string>::const_iterator it = constants.begin(); it != constants.end(); ++it) {
+        options += "-D" + it->first + "=" + it->second + " ";
+    }
+    std::string key = std::string(kernelName) + " " + options;
+    std::map<std::string, cl_kernel>::iterator cachedKernel = cache.kernels.find(key);
+    if (cachedKernel != cache.kernels.end()) {
+        *status = CL_SUCCESS;
+        return cachedKernel->second;
+    }
+
+    cl_program variant;
+    std::map<std::string, cl_program>::iterator cachedProgram = cache.programs.find(options);
+    if (cachedProgram != cache.programs.end()) {
+        variant = cachedProgram->second;
+    } else {
+        variant = clCreateProgramWithSource(context, count, sources, NULL, status);
+        if (CL_SUCCESS != *status) {
+            std::cout << "Error in clCreateProgramWithSource" << std::endl;
+            return NULL;
+        }
+        *status = clBuildProgram(variant, 1, &device, options.c_str(), NULL, NULL);
+        if (CL_SUCCESS != *status) {
+            std::cout << "Error in clBuildProgram with options: " << options << std::endl;
+            printBuildLog(variant, device);
+            clReleaseProgram(variant);
+            return NULL;
+        }
+        cache.programs[options] = variant;
+    }
+
+    cl_kernel specialized = clCreateKernel(variant, kernelName, status);
+    if (CL_SUCCESS != *status) {
+        std::cout << "Error in clCreateKernel, specialized " << kernelName << " kernel" << std::endl;
+        return NULL;
+    }
+    cache.kernels[key] = specialized;
+    return specialized;
+}
+
+inline void releaseSpecializedKernels(SpecializationCache &cache) {
+    for (std::map<std::string, cl_kernel>::iterator it = cache.kernels.begin(); it != cache.kernels.end(); ++it) {
+        clReleaseKernel(it->second);
+    }
+    for (std::map<std::string, cl_program>::iterator it = cache.programs.begin(); it != cache.programs.end(); ++it) {
+        clReleaseProgram(it->second);
+    }
+    cache.kernels.clear();
+    cache.programs.clear();
+}
+
+// A/B benchmark of the generic kernel against its specialized variant. The
+// host runs the main kernel with runKernel, which launches `kernel`, keeps the
+// events of its last run in kernelEvent and readEvent and reads back the n
+// records of result. The records of both variants are compared with
+// sameRecord. `kernel` is the generic kernel again on return.
+template <typename Record>
+int runSpecializationBenchmark(cl_kernel &kernel, cl_kernel specialized, int (*runKernel)(), cl_event &kernelEvent, cl_event &readEvent,
+                               const Record *result, size_t n, bool (*sameRecord)(const Record &, const Record &)) {
+    cl_int status = CL_SUCCESS;
+    cl_kernel generic = kernel;
+    cl_kernel variants[] = {generic, specialized};
+    const char *names[] = {"Generic    ", "Specialized"};
+    double medians[2];
+    std::vector<Record> genericResult;
+    bool sameResult = true;
+
+    for (int v = 0; v < 2; v++) {
+        kernel = variants[v];
+        std::vector<long> timers;
+        for (int i = 0; i < SPECIALIZATION_ITERATIONS; i++) {
+            status = runKernel();
+            if (CL_SUCCESS != status) {
+                kernel = generic;
+                return status;
+            }
+            timers.push_back(getTime(kernelEvent));
+            clReleaseEvent(kernelEvent);
+            clReleaseEvent(readEvent);
+        }
+        medians[v] = median(timers);
+        if (v == 0) {
+            genericResult.assign(result, result + n);
+        } else {
+            for (size_t i = 0; i < genericResult.size(); i++) {
+                if (!sameRecord(result[i], genericResult[i])) {
+                    sameResult = false;
+                    break;
+                }
+            }
+        }
+    }
+    kernel = generic;
+
+    for (int v = 0; v < 2; v++) {
+        std::cout << "Median KernelTime " << names[v] << ": " << medians[v] << " (ns)" << std::endl;
+    }
+    std::cout << "Specialization speedup: " << (medians[1] > 0 ? medians[0] / medians[1] : 0) << "x" << std::endl;
+    if (sameResult) {
+        std::cout << "Specialized result matches the generic kernel" << std::endl;
+    } else {
+        std::cout << "Specialized result does not match the generic kernel" << std::endl;
+    }
+    std::cout << "\n";
+    return status;
+}
+
+#endif
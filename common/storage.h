@@ -0,0 +1,214 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Reduced-precision storage compared with fp32 (--storage): the inputs are
+ * stored as half, bfloat16 or int8 and widened to fp32 by the storage.cl of
+ * each example. The hosts include this file after the OpenCL header and name
+ * their own STORAGE_KERNELS.
+ */
+
+#ifndef COMMON_STORAGE_H
+#define COMMON_STORAGE_H
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "clutils.h"
+
+enum StorageFormat {
+    STORAGE_HALF,
+    STORAGE_BF16,
+    STORAGE_INT8,
+    NUMBER_OF_STORAGE_FORMATS
+};
+const char *const STORAGE_NAMES[] = {"half", "bf16", "int8"};
+const size_t STORAGE_BYTES[] = {2, 2, 1};
+const int STORAGE_ITERATIONS = 10;
+
+// Host conversions for the reduced-precision storage formats (--storage). The
+// device widens the values back to fp32 in storage.cl.
+inline cl_ushort floatToHalf(float value) {
+    cl_uint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    cl_uint sign = (bits >> 16) & 0x8000;
+    cl_uint magnitude = bits & 0x7FFFFFFF;
+    if (magnitude >= 0x7F800000) {
+        // Infinity or NaN
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+    }
+    if (magnitude >= 0x47800000) {
+        // Overflow
+        return sign | 0x7C00;
+    }
+    cl_uint half;
+    cl_uint remainder;
+    cl_uint halfway;
+    if (magnitude < 0x38800000) {
+        // Subnormal half, or zero below 2^-25
+        if (magnitude < 0x33000000) {
+            return sign;
+        }
+        cl_uint mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+        cl_uint shift = 126 - (magnitude >> 23);
+        half = mantissa >> shift;
+        remainder = mantissa & ((1u << shift) - 1);
+        halfway = 1u << (shift - 1);
+    } else {
+        half = (magnitude - 0x38000000) >> 13;
+        remainder = magnitude & 0x1FFF;
+        halfway = 0x1000;
+    }
+    // Round to nearest even; a carry into the exponent is still correct
+    if (remainder > halfway || (remainder == halfway && (half & 1))) {
+        half++;
+    }
+    return sign | half;
+}
+
+inline float halfToFloat(cl_ushort value) {
+    int exponent = (value >> 10) & 0x1F;
+    int mantissa = value & 0x3FF;
+    float magnitude;
+    if (exponent == 0) {
+        magnitude = ldexpf(mantissa, -24);
+    } else if (exponent == 31) {
+        magnitude = mantissa ? NAN : INFINITY;
+    } else {
+        magnitude = ldexpf(mantissa | 0x400, exponent - 25);
+    }
+    return (value & 0x8000) ? -magnitude : magnitude;
+}
+
+inline cl_ushort floatToBf16(float value) {
+    cl_uint bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7FFFFFFF) > 0x7F800000) {
+        return (bits >> 16) | 0x40;
+    }
+    // Round to nearest even
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return bits >> 16;
+}
+
+inline float bf16ToFloat(cl_ushort value) {
+    cl_uint bits = (cl_uint) value << 16;
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// Symmetric int8 quantization step of every field of interleaved records
+inline void storageScales(const float *values, size_t n, int fields, float *scales) {
+    for (int f = 0; f < fields; f++) {
+        float maxAbs = 0.0f;
+        for (size_t i = f; i < n; i += fields) {
+            maxAbs = std::max(maxAbs, fabsf(values[i]));
+        }
+        scales[f] = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    }
+}
+
+// Converts n fp32 values, interleaved records of `fields` values, to a storage
+// format. The scales are only used by int8.
+inline std::vector<cl_uchar> encodeStorage(int format, const float *values, size_t n, const float *scales, int fields) {
+    std::vector<cl_uchar> encoded(n * STORAGE_BYTES[format]);
+    cl_ushort *encoded16 = (cl_ushort *) &encoded[0];
+    cl_char *encoded8 = (cl_char *) &encoded[0];
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long) n; i++) {
+        if (format == STORAGE_HALF) {
+            encoded16[i] = floatToHalf(values[i]);
+        } else if (format == STORAGE_BF16) {
+            encoded16[i] = floatToBf16(values[i]);
+        } else {
+            float q = rintf(values[i] / scales[i % fields]);
+            encoded8[i] = (cl_char) std::max(-127.0f, std::min(127.0f, q));
+        }
+    }
+    return encoded;
+}
+
+inline void decodeStorage(int format, const std::vector<cl_uchar> &encoded, size_t n, const float *scales, int fields, float *values) {
+    const cl_ushort *encoded16 = (const cl_ushort *) &encoded[0];
+    const cl_char *encoded8 = (const cl_char *) &encoded[0];
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < (long) n; i++) {
+        if (format == STORAGE_HALF) {
+            values[i] = halfToFloat(encoded16[i]);
+        } else if (format == STORAGE_BF16) {
+            values[i] = bf16ToFloat(encoded16[i]);
+        } else {
+            values[i] = encoded8[i] * scales[i % fields];
+        }
+    }
+}
+
+// Maximum and root-mean-square absolute error against the fp32 result
+inline void storageError(const float *reference, const float *values, size_t n, double *maxError, double *rmsError) {
+    double sum = 0;
+    *maxError = 0;
+    for (size_t i = 0; i < n; i++) {
+        double error = fabs((double) values[i] - reference[i]);
+        *maxError = std::max(*maxError, error);
+        sum += error * error;
+    }
+    *rmsError = n > 0 ? sqrt(sum / n) : 0;
+}
+
+inline void printStorageResult(const char *format, double kernelTime, double bytes, double fp32Time, double maxError, double rmsError) {
+    std::cout << "Storage " << format << ": Median KernelTime " << kernelTime << " (ns)"
+              << ", Bandwidth " << (kernelTime > 0 ? bytes / kernelTime : 0) << " GB/s"
+              << ", Speedup " << (kernelTime > 0 ? fp32Time / kernelTime : 0) << "x"
+              << ", MaxError " << maxError << ", RMSError " << rmsError << std::endl;
+}
+
+// Median kernel time of STORAGE_ITERATIONS launches of a kernel whose arguments
+// are set, both for the storage variants and for their fp32 reference
+inline double timeStorageKernel(cl_command_queue queue, cl_kernel storageKernel, size_t globalWorkSize, const size_t *localWorkSize, cl_int *status) {
+    std::vector<long> timers;
+    for (int i = 0; i < STORAGE_ITERATIONS; i++) {
+        cl_event event;
+        *status = clEnqueueNDRangeKernel(queue, storageKernel, 1, NULL, &globalWorkSize, localWorkSize, 0, NULL, &event);
+        if (CL_SUCCESS != *status) {
+            std::cout << "Error in clEnqueueNDRangeKernel" << std::endl;
+            return 0;
+        }
+        timers.push_back(getTime(event));
+        clReleaseEvent(event);
+    }
+    return median(timers);
+}
+
+#endif
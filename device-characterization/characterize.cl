@@ -0,0 +1,49 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Kernels of the device characterization: an empty kernel for the launch
+// latency and global-memory read and write kernels on float4 elements. The
+// program also holds roofline/roofline.cl, whose streamCopy and fmaPeak
+// measure the copy bandwidth and the FMA throughput.
+
+__kernel void emptyKernel()
+{
+}
+
+// The sum is only stored when it takes an impossible value, so that the reads
+// cannot be removed and nearly nothing is written
+__kernel void readGlobal(__global const float4 *input, __global float4 *output)
+{
+    int i = get_global_id(0);
+    float4 value = input[i];
+    if (value.s0 + value.s1 + value.s2 + value.s3 == -1.0F) {
+        output[0] = value;
+    }
+}
+
+__kernel void writeGlobal(__global float4 *output, const float value)
+{
+    output[get_global_id(0)] = (float4)(value);
+}
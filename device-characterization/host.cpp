@@ -0,0 +1,510 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Characterization of one OpenCL device: host<->device bandwidth of the
+// pageable, pinned and mapped paths, empty-kernel launch latency, map/unmap
+// latency, global-memory bandwidth and FMA throughput. The results are
+// printed and written as key=value lines to a device profile file (--output,
+// device.profile by default). The co-execution of the KTM map reads it
+// (--profile) to size the first chunks of the device. The copy bandwidth and
+// the FMA throughput are measured with the kernels of roofline/roofline.cl.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+#define CL_USE_DEPRECATED_OPENCL_2_0_APIS
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/peaks.h"
+
+int platformId = 0;
+const int LOCAL_WORK_SIZE = 256;
+const int ITERATIONS = 10;
+const int LAUNCH_ITERATIONS = 1000;
+const int MAP_ITERATIONS = 1000;
+
+// Transfer sizes: from MIN_TRANSFER_BYTES, times TRANSFER_SIZE_STEP, up to the
+// size of the input
+const size_t MIN_TRANSFER_BYTES = 4096;
+const size_t TRANSFER_SIZE_STEP = 4;
+
+// Host memory of the transfers: malloc'ed (pageable), a mapped
+// CL_MEM_ALLOC_HOST_PTR buffer used as the source or destination of the
+// copies (pinned), and map/unmap of a CL_MEM_ALLOC_HOST_PTR buffer the
+// kernels use directly (mapped)
+enum TransferPath {PAGEABLE, PINNED, MAPPED, NUMBER_OF_TRANSFER_PATHS};
+const char *TRANSFER_PATH_NAMES[] = {"pageable", "pinned", "mapped"};
+
+const char *profileFile = "device.profile";
+
+int elements = 1 << 24;
+
+string platformName;
+string deviceName;
+cl_platform_id *platforms;
+cl_device_id *devices;
+cl_device_type deviceType;
+cl_context context;
+cl_command_queue commandQueue;
+cl_program program;
+char *sources[2];
+
+// Buffers of the transfers, of elements floats
+size_t maxBytes;
+cl_mem d_buffer;
+cl_mem pinnedBuffer;
+cl_mem mappedBuffer;
+char *pageableData;
+char *pinnedData;
+
+// Entries of the device profile, in the order they were measured
+vector<pair<string, string> > profile;
+
+int openclInitialization() {
+    cl_int status;
+    cl_uint numPlatforms = 0;
+
+    status = clGetPlatformIDs(0, NULL, &numPlatforms);
+
+    if (numPlatforms == 0) {
+        cout << "No platform detected" << endl;
+        return status;
+    }
+
+    platforms = (cl_platform_id *) malloc(numPlatforms * sizeof(cl_platform_id));
+    if (platforms == NULL) {
+        cout << "malloc platform_id failed" << endl;
+        return status;
+    }
+
+    status = clGetPlatformIDs(numPlatforms, platforms, NULL);
+    if (status != CL_SUCCESS) {
+        cout << "clGetPlatformIDs failed" << endl;
+        return status;
+    }
+
+    cout << numPlatforms << " has been detected" << endl;
+    for (int i = 0; i < numPlatforms; i++) {
+        char buf[10000];
+        cout << "Platform: " << i << endl;
+        status = clGetPlatformInfo(platforms[i], CL_PLATFORM_VENDOR, sizeof(buf), buf, NULL);
+        if (i == platformId) {
+            platformName += buf;
+        }
+        cout << "\tVendor: " << buf << endl;
+        status = clGetPlatformInfo(platforms[i], CL_PLATFORM_NAME, sizeof(buf), buf, NULL);
+        cout << "\tName  : " << buf << endl;
+    }
+
+    cl_uint numDevices = 0;
+    cl_platform_id platform = platforms[platformId];
+    std::cout << "Using platform: " << platformId << " --> " << platformName << std::endl;
+
+    status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, NULL, &numDevices);
+
+    if (status != CL_SUCCESS) {
+        cout << "[WARNING] Using CPU, no GPU available" << endl;
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 0, NULL, &numDevices);
+        devices = (cl_device_id *) malloc(numDevices * sizeof(cl_device_id));
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, numDevices, devices, NULL);
+    } else {
+        devices = (cl_device_id *) malloc(numDevices * sizeof(cl_device_id));
+        cout << "Using accelerator" << endl;
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, numDevices, devices, NULL);
+    }
+    char buf[1000];
+    clGetDeviceInfo(devices[0], CL_DEVICE_NAME, sizeof(buf), buf, NULL);
+    deviceName = buf;
+    cout << "\tDEVICE NAME: " << buf << endl;
+    clGetDeviceInfo(devices[0], CL_DEVICE_TYPE, sizeof(deviceType), &deviceType, NULL);
+
+    context = clCreateContext(NULL, 1, devices, NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+        cout << "Error in clCreateContext" << endl;
+        return status;
+    }
+
+    commandQueue = clCreateCommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE, &status);
+    if (status != CL_SUCCESS || commandQueue == NULL) {
+        cout << "Error in clCreateCommandQueue" << endl;
+        return status;
+    }
+
+    // Build from source, with the STREAM and FMA kernels of the roofline
+    const char *sourceFiles[] = {"../roofline/roofline.cl", "characterize.cl"};
+    program = buildProgramFromFiles(context, devices[0], 2, sourceFiles, NULL, false, sources, &status);
+    return status;
+}
+
+int allocateBuffers() {
+    cl_int status;
+    maxBytes = sizeof(cl_float) * (size_t) elements;
+    d_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, maxBytes, NULL, &status);
+    pinnedBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, maxBytes, NULL, &status);
+    mappedBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, maxBytes, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer" << endl;
+        return status;
+    }
+    // The pinned host memory stays mapped for the whole run
+    pinnedData = (char *) clEnqueueMapBuffer(commandQueue, pinnedBuffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, maxBytes, 0, NULL, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clEnqueueMapBuffer" << endl;
+        return status;
+    }
+    pageableData = (char *) malloc(maxBytes);
+    memset(pageableData, 1, maxBytes);
+    memset(pinnedData, 1, maxBytes);
+    return CL_SUCCESS;
+}
+
+void addProfileEntry(const string &key, const string &value) {
+    profile.push_back(make_pair(key, value));
+}
+
+void addProfileEntry(const string &key, double value) {
+    ostringstream text;
+    text << value;
+    addProfileEntry(key, text.str());
+}
+
+double elapsedNs(chrono::high_resolution_clock::time_point start) {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// One transfer of bytes in one direction, timed on the host from the enqueue
+// until the data can be used on the other side
+cl_int transfer(int path, bool toDevice, size_t bytes) {
+    cl_int status;
+    if (path == PAGEABLE || path == PINNED) {
+        char *hostData = path == PAGEABLE ? pageableData : pinnedData;
+        if (toDevice) {
+            status = clEnqueueWriteBuffer(commandQueue, d_buffer, CL_TRUE, 0, bytes, hostData, 0, NULL, NULL);
+        } else {
+            status = clEnqueueReadBuffer(commandQueue, d_buffer, CL_TRUE, 0, bytes, hostData, 0, NULL, NULL);
+        }
+        return status;
+    }
+    cl_map_flags flags = toDevice ? CL_MAP_WRITE_INVALIDATE_REGION : CL_MAP_READ;
+    void *mapped = clEnqueueMapBuffer(commandQueue, mappedBuffer, CL_TRUE, flags, 0, bytes, 0, NULL, NULL, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    if (toDevice) {
+        memcpy(mapped, pageableData, bytes);
+    } else {
+        memcpy(pageableData, mapped, bytes);
+    }
+    status = clEnqueueUnmapMemObject(commandQueue, mappedBuffer, mapped, 0, NULL, NULL);
+    status |= clFinish(commandQueue);
+    return status;
+}
+
+vector<size_t> transferSizes() {
+    vector<size_t> sizes;
+    for (size_t bytes = MIN_TRANSFER_BYTES; bytes < maxBytes; bytes *= TRANSFER_SIZE_STEP) {
+        sizes.push_back(bytes);
+    }
+    sizes.push_back(maxBytes);
+    return sizes;
+}
+
+// Median bandwidth of every path and direction for every transfer size, the
+// fastest path of each size and direction and the best bandwidth of each
+// direction
+int measureTransfers() {
+    cout << "Transfer bandwidth (GB/s)" << endl;
+    vector<size_t> sizes = transferSizes();
+    double peak[2] = {0, 0};
+    for (size_t s = 0; s < sizes.size(); s++) {
+        size_t bytes = sizes[s];
+        for (int direction = 0; direction < 2; direction++) {
+            bool toDevice = direction == 0;
+            const char *name = toDevice ? "h2d" : "d2h";
+            double best = 0;
+            int bestPath = PAGEABLE;
+            for (int path = 0; path < NUMBER_OF_TRANSFER_PATHS; path++) {
+                vector<double> timers;
+                for (int i = 0; i < ITERATIONS; i++) {
+                    auto start = chrono::high_resolution_clock::now();
+                    cl_int status = transfer(path, toDevice, bytes);
+                    if (CL_SUCCESS != status) {
+                        cout << "Error in the " << TRANSFER_PATH_NAMES[path] << " " << name << " transfer of " << bytes << " bytes" << endl;
+                        return status;
+                    }
+                    timers.push_back(elapsedNs(start));
+                }
+                double time = median(timers);
+                double bandwidth = time > 0 ? bytes / time : 0;
+                cout << "\t" << name << " " << TRANSFER_PATH_NAMES[path] << " " << bytes << " bytes: " << bandwidth << endl;
+                addProfileEntry(string(name) + "_" + TRANSFER_PATH_NAMES[path] + "_" + to_string(bytes) + "_gbs", bandwidth);
+                if (bandwidth > best) {
+                    best = bandwidth;
+                    bestPath = path;
+                }
+            }
+            addProfileEntry(string(name) + "_best_" + to_string(bytes), TRANSFER_PATH_NAMES[bestPath]);
+            peak[direction] = max(peak[direction], best);
+        }
+    }
+    addProfileEntry("h2d_peak_gbs", peak[0]);
+    addProfileEntry("d2h_peak_gbs", peak[1]);
+    cout << "\n";
+    return CL_SUCCESS;
+}
+
+// Round trip of an empty kernel (enqueue to clFinish) on the host, and its
+// execution time on the device
+int measureLaunchLatency() {
+    cl_int status;
+    cl_kernel emptyKernel = clCreateKernel(program, "emptyKernel", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, emptyKernel kernel" << endl;
+        return status;
+    }
+    size_t globalWorkSize = 1;
+    vector<double> roundTrips;
+    vector<double> deviceTimes;
+    for (int i = 0; i < LAUNCH_ITERATIONS; i++) {
+        cl_event event;
+        auto start = chrono::high_resolution_clock::now();
+        status = clEnqueueNDRangeKernel(commandQueue, emptyKernel, 1, NULL, &globalWorkSize, NULL, 0, NULL, &event);
+        status |= clFinish(commandQueue);
+        roundTrips.push_back(elapsedNs(start));
+        if (CL_SUCCESS != status) {
+            cout << "Error in clEnqueueNDRangeKernel" << endl;
+            return status;
+        }
+        deviceTimes.push_back(getTime(event));
+        clReleaseEvent(event);
+    }
+    clReleaseKernel(emptyKernel);
+
+    cout << "Launch latency: " << median(roundTrips) << " (ns), empty kernel on the device: " << median(deviceTimes) << " (ns)" << endl;
+    addProfileEntry("launch_latency_ns", median(roundTrips));
+    addProfileEntry("empty_kernel_ns", median(deviceTimes));
+    return CL_SUCCESS;
+}
+
+// Blocking map and unmap (until clFinish) of MIN_TRANSFER_BYTES of the mapped
+// buffer, without touching the data
+int measureMapLatency() {
+    cl_int status;
+    vector<double> mapTimes;
+    vector<double> unmapTimes;
+    for (int i = 0; i < MAP_ITERATIONS; i++) {
+        auto start = chrono::high_resolution_clock::now();
+        void *mapped = clEnqueueMapBuffer(commandQueue, mappedBuffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, MIN_TRANSFER_BYTES, 0, NULL, NULL, &status);
+        mapTimes.push_back(elapsedNs(start));
+        if (CL_SUCCESS != status) {
+            cout << "Error in clEnqueueMapBuffer" << endl;
+            return status;
+        }
+        start = chrono::high_resolution_clock::now();
+        status = clEnqueueUnmapMemObject(commandQueue, mappedBuffer, mapped, 0, NULL, NULL);
+        status |= clFinish(commandQueue);
+        unmapTimes.push_back(elapsedNs(start));
+        if (CL_SUCCESS != status) {
+            cout << "Error in clEnqueueUnmapMemObject" << endl;
+            return status;
+        }
+    }
+    cout << "Map latency: " << median(mapTimes) << " (ns), unmap latency: " << median(unmapTimes) << " (ns)" << endl;
+    addProfileEntry("map_latency_ns", median(mapTimes));
+    addProfileEntry("unmap_latency_ns", median(unmapTimes));
+    return CL_SUCCESS;
+}
+
+// Read, write and copy bandwidth of global memory between d_buffer and a
+// second device buffer, and the FMA throughput
+int measureDevice() {
+    cl_int status;
+    cl_mem d_second = clCreateBuffer(context, CL_MEM_READ_WRITE, maxBytes, NULL, &status);
+    cl_mem d_fmaOutput = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(cl_float) * FMA_WORK_ITEMS, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer" << endl;
+        return status;
+    }
+    size_t vectors = elements / 4;
+    float value = 1.0f;
+    cl_kernel readKernel = clCreateKernel(program, "readGlobal", &status);
+    cl_kernel writeKernel = clCreateKernel(program, "writeGlobal", &status);
+    cl_kernel copyKernel = clCreateKernel(program, "streamCopy", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel" << endl;
+        return status;
+    }
+    cl_kernel fmaKernel = createFmaPeakKernel(program, d_fmaOutput, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    checkLocalWorkSize(readKernel, devices[0], "readGlobal", LOCAL_WORK_SIZE);
+    checkLocalWorkSize(writeKernel, devices[0], "writeGlobal", LOCAL_WORK_SIZE);
+    checkLocalWorkSize(copyKernel, devices[0], "streamCopy", LOCAL_WORK_SIZE);
+    checkLocalWorkSize(fmaKernel, devices[0], "fmaPeak", LOCAL_WORK_SIZE);
+    status = clSetKernelArg(readKernel, 0, sizeof(cl_mem), &d_buffer);
+    status |= clSetKernelArg(readKernel, 1, sizeof(cl_mem), &d_second);
+    status |= clSetKernelArg(writeKernel, 0, sizeof(cl_mem), &d_second);
+    status |= clSetKernelArg(writeKernel, 1, sizeof(cl_float), &value);
+    status |= clSetKernelArg(copyKernel, 0, sizeof(cl_mem), &d_buffer);
+    status |= clSetKernelArg(copyKernel, 1, sizeof(cl_mem), &d_second);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg" << endl;
+        return status;
+    }
+
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    double readTime = timeKernel(commandQueue, readKernel, vectors, localWorkSize, ITERATIONS, &status);
+    double writeTime = CL_SUCCESS == status ? timeKernel(commandQueue, writeKernel, vectors, localWorkSize, ITERATIONS, &status) : 0;
+    double copyTime = CL_SUCCESS == status ? timeKernel(commandQueue, copyKernel, vectors, localWorkSize, ITERATIONS, &status) : 0;
+    double fmaTime = CL_SUCCESS == status ? timeKernel(commandQueue, fmaKernel, FMA_WORK_ITEMS, localWorkSize, ITERATIONS, &status) : 0;
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    double readBandwidth = readTime > 0 ? maxBytes / readTime : 0;
+    double writeBandwidth = writeTime > 0 ? maxBytes / writeTime : 0;
+    double copyBandwidth = copyTime > 0 ? 2.0 * maxBytes / copyTime : 0;
+    double fmaThroughput = fmaTime > 0 ? FMA_FLOPS / fmaTime : 0;
+
+    cout << "Global memory read : " << readBandwidth << " GB/s" << endl;
+    cout << "Global memory write: " << writeBandwidth << " GB/s" << endl;
+    cout << "Global memory copy : " << copyBandwidth << " GB/s" << endl;
+    cout << "FMA throughput     : " << fmaThroughput << " GFLOP/s" << endl;
+    addProfileEntry("global_read_gbs", readBandwidth);
+    addProfileEntry("global_write_gbs", writeBandwidth);
+    addProfileEntry("global_copy_gbs", copyBandwidth);
+    addProfileEntry("fma_gflops", fmaThroughput);
+
+    clReleaseKernel(readKernel);
+    clReleaseKernel(writeKernel);
+    clReleaseKernel(copyKernel);
+    clReleaseKernel(fmaKernel);
+    clReleaseMemObject(d_second);
+    clReleaseMemObject(d_fmaOutput);
+    return CL_SUCCESS;
+}
+
+int writeProfile() {
+    ofstream file(profileFile);
+    if (!file) {
+        cout << "Error opening the profile file " << profileFile << endl;
+        return -1;
+    }
+    file << "# Device profile written by device-characterization" << endl;
+    for (size_t i = 0; i < profile.size(); i++) {
+        file << profile[i].first << "=" << profile[i].second << endl;
+    }
+    cout << "Device profile written to " << profileFile << endl;
+    return 0;
+}
+
+void freeMemory() {
+    clEnqueueUnmapMemObject(commandQueue, pinnedBuffer, pinnedData, 0, NULL, NULL);
+    clFinish(commandQueue);
+    clReleaseMemObject(d_buffer);
+    clReleaseMemObject(pinnedBuffer);
+    clReleaseMemObject(mappedBuffer);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commandQueue);
+    clReleaseContext(context);
+    free(pageableData);
+    free(sources[0]);
+    free(sources[1]);
+    free(platforms);
+    free(devices);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        platformId = atoi(argv[1]);
+        elements = atoi(argv[2]);
+    } else {
+        cout << "Run: ./host <platformId> <elements> [--output <file>]" << endl;
+        return -1;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            profileFile = argv[++i];
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
+    if (elements <= 0 || elements % (4 * LOCAL_WORK_SIZE) != 0) {
+        cout << "The number of elements must be a multiple of " << 4 * LOCAL_WORK_SIZE << endl;
+        return -1;
+    }
+
+    cout << "OpenCL Device Characterization " << endl;
+    cout << "Number of Elements = " << elements << endl;
+
+    if (openclInitialization() != CL_SUCCESS) {
+        return -1;
+    }
+    addProfileEntry("platform", platformName);
+    addProfileEntry("device_name", deviceName);
+    addProfileEntry("device_type", deviceType == CL_DEVICE_TYPE_CPU ? "cpu" : (deviceType == CL_DEVICE_TYPE_GPU ? "gpu" : "other"));
+    addProfileEntry("max_transfer_bytes", to_string(sizeof(cl_float) * (size_t) elements));
+    if (allocateBuffers() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (measureTransfers() != CL_SUCCESS) {
+        return -1;
+    }
+    if (measureLaunchLatency() != CL_SUCCESS) {
+        return -1;
+    }
+    if (measureMapLatency() != CL_SUCCESS) {
+        return -1;
+    }
+    if (measureDevice() != CL_SUCCESS) {
+        return -1;
+    }
+    cout << "\n";
+    if (writeProfile() != 0) {
+        return -1;
+    }
+
+    freeMemory();
+    return 0;
+}
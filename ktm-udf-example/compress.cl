@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Decompression stage for CanData records compressed on the host with delta +
+// frame-of-reference + bit-packing. The records are split in blocks of
+// get_local_size(0) records, one work-group per block. For every field of a
+// block the stream holds the bits of the first value, the minimum delta
+// between consecutive values and a bit width, followed by the packed
+// differences (delta - minimum delta) of the following records. The
+// work-group restores the values with a prefix sum of the deltas. All
+// arithmetic is on the raw 32-bit patterns modulo 2^32, so it is lossless.
+
+#define CAN_FIELDS 4
+#define FIELD_HEADER_WORDS 3
+
+uint extractBits(__global const uint *words, uint position, uint width)
+{
+    if (width == 0) {
+        return 0;
+    }
+    uint word = position >> 5;
+    uint shift = position & 31;
+    uint value = words[word] >> shift;
+    if (shift + width > 32) {
+        value |= words[word + 1] << (32 - shift);
+    }
+    return width == 32 ? value : value & ((1u << width) - 1);
+}
+
+__kernel void decompressCanData(__global const uint *stream, __global const uint *blockOffsets, const int elements, __global uint *records, __local uint *scratch)
+{
+    int lid = get_local_id(0);
+    int blockSize = get_local_size(0);
+    int first = get_group_id(0) * blockSize;
+    int count = min(blockSize, elements - first);
+    __global const uint *header = stream + blockOffsets[get_group_id(0)];
+    __global const uint *packed = header + CAN_FIELDS * FIELD_HEADER_WORDS;
+
+    for (int f = 0; f < CAN_FIELDS; f++) {
+        uint base = header[f * FIELD_HEADER_WORDS];
+        uint minDelta = header[f * FIELD_HEADER_WORDS + 1];
+        uint width = header[f * FIELD_HEADER_WORDS + 2];
+
+        uint delta = 0;
+        if (lid > 0 && lid < count) {
+            delta = minDelta + extractBits(packed, (lid - 1) * width, width);
+        }
+
+        // Inclusive scan of the deltas in local memory
+        scratch[lid] = delta;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (int offset = 1; offset < blockSize; offset <<= 1) {
+            uint value = (lid >= offset) ? scratch[lid - offset] : 0;
+            barrier(CLK_LOCAL_MEM_FENCE);
+            scratch[lid] += value;
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+        if (lid < count) {
+            records[(first + lid) * CAN_FIELDS + f] = base + scratch[lid];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        packed += ((count - 1) * width + 31) / 32;
+    }
+}
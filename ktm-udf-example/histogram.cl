@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Histograms of AggregationInput fields. Every work-group counts its records
+// in a private copy of the bins in local memory, then adds the copy to the
+// global bins with one atomic per non-empty bin. A histogram has one axis, or
+// two (yBins > 1) whose bins are laid out row by row (y * xBins + x).
+
+// Floats per AggregationInput record
+#define RECORD_FIELDS 3
+
+// Bin of a value on one axis, -1 when out of range. Without edges the bins
+// have a fixed width: value is in bin (value - minimum) * scale. With edges,
+// bin b holds edges[b] <= value < edges[b + 1], found by binary search.
+int binOf(float value, int bins, float minimum, float scale, __global const float *edges)
+{
+    if (edges != 0) {
+        if (!(value >= edges[0] && value < edges[bins])) {
+            return -1;
+        }
+        int low = 0;
+        int high = bins;
+        while (high - low > 1) {
+            int middle = (low + high) / 2;
+            if (value >= edges[middle]) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+    float position = (value - minimum) * scale;
+    if (!(position >= 0.0F && position < bins)) {
+        return -1;
+    }
+    return (int) position;
+}
+
+__kernel void histogram(__global const float *records, const int elements,
+                        const int xField, const int xBins, const float xMinimum, const float xScale, __global const float *xEdges,
+                        const int yField, const int yBins, const float yMinimum, const float yScale, __global const float *yEdges,
+                        __global uint *bins, __local uint *localBins)
+{
+    int numberOfBins = xBins * yBins;
+    for (int b = get_local_id(0); b < numberOfBins; b += get_local_size(0)) {
+        localBins[b] = 0;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int i = get_global_id(0); i < elements; i += get_global_size(0)) {
+        __global const float *record = records + (size_t) i * RECORD_FIELDS;
+        int x = binOf(record[xField], xBins, xMinimum, xScale, xEdges);
+        int y = yBins > 1 ? binOf(record[yField], yBins, yMinimum, yScale, yEdges) : 0;
+        if (x >= 0 && y >= 0) {
+            atomic_inc(&localBins[y * xBins + x]);
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int b = get_local_id(0); b < numberOfBins; b += get_local_size(0)) {
+        if (localBins[b] != 0) {
+            atomic_add(&bins[b], localBins[b]);
+        }
+    }
+}
@@ -24,13 +24,20 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <string>
+#include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <climits>
+#include <thread>
+#include <mutex>
 #include <math.h>
 
 using namespace std;
@@ -45,6 +52,13 @@ const bool CHECK_RESULT = true;
 #include <CL/cl.h>
 #endif
 
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/hostdata.h"
+#include "../common/specialize.h"
+#include "../common/storage.h"
+#include "../common/coexec.h"
+
 struct __attribute__((packed)) CanData {
     float time;
     float abs_lean_angle;
@@ -61,7 +75,76 @@ int platformId = 0;
 const int LOCAL_WORK_SIZE = 256;
 const int ITERATIONS = 1;
 
-int elements = 1024;
+// Seed of the input data (--seed <n>)
+cl_ulong seed = 42;
+
+// Reduced-precision storage compared with fp32 (--storage): the inputs are
+// stored as half, bfloat16 or int8 and widened to fp32 in storage.cl
+const char *STORAGE_KERNELS[] = {"mapHalf", "mapBf16", "mapInt8"};
+// Wheel speed of the storage input, in km/h, within the range of half
+const int STORAGE_MAX_SPEED = 300;
+bool storage = false;
+
+// Compressed transfer of the CanData records (--compress): delta +
+// frame-of-reference + bit-packing on the host, decompressed by compress.cl,
+// compared with the raw transfer for growing numbers of records
+const int COMPRESSION_BLOCK = 256;
+const int CAN_FIELDS = 4;
+const int FIELD_HEADER_WORDS = 3;
+const int COMPRESSION_ITERATIONS = 10;
+const int COMPRESSION_MIN_RECORDS = 4096;
+bool compressTransfer = false;
+
+// Precision modes of the map kernel (--math default|strict|relaxed|native): the
+// build options of map.cl for each mode. --math compare reports the throughput
+// and the error of every mode against a correctly rounded reference.
+enum MathMode {MATH_DEFAULT, MATH_STRICT, MATH_RELAXED, MATH_NATIVE, NUMBER_OF_MATH_MODES};
+const char *MATH_MODE_NAMES[] = {"default", "strict", "relaxed", "native"};
+const char *MATH_MODE_OPTIONS[] = {"", "-DMATH_STRICT", "-DMATH_STRICT -cl-fast-relaxed-math -cl-mad-enable", "-DMATH_NATIVE"};
+const int MATH_ITERATIONS = 10;
+int mathMode = MATH_DEFAULT;
+bool compareMathModes = false;
+
+// A/B benchmark of the generic and the specialized kernel (--specialize)
+bool specialize = false;
+SpecializationCache specializationCache;
+
+// Resource report of the kernels of every program built (--kernel-report)
+bool kernelReport = false;
+
+// Co-execution of map on the OpenCL devices and on host worker threads
+// (--coexec [--host-workers <n>]), with the work-stealing scheduler of
+// common/coexec.h over the records. By default there is one host worker per
+// OpenMP thread not driving a device.
+const size_t COEXEC_FIRST_CHUNK = 16384;
+const size_t COEXEC_MIN_CHUNK = 1024;
+const size_t COEXEC_MAX_DEVICE_CHUNK = (size_t) 1 << 22;
+bool coexecute = false;
+int hostWorkers = -1;
+
+// Device profile written by device-characterization (--profile <file>). The
+// worker of the profiled device starts from the throughput its transfer
+// bandwidth allows instead of COEXEC_FIRST_CHUNK records.
+const char *profileFile = NULL;
+
+// Histograms of the map output computed on the device (--histogram), where
+// only the bins are read back, compared with reading back the records and
+// binning them on the host
+const int HISTOGRAM_MAX_GROUPS = 256;
+const int HISTOGRAM_ITERATIONS = 10;
+bool histograms = false;
+
+long elements = 1024;
+
+// Datasets larger than one device allocation (CL_DEVICE_MAX_MEM_ALLOC_SIZE) are
+// processed in chunks that fit in one, and chunks of more work-items than
+// MAX_LAUNCH_ITEMS are split into launches with global offsets. map.cl indexes
+// the floats of the records, so it is built with -DLONG_INDEX when a chunk
+// holds more than INT_MAX / 4 records.
+const size_t MAX_LAUNCH_ITEMS = (size_t) 1 << 30;
+cl_ulong maxAllocationSize;
+size_t chunkElements;
+bool longIndex = false;
 
 // Variables
 size_t input_size;
@@ -74,6 +157,7 @@ string platformName;
 cl_uint numPlatforms;
 cl_platform_id *platforms;
 cl_device_id *devices;
+cl_uint numberOfDevices;
 cl_context context;
 cl_command_queue commandQueue;
 cl_kernel kernel;
@@ -92,65 +176,6 @@ long kernelTime;
 long writeTime;
 long readTime;
 
-long getTime(cl_event event) {
-    clWaitForEvents(1, &event);
-    cl_ulong time_start, time_end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
-    return (time_end - time_start);
-}
-
-char *readsource(const char *sourceFilename) {
-    FILE *fp;
-    int err;
-    int size;
-    char *source;
-
-    fp = fopen(sourceFilename, "rb");
-
-    if (fp == NULL) {
-        printf("Could not open kernel file: %s\n", sourceFilename);
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_END);
-
-    if (err != 0) {
-        printf("Error seeking to end of file\n");
-        exit(-1);
-
-    }
-    size = ftell(fp);
-
-    if (size < 0) {
-        printf("Error getting file position\n");
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_SET);
-    if (err != 0) {
-        printf("Error seeking to start of file\n");
-        exit(-1);
-
-    }
-
-    source = (char *) malloc(size + 1);
-
-    if (source == NULL) {
-        printf("Error allocating %d bytes for the program source\n", size + 1);
-        exit(-1);
-    }
-
-    err = fread(source, 1, size, fp);
-    if (err != size) {
-        printf("only read %d bytes\n", err);
-        exit(0);
-    }
-
-    source[size] = '\0';
-    return source;
-}
-
 int openclInitialization() {
     cl_int status;
     cl_uint numPlatforms = 0;
@@ -208,6 +233,7 @@ int openclInitialization() {
         cout << "\tDEVICE NAME: " << buf << endl;
     }
 
+    numberOfDevices = numDevices;
     context = clCreateContext(NULL, numDevices, devices, NULL, NULL, &status);
     if (status != CL_SUCCESS) {
         cout << "Error in clCreateContext" << endl;
@@ -220,6 +246,10 @@ int openclInitialization() {
         return status;
     }
 
+    clGetDeviceInfo(devices[0], CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAllocationSize), &maxAllocationSize, NULL);
+    chunkElements = min((cl_ulong) elements, maxAllocationSize / sizeof(CanData));
+    longIndex = chunkElements > INT_MAX / 4;
+
     // Build from source
     const char *sourceFile = "map.cl";
     source = readsource(sourceFile);
@@ -228,9 +258,14 @@ int openclInitialization() {
         cout << "Error in clCreateProgramWithSource" << endl;
         return status;
     }
-    status = clBuildProgram(program, numDevices, devices, NULL, NULL, NULL);
+    string options = MATH_MODE_OPTIONS[mathMode];
+    if (longIndex) {
+        options += " -DLONG_INDEX";
+    }
+    status = clBuildProgram(program, numDevices, devices, options.c_str(), NULL, NULL);
     if (CL_SUCCESS != status) {
         cout << "Error in clBuildProgram" << endl;
+        printBuildLog(program, devices[0]);
         return status;
     }
     kernel = clCreateKernel(program, "map", &status);
@@ -238,69 +273,117 @@ int openclInitialization() {
         cout << "Error in clCreateKernel, map kernel" << endl;
         return status;
     }
+    if (kernelReport) {
+        printProgramReport(program, devices[0], sourceFile);
+    }
+    checkLocalWorkSize(kernel, devices[0], "map", LOCAL_WORK_SIZE);
 
     return status;
 }
 
-void hostDataInitialization(int elements) {
+void hostDataInitialization(long elements) {
     input_size = sizeof(CanData) * elements;
     output_size = sizeof(AggregationInput) * elements;
 
-    cl_mem ddInput = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, input_size, NULL, NULL);
-    cl_mem ddResult = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, output_size, NULL, NULL);
+    // Pinned host memory is itself a buffer, so it is limited to one device
+    // allocation; larger datasets are kept in pageable memory
+    if (input_size <= maxAllocationSize) {
+        cl_mem ddInput = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, input_size, NULL, NULL);
+        cl_mem ddResult = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, output_size, NULL, NULL);
 
-    input = (CanData *) clEnqueueMapBuffer(commandQueue, ddInput, CL_TRUE, CL_MAP_WRITE, 0, input_size, 0, NULL, NULL, NULL);
-    result = (AggregationInput *) clEnqueueMapBuffer(commandQueue, ddResult, CL_TRUE, CL_MAP_READ, 0, output_size, 0, NULL, NULL, NULL);
+        input = (CanData *) clEnqueueMapBuffer(commandQueue, ddInput, CL_TRUE, CL_MAP_WRITE, 0, input_size, 0, NULL, NULL, NULL);
+        result = (AggregationInput *) clEnqueueMapBuffer(commandQueue, ddResult, CL_TRUE, CL_MAP_READ, 0, output_size, 0, NULL, NULL, NULL);
+    } else {
+        input = (CanData *) malloc(input_size);
+        result = (AggregationInput *) malloc(output_size);
+    }
 
-    srand((unsigned)time(NULL));
-    //#pragma omp parallel for
-    for (int i = 0; i < elements; i++) {
-        float random_value = (float) rand()/RAND_MAX;
+    generateInParallel(elements, [](long i) {
+        float random_value = randomFloat(seed, i);
         input[i].time=i;
         input[i].abs_lean_angle=random_value;
         input[i].abs_pitch_info=i;
         input[i].abs_front_wheel_speed=i;
-    }
+    });
 }
 
 int allocateBuffersOnGPU() {
     cl_int status;
-    d_input = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * sizeof(CanData), NULL, &status);
+    d_input = clCreateBuffer(context, CL_MEM_READ_WRITE, chunkElements * sizeof(CanData), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_input" << endl;
     }
-    d_result = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * sizeof(AggregationInput), NULL, &status);
+    d_result = clCreateBuffer(context, CL_MEM_READ_WRITE, chunkElements * sizeof(AggregationInput), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_result" << endl;
     }
     return status;
 }
 
-void writeBuffer() {
-    clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, elements * sizeof(CanData), input, 0, NULL, &writeEvent1);
+// Writes the records [offset, offset + count) to the device buffer
+void writeBuffer(size_t offset, size_t count) {
+    clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, count * sizeof(CanData), input + offset, 0, NULL, &writeEvent1);
     clFlush(commandQueue);
 }
 
-int runKernel() {
+// Runs map on the chunk in the device buffer, in launches of at most
+// MAX_LAUNCH_ITEMS work-items, and reads it back to result + offset. The
+// elements argument of each launch is the end of its range, so the grid-stride
+// loop of map.cl stops there. The time of every launch is added to kernelTime;
+// kernelEvent is the last launch.
+int runKernel(size_t offset, size_t count) {
     cl_int status;
     status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_input);
     status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_result);
 
-    size_t globalWorkSize[1];
     size_t localWorkSize[3];
-
-    globalWorkSize[0] = elements;
     localWorkSize[0] = LOCAL_WORK_SIZE;
     localWorkSize[1] = 1;
     localWorkSize[2] = 1;
 
-    clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &kernelEvent);
-    clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, elements * sizeof(AggregationInput), result, 0, NULL, &readEvent1);
+    vector<cl_event> launches;
+    for (size_t first = 0; first < count && CL_SUCCESS == status; first += MAX_LAUNCH_ITEMS) {
+        size_t launchItems = min(MAX_LAUNCH_ITEMS, count - first);
+        cl_long end = first + launchItems;
+        cl_int endInt = end;
+        status |= clSetKernelArg(kernel, 2, longIndex ? sizeof(cl_long) : sizeof(cl_int), longIndex ? (void *) &end : (void *) &endInt);
+
+        size_t globalWorkOffset[1] = {first};
+        size_t globalWorkSize[1] = {(launchItems + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE};
+        status |= clEnqueueNDRangeKernel(commandQueue, kernel, 1, globalWorkOffset, globalWorkSize, localWorkSize, 0, NULL, &kernelEvent);
+        launches.push_back(kernelEvent);
+    }
+    if (CL_SUCCESS != status) {
+        cout << "Error in clEnqueueNDRangeKernel" << endl;
+        return status;
+    }
+    clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, count * sizeof(AggregationInput), result + offset, 0, NULL, &readEvent1);
+    for (size_t l = 0; l < launches.size(); l++) {
+        kernelTime += getTime(launches[l]);
+        if (l + 1 < launches.size()) {
+            clReleaseEvent(launches[l]);
+        }
+    }
 
     return status;
 }
 
+int runKernel() {
+    return runKernel(0, elements);
+}
+
+// The benchmarks other than the main run take the whole dataset in one device
+// allocation and one launch, with int sizes
+bool fitsOneLaunch(const char *option) {
+    if ((size_t) elements > chunkElements || (size_t) elements > MAX_LAUNCH_ITEMS || longIndex) {
+        cout << "Error: " << option << " needs at most " << min(chunkElements, (size_t) INT_MAX / 4) << " elements" << endl;
+        return false;
+    }
+    return true;
+}
+
 void freeMemory() {
+    releaseSpecializedKernels(specializationCache);
     clReleaseKernel(kernel);
     clReleaseProgram(program);
     clReleaseCommandQueue(commandQueue);
@@ -314,63 +397,832 @@ void freeMemory() {
     free(devices);
 }
 
-double median(vector<long> data) {
-    if (data.empty()) {
-        return 0;
-    } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
-        }
-    }
-}
-
-double median(vector<double> data) {
-    if (data.empty()) {
-        return 0;
-    } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
-        }
-    }
-}
-
 float radians (float degree) {
     float pi = 3.14159265358979f;
     return degree * (pi/180);
 }
 
-AggregationInput* map(CanData* value, int elements) {
-    AggregationInput *output = (AggregationInput *) malloc(output_size);
-    for (int i = 0; i < elements; i++) {
-        input[i].time=i;
+// Sequential map of the records [begin, end)
+void mapRange(const CanData* value, AggregationInput* output, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
         // float radians_lean = (float) radians(value[i].abs_lean_angle);
         float radians_lean = (float) value[i].abs_lean_angle;
         float cotValue = (float) (cos(radians_lean) / sin(radians_lean));
-        float speedValue = (float) pow(value[i].abs_front_wheel_speed / 3.6F, 2);
+        float speed = value[i].abs_front_wheel_speed / 3.6F;
+        float speedValue = speed * speed;
         output[i].radius = (abs(cotValue) * speedValue) / 9.81F;
         output[i].abs_lean_angle = abs(value[i].abs_lean_angle);
         output[i].abs_front_wheel_speed = value[i].abs_front_wheel_speed;
     }
+}
+
+AggregationInput* map(CanData* value, long elements) {
+    AggregationInput *output = (AggregationInput *) malloc(output_size);
+    mapRange(value, output, 0, elements);
     return output;
 }
 
+// Runs the map with the CanData records stored as half, bf16 and int8 and
+// compares the fp32 AggregationInput records with those of the fp32 kernel.
+// The wheel speed of the main input is the record index, which overflows half
+// above 65504, so the benchmark uses a copy of the records with the speed
+// wrapped to STORAGE_MAX_SPEED km/h.
+int runStorageBenchmark() {
+    cl_int status;
+    cl_int records = elements;
+    const int inputFields = sizeof(CanData) / sizeof(float);
+    const int outputFields = sizeof(AggregationInput) / sizeof(float);
+    size_t inputValues = (size_t) elements * inputFields;
+    size_t outputValues = (size_t) elements * outputFields;
+    vector<CanData> storageInput(input, input + elements);
+    for (long i = 0; i < elements; i++) {
+        storageInput[i].abs_front_wheel_speed = i % STORAGE_MAX_SPEED;
+    }
+    // The records are packed floats
+    void *inputData = &storageInput[0];
+
+    // fp32 reference: the main kernel on the copy
+    cl_mem d_storageInput = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, input_size, inputData, &status);
+    cl_mem d_reference = clCreateBuffer(context, CL_MEM_WRITE_ONLY, output_size, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the fp32 storage reference" << endl;
+        return status;
+    }
+    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_storageInput);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_reference);
+    status |= clSetKernelArg(kernel, 2, sizeof(cl_int), &records);
+    size_t globalWorkSize = (elements + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE;
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    double fp32Time = timeStorageKernel(commandQueue, kernel, globalWorkSize, localWorkSize, &status);
+    vector<float> reference(outputValues);
+    status |= clEnqueueReadBuffer(commandQueue, d_reference, CL_TRUE, 0, output_size, &reference[0], 0, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error running the fp32 kernel" << endl;
+        return status;
+    }
+    clReleaseMemObject(d_storageInput);
+    clReleaseMemObject(d_reference);
+    printStorageResult("fp32", fp32Time, (double) sizeof(float) * (inputValues + outputValues), fp32Time, 0, 0);
+
+    // mapRecord comes from map.cl, in the precision mode of the map kernel
+    const char *storageFiles[] = {"map.cl", "storage.cl"};
+    char *storageSources[2];
+    cl_program storageProgram = buildProgramFromFiles(context, devices[0], 2, storageFiles, MATH_MODE_OPTIONS[mathMode], kernelReport, storageSources, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    float scales[inputFields];
+    storageScales((float *) inputData, inputValues, inputFields, scales);
+    vector<float> values(outputValues);
+    for (int f = 0; f < NUMBER_OF_STORAGE_FORMATS; f++) {
+        vector<cl_uchar> encoded = encodeStorage(f, (float *) inputData, inputValues, scales, inputFields);
+        cl_mem d_encoded = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, encoded.size(), &encoded[0], &status);
+        cl_mem d_values = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * outputValues, NULL, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateBuffer for the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+        cl_kernel storageKernel = clCreateKernel(storageProgram, STORAGE_KERNELS[f], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << STORAGE_KERNELS[f] << " kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(storageKernel, devices[0], STORAGE_KERNELS[f], LOCAL_WORK_SIZE);
+        status = clSetKernelArg(storageKernel, 0, sizeof(cl_mem), &d_encoded);
+        status |= clSetKernelArg(storageKernel, 1, sizeof(cl_mem), &d_values);
+        status |= clSetKernelArg(storageKernel, 2, sizeof(cl_int), &records);
+        if (f == STORAGE_INT8) {
+            status |= clSetKernelArg(storageKernel, 3, sizeof(scales), scales);
+        }
+        double kernelTime = timeStorageKernel(commandQueue, storageKernel, globalWorkSize, localWorkSize, &status);
+        status |= clEnqueueReadBuffer(commandQueue, d_values, CL_TRUE, 0, sizeof(float) * outputValues, &values[0], 0, NULL, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error running the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+
+        double maxError;
+        double rmsError;
+        storageError(&reference[0], &values[0], outputValues, &maxError, &rmsError);
+        double bytes = STORAGE_BYTES[f] * (double) inputValues + sizeof(float) * outputValues;
+        printStorageResult(STORAGE_NAMES[f], kernelTime, bytes, fp32Time, maxError, rmsError);
+
+        clReleaseKernel(storageKernel);
+        clReleaseMemObject(d_encoded);
+        clReleaseMemObject(d_values);
+    }
+    cout << "\n";
+
+    clReleaseProgram(storageProgram);
+    free(storageSources[0]);
+    free(storageSources[1]);
+    return CL_SUCCESS;
+}
+
+// Compresses n CanData records in blocks of COMPRESSION_BLOCK records, in the
+// format read by decompressCanData. blockOffsets holds the first word of every
+// block in the stream.
+void compressCanData(const void *records, int n, vector<cl_uint> &stream, vector<cl_uint> &blockOffsets) {
+    const cl_uint *words = (const cl_uint *) records;
+    stream.clear();
+    blockOffsets.clear();
+    for (int first = 0; first < n; first += COMPRESSION_BLOCK) {
+        int count = min(COMPRESSION_BLOCK, n - first);
+        size_t header = stream.size();
+        blockOffsets.push_back(header);
+        stream.resize(header + CAN_FIELDS * FIELD_HEADER_WORDS);
+        for (int f = 0; f < CAN_FIELDS; f++) {
+            // Deltas between consecutive bit patterns, modulo 2^32
+            cl_int minDelta = 0;
+            for (int k = 1; k < count; k++) {
+                cl_int delta = (cl_int) (words[(first + k) * CAN_FIELDS + f] - words[(first + k - 1) * CAN_FIELDS + f]);
+                minDelta = (k == 1) ? delta : min(minDelta, delta);
+            }
+            cl_uint maxOffset = 0;
+            for (int k = 1; k < count; k++) {
+                cl_uint delta = words[(first + k) * CAN_FIELDS + f] - words[(first + k - 1) * CAN_FIELDS + f];
+                maxOffset = max(maxOffset, delta - (cl_uint) minDelta);
+            }
+            cl_uint width = 0;
+            while (width < 32 && (maxOffset >> width) != 0) {
+                width++;
+            }
+            stream[header + f * FIELD_HEADER_WORDS] = words[first * CAN_FIELDS + f];
+            stream[header + f * FIELD_HEADER_WORDS + 1] = (cl_uint) minDelta;
+            stream[header + f * FIELD_HEADER_WORDS + 2] = width;
+
+            size_t packed = stream.size();
+            stream.resize(packed + ((count - 1) * width + 31) / 32, 0);
+            if (width == 0) {
+                continue;
+            }
+            for (int k = 1; k < count; k++) {
+                cl_uint offset = (words[(first + k) * CAN_FIELDS + f] - words[(first + k - 1) * CAN_FIELDS + f]) - (cl_uint) minDelta;
+                cl_uint position = (k - 1) * width;
+                cl_uint shift = position & 31;
+                stream[packed + position / 32] |= offset << shift;
+                if (shift + width > 32) {
+                    stream[packed + position / 32 + 1] |= offset >> (32 - shift);
+                }
+            }
+        }
+    }
+}
+
+// Compares the raw transfer of the records with the transfer of the compressed
+// stream followed by the decompression kernel, for growing numbers of records,
+// and reports from which number of records the compressed transfer wins. The
+// host compression time is reported apart, as the records could be compressed
+// where they are produced.
+int runCompressionBenchmark() {
+    cl_int status;
+    char *compressSource;
+    cl_program compressProgram = buildProgramFromFile(context, devices[0], "compress.cl", NULL, kernelReport, &compressSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel decompressKernel = clCreateKernel(compressProgram, "decompressCanData", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, decompressCanData kernel" << endl;
+        return status;
+    }
+    checkLocalWorkSize(decompressKernel, devices[0], "decompressCanData", COMPRESSION_BLOCK);
+
+    // Pinned staging buffers, like the raw records, sized for incompressible data
+    size_t maxBlocks = (elements + COMPRESSION_BLOCK - 1) / COMPRESSION_BLOCK;
+    size_t maxStreamSize = sizeof(cl_uint) * maxBlocks * CAN_FIELDS * (FIELD_HEADER_WORDS + COMPRESSION_BLOCK);
+    size_t maxOffsetsSize = sizeof(cl_uint) * maxBlocks;
+    cl_mem pinnedStream = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, maxStreamSize, NULL, &status);
+    cl_mem pinnedOffsets = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, maxOffsetsSize, NULL, &status);
+    cl_mem d_stream = clCreateBuffer(context, CL_MEM_READ_ONLY, maxStreamSize, NULL, &status);
+    cl_mem d_blockOffsets = clCreateBuffer(context, CL_MEM_READ_ONLY, maxOffsetsSize, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the compressed stream" << endl;
+        return status;
+    }
+    cl_uint *stagedStream = (cl_uint *) clEnqueueMapBuffer(commandQueue, pinnedStream, CL_TRUE, CL_MAP_WRITE, 0, maxStreamSize, 0, NULL, NULL, &status);
+    cl_uint *stagedOffsets = (cl_uint *) clEnqueueMapBuffer(commandQueue, pinnedOffsets, CL_TRUE, CL_MAP_WRITE, 0, maxOffsetsSize, 0, NULL, NULL, &status);
+
+    status = clSetKernelArg(decompressKernel, 0, sizeof(cl_mem), &d_stream);
+    status |= clSetKernelArg(decompressKernel, 1, sizeof(cl_mem), &d_blockOffsets);
+    status |= clSetKernelArg(decompressKernel, 3, sizeof(cl_mem), &d_input);
+    status |= clSetKernelArg(decompressKernel, 4, sizeof(cl_uint) * COMPRESSION_BLOCK, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, decompressCanData kernel" << endl;
+        return status;
+    }
+
+    vector<int> sizes;
+    for (int n = COMPRESSION_MIN_RECORDS; n < elements; n *= 4) {
+        sizes.push_back(n);
+    }
+    sizes.push_back(elements);
+
+    cout << "Compressed transfer: blocks of " << COMPRESSION_BLOCK << " records" << endl;
+    int crossover = -1;
+    int crossoverWithCompression = -1;
+    vector<cl_uint> stream;
+    vector<cl_uint> blockOffsets;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        int n = sizes[i];
+        auto compress_start = chrono::high_resolution_clock::now();
+        compressCanData(input, n, stream, blockOffsets);
+        memcpy(stagedStream, &stream[0], sizeof(cl_uint) * stream.size());
+        memcpy(stagedOffsets, &blockOffsets[0], sizeof(cl_uint) * blockOffsets.size());
+        double compressTime = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - compress_start).count();
+
+        size_t rawBytes = sizeof(CanData) * n;
+        size_t compressedBytes = sizeof(cl_uint) * (stream.size() + blockOffsets.size());
+        size_t globalWorkSize[1] = {blockOffsets.size() * COMPRESSION_BLOCK};
+        size_t localWorkSize[1] = {COMPRESSION_BLOCK};
+        status = clSetKernelArg(decompressKernel, 2, sizeof(cl_int), &n);
+
+        vector<long> rawTimers;
+        vector<long> compressedTimers;
+        for (int it = 0; it < COMPRESSION_ITERATIONS; it++) {
+            cl_event rawEvent;
+            status |= clEnqueueWriteBuffer(commandQueue, d_input, CL_FALSE, 0, rawBytes, input, 0, NULL, &rawEvent);
+            cl_event events[3];
+            status |= clEnqueueWriteBuffer(commandQueue, d_stream, CL_FALSE, 0, sizeof(cl_uint) * stream.size(), stagedStream, 0, NULL, &events[0]);
+            status |= clEnqueueWriteBuffer(commandQueue, d_blockOffsets, CL_FALSE, 0, sizeof(cl_uint) * blockOffsets.size(), stagedOffsets, 0, NULL, &events[1]);
+            status |= clEnqueueNDRangeKernel(commandQueue, decompressKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &events[2]);
+            if (CL_SUCCESS != status) {
+                cout << "Error running the compressed transfer" << endl;
+                return status;
+            }
+            rawTimers.push_back(getTime(rawEvent));
+            compressedTimers.push_back(getTime(events[0]) + getTime(events[1]) + getTime(events[2]));
+            clReleaseEvent(rawEvent);
+            for (int e = 0; e < 3; e++) {
+                clReleaseEvent(events[e]);
+            }
+        }
+        double rawTime = median(rawTimers);
+        double compressedTime = median(compressedTimers);
+        if (crossover < 0 && compressedTime < rawTime) {
+            crossover = n;
+        }
+        if (crossoverWithCompression < 0 && compressedTime + compressTime < rawTime) {
+            crossoverWithCompression = n;
+        }
+        cout << "Records " << n << ": Ratio " << (double) rawBytes / compressedBytes
+             << ", Raw " << rawTime << " (ns)"
+             << ", Compressed+Decompress " << compressedTime << " (ns)"
+             << ", HostCompression " << compressTime << " (ns)" << endl;
+    }
+
+    if (crossover > 0) {
+        cout << "Crossover: the compressed transfer is faster from " << crossover << " records" << endl;
+    } else {
+        cout << "Crossover: the raw transfer is faster up to " << elements << " records" << endl;
+    }
+    if (crossoverWithCompression > 0) {
+        cout << "Crossover with host compression: from " << crossoverWithCompression << " records" << endl;
+    } else {
+        cout << "Crossover with host compression: not reached up to " << elements << " records" << endl;
+    }
+
+    // The last run decompressed all the records into d_input
+    vector<CanData> decompressed(elements);
+    clEnqueueReadBuffer(commandQueue, d_input, CL_TRUE, 0, sizeof(CanData) * elements, &decompressed[0], 0, NULL, NULL);
+    bool valid = memcmp(&decompressed[0], input, sizeof(CanData) * elements) == 0;
+    cout << (valid ? "Decompressed records are correct" : "Decompressed records are not correct") << endl;
+    cout << "\n";
+
+    clEnqueueUnmapMemObject(commandQueue, pinnedStream, stagedStream, 0, NULL, NULL);
+    clEnqueueUnmapMemObject(commandQueue, pinnedOffsets, stagedOffsets, 0, NULL, NULL);
+    clFinish(commandQueue);
+    clReleaseMemObject(pinnedStream);
+    clReleaseMemObject(pinnedOffsets);
+    clReleaseMemObject(d_stream);
+    clReleaseMemObject(d_blockOffsets);
+    clReleaseKernel(decompressKernel);
+    clReleaseProgram(compressProgram);
+    free(compressSource);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Radius of one record computed in double and rounded once to float, the
+// reference of the precision modes. Lean angles with a zero sine have no
+// finite radius and return infinity.
+float referenceRadius(const CanData &record) {
+    double lean = record.abs_lean_angle;
+    double speed = record.abs_front_wheel_speed / 3.6;
+    return (float) (fabs(cos(lean) / sin(lean) * speed * speed) / 9.81);
+}
+
+// Distance between a value and its reference in units in the last place of
+// the reference
+double ulpError(float value, float reference) {
+    float magnitude = fabsf(reference);
+    double ulp = nextafterf(magnitude, INFINITY) - magnitude;
+    return fabs((double) value - reference) / ulp;
+}
+
+// Runs map.cl built for every precision mode and reports its throughput and
+// the maximum and mean ULP error and the maximum relative error of the radius
+int runMathModeComparison() {
+    cl_int status;
+    cl_int records = elements;
+    vector<float> reference(elements);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < elements; i++) {
+        reference[i] = referenceRadius(input[i]);
+    }
+
+    cl_mem d_modeResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, output_size, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the precision modes" << endl;
+        return status;
+    }
+    vector<AggregationInput> modeResult(elements);
+    // The grid-stride loop of map.cl guards the work-items past the records
+    size_t globalWorkSize = (elements + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE;
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+
+    for (int m = 0; m < NUMBER_OF_MATH_MODES; m++) {
+        char *modeSource;
+        cl_program modeProgram = buildProgramFromFile(context, devices[0], "map.cl", MATH_MODE_OPTIONS[m], kernelReport, &modeSource, &status);
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        cl_kernel modeKernel = clCreateKernel(modeProgram, "map", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, map kernel (" << MATH_MODE_NAMES[m] << ")" << endl;
+            return status;
+        }
+        checkLocalWorkSize(modeKernel, devices[0], "map", LOCAL_WORK_SIZE);
+        status = clSetKernelArg(modeKernel, 0, sizeof(cl_mem), &d_input);
+        status |= clSetKernelArg(modeKernel, 1, sizeof(cl_mem), &d_modeResult);
+        status |= clSetKernelArg(modeKernel, 2, sizeof(cl_int), &records);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clSetKernelArg" << endl;
+            return status;
+        }
+
+        vector<long> timers;
+        for (int i = 0; i < MATH_ITERATIONS; i++) {
+            cl_event event;
+            status = clEnqueueNDRangeKernel(commandQueue, modeKernel, 1, NULL, &globalWorkSize, localWorkSize, 0, NULL, &event);
+            if (CL_SUCCESS != status) {
+                cout << "Error in clEnqueueNDRangeKernel" << endl;
+                return status;
+            }
+            timers.push_back(getTime(event));
+            clReleaseEvent(event);
+        }
+        status = clEnqueueReadBuffer(commandQueue, d_modeResult, CL_TRUE, 0, output_size, &modeResult[0], 0, NULL, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clEnqueueReadBuffer" << endl;
+            return status;
+        }
+
+        double maxUlp = 0;
+        double sumUlp = 0;
+        double maxRelative = 0;
+        int compared = 0;
+        for (int i = 0; i < elements; i++) {
+            if (!isfinite(reference[i]) || reference[i] == 0) {
+                continue;
+            }
+            float radius = modeResult[i].radius;
+            double ulp = ulpError(radius, reference[i]);
+            maxUlp = max(maxUlp, ulp);
+            sumUlp += ulp;
+            maxRelative = max(maxRelative, fabs((double) radius - reference[i]) / fabs(reference[i]));
+            compared++;
+        }
+
+        double kernelTime = median(timers);
+        cout << "Math " << MATH_MODE_NAMES[m] << ": Median KernelTime " << kernelTime << " (ns)"
+             << ", Throughput " << (kernelTime > 0 ? elements / kernelTime * 1e3 : 0) << " Mrecords/s"
+             << ", MaxError " << maxUlp << " ulp, MeanError " << (compared > 0 ? sumUlp / compared : 0) << " ulp"
+             << ", MaxRelativeError " << maxRelative << endl;
+
+        clReleaseKernel(modeKernel);
+        clReleaseProgram(modeProgram);
+        free(modeSource);
+    }
+    cout << "\n";
+    clReleaseMemObject(d_modeResult);
+    return CL_SUCCESS;
+}
+
+cl_int processChunk(CoexecWorker &worker, size_t begin, size_t end) {
+    size_t count = end - begin;
+    if (!worker.device) {
+        mapRange(input, result, begin, end);
+        return CL_SUCCESS;
+    }
+    cl_long records = count;
+    cl_int recordsInt = count;
+    size_t localWorkSize = LOCAL_WORK_SIZE;
+    size_t globalWorkSize = (count + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE;
+    cl_int status = clEnqueueWriteBuffer(worker.queue, worker.d_input, CL_FALSE, 0, sizeof(CanData) * count, input + begin, 0, NULL, NULL);
+    status |= clSetKernelArg(worker.kernel, 2, longIndex ? sizeof(cl_long) : sizeof(cl_int), longIndex ? (void *) &records : (void *) &recordsInt);
+    status |= clEnqueueNDRangeKernel(worker.queue, worker.kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+    status |= clEnqueueReadBuffer(worker.queue, worker.d_output, CL_TRUE, 0, sizeof(AggregationInput) * count, result + begin, 0, NULL, NULL);
+    return status;
+}
+
+bool sameRecords(const AggregationInput *values, const AggregationInput *reference, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (fabs(values[i].radius - reference[i].radius) > 0.1f || fabs(values[i].abs_lean_angle - reference[i].abs_lean_angle) > 0.1f
+            || fabs(values[i].abs_front_wheel_speed - reference[i].abs_front_wheel_speed) > 0.1f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads the key=value lines of a device profile
+bool readDeviceProfile(const char *fileName, std::map<string, string> &profile) {
+    ifstream file(fileName);
+    if (!file) {
+        cout << "Error opening the device profile " << fileName << endl;
+        return false;
+    }
+    string line;
+    while (getline(file, line)) {
+        size_t separator = line.find('=');
+        if (line.empty() || line[0] == '#' || separator == string::npos) {
+            continue;
+        }
+        profile[line.substr(0, separator)] = line.substr(separator + 1);
+    }
+    return true;
+}
+
+// Records per ns of a device bound by the transfer of its records, from the
+// peak bandwidths of its profile, or 0 when the profile is of another device
+double profileThroughput(std::map<string, string> &profile, const string &deviceName) {
+    double h2d = atof(profile["h2d_peak_gbs"].c_str());
+    double d2h = atof(profile["d2h_peak_gbs"].c_str());
+    if (profile["device_name"] != deviceName || h2d <= 0 || d2h <= 0) {
+        return 0;
+    }
+    return 1.0 / (sizeof(CanData) / h2d + sizeof(AggregationInput) / d2h);
+}
+
+// Runs map with the devices only, the host workers only and both together,
+// and reports the utilization and the share of the records of every worker
+int runCoexecution() {
+    cl_int status = CL_SUCCESS;
+    int deviceWorkers = numberOfDevices;
+    if (hostWorkers < 0) {
+        hostWorkers = max(1, omp_get_max_threads() - deviceWorkers);
+    }
+    std::map<string, string> profile;
+    if (profileFile != NULL && !readDeviceProfile(profileFile, profile)) {
+        return -1;
+    }
+    vector<CoexecWorker> workers(deviceWorkers + hostWorkers);
+    for (int d = 0; d < deviceWorkers; d++) {
+        CoexecWorker &worker = workers[d];
+        char buf[1000];
+        clGetDeviceInfo(devices[d], CL_DEVICE_NAME, sizeof(buf), buf, NULL);
+        worker.name = "device " + to_string(d) + " (" + buf + ")";
+        worker.device = true;
+        worker.capacity = min(COEXEC_MAX_DEVICE_CHUNK, min(chunkElements, MAX_LAUNCH_ITEMS));
+        worker.firstChunk = COEXEC_FIRST_CHUNK;
+        worker.minChunk = COEXEC_MIN_CHUNK;
+        worker.profiledThroughput = profileThroughput(profile, buf);
+        worker.throughput = worker.profiledThroughput;
+        if (worker.profiledThroughput > 0) {
+            cout << "Device profile of " << worker.name << ": first chunk of " << coexecChunkSize(worker) << " records" << endl;
+        }
+        worker.queue = clCreateCommandQueue(context, devices[d], 0, &status);
+        worker.kernel = clCreateKernel(program, "map", &status);
+        worker.d_input = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(CanData) * worker.capacity, NULL, &status);
+        worker.d_output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(AggregationInput) * worker.capacity, NULL, &status);
+        status |= clSetKernelArg(worker.kernel, 0, sizeof(cl_mem), &worker.d_input);
+        status |= clSetKernelArg(worker.kernel, 1, sizeof(cl_mem), &worker.d_output);
+        if (CL_SUCCESS != status) {
+            cout << "Error creating the co-execution worker of device " << d << endl;
+            return status;
+        }
+        checkLocalWorkSize(worker.kernel, devices[d], "map", LOCAL_WORK_SIZE);
+    }
+    for (int h = 0; h < hostWorkers; h++) {
+        workers[deviceWorkers + h].name = "host " + to_string(h);
+        workers[deviceWorkers + h].device = false;
+        workers[deviceWorkers + h].capacity = elements;
+        workers[deviceWorkers + h].firstChunk = COEXEC_FIRST_CHUNK;
+        workers[deviceWorkers + h].minChunk = COEXEC_MIN_CHUNK;
+        workers[deviceWorkers + h].profiledThroughput = 0;
+    }
+
+    AggregationInput *reference = ::map(input, elements);
+    cout << "Co-execution: " << elements << " records, " << deviceWorkers << " device and " << hostWorkers << " host workers" << endl;
+    const char *names[] = {"Devices only  ", "Host only     ", "Devices + host"};
+    const int firsts[] = {0, deviceWorkers, 0};
+    const int lasts[] = {deviceWorkers, deviceWorkers + hostWorkers, deviceWorkers + hostWorkers};
+    double devicesTime = 0;
+    bool valid = true;
+    for (int c = 0; c < 3; c++) {
+        if (firsts[c] == lasts[c]) {
+            continue;
+        }
+        memset(result, 0, output_size);
+        double wallTime = runCoexecConfiguration(workers, firsts[c], lasts[c], elements, processChunk, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in the co-execution workers" << endl;
+            return status;
+        }
+        valid = valid && sameRecords(result, reference, elements);
+        if (c == 0) {
+            devicesTime = wallTime;
+        }
+        cout << names[c] << ": " << wallTime << " (ns), " << (wallTime > 0 ? elements / wallTime * 1e3 : 0) << " Mrecords/s, speedup "
+             << (wallTime > 0 ? devicesTime / wallTime : 0) << "x" << endl;
+    }
+    printCoexecWorkers(workers, elements, "records");
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+    cout << "\n";
+
+    for (int d = 0; d < deviceWorkers; d++) {
+        clReleaseMemObject(workers[d].d_input);
+        clReleaseMemObject(workers[d].d_output);
+        clReleaseKernel(workers[d].kernel);
+        clReleaseCommandQueue(workers[d].queue);
+    }
+    free(reference);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// One axis of a histogram: a field of AggregationInput (0 radius, 1
+// abs_lean_angle, 2 abs_front_wheel_speed) and its bins, of a fixed width
+// (1 / scale from minimum) or between custom edges when edges is not empty
+struct HistogramAxis {
+    string name;
+    int field;
+    int bins;
+    float minimum;
+    float scale;
+    vector<float> edges;
+};
+
+HistogramAxis fixedWidthAxis(const char *name, int field, int bins, float minimum, float maximum) {
+    HistogramAxis axis;
+    axis.name = name;
+    axis.field = field;
+    axis.bins = bins;
+    axis.minimum = minimum;
+    axis.scale = bins / (maximum - minimum);
+    return axis;
+}
+
+// Same binning as binOf in histogram.cl
+int hostBinOf(float value, const HistogramAxis &axis) {
+    if (!axis.edges.empty()) {
+        if (!(value >= axis.edges[0] && value < axis.edges[axis.bins])) {
+            return -1;
+        }
+        return upper_bound(axis.edges.begin(), axis.edges.end(), value) - axis.edges.begin() - 1;
+    }
+    float position = (value - axis.minimum) * axis.scale;
+    if (!(position >= 0.0F && position < axis.bins)) {
+        return -1;
+    }
+    return (int) position;
+}
+
+void hostHistogram(const AggregationInput *records, size_t n, const HistogramAxis &x, const HistogramAxis *y, vector<cl_uint> &bins) {
+    bins.assign(x.bins * (y != NULL ? y->bins : 1), 0);
+    for (size_t i = 0; i < n; i++) {
+        const float *fields = (const float *) &records[i];
+        int xBin = hostBinOf(fields[x.field], x);
+        int yBin = y != NULL ? hostBinOf(fields[y->field], *y) : 0;
+        if (xBin >= 0 && yBin >= 0) {
+            bins[yBin * x.bins + xBin]++;
+        }
+    }
+}
+
+cl_mem createEdgesBuffer(const HistogramAxis &axis, cl_int *status) {
+    if (axis.edges.empty()) {
+        return NULL;
+    }
+    return clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * axis.edges.size(), (void *) &axis.edges[0], status);
+}
+
+// Histogram of the records in d_result on the device, compared with reading
+// the records back and binning them on the host
+int runHistogram(cl_kernel histogramKernel, const HistogramAxis &x, const HistogramAxis *y) {
+    cl_int status = CL_SUCCESS;
+    cl_int xField = x.field;
+    cl_int xBins = x.bins;
+    cl_int yField = y != NULL ? y->field : 0;
+    cl_int yBins = y != NULL ? y->bins : 1;
+    float yMinimum = y != NULL ? y->minimum : 0;
+    float yScale = y != NULL ? y->scale : 0;
+    size_t numberOfBins = (size_t) xBins * yBins;
+    string name = x.name + (y != NULL ? " x " + y->name : "");
+
+    cl_ulong localMemory = 0;
+    clGetDeviceInfo(devices[0], CL_DEVICE_LOCAL_MEM_SIZE, sizeof(localMemory), &localMemory, NULL);
+    if (sizeof(cl_uint) * numberOfBins > localMemory) {
+        cout << "Histogram " << name << ": " << numberOfBins << " bins do not fit in local memory, skipped" << endl;
+        return CL_SUCCESS;
+    }
+
+    cl_int records = elements;
+    cl_mem d_xEdges = createEdgesBuffer(x, &status);
+    cl_mem d_yEdges = y != NULL ? createEdgesBuffer(*y, &status) : NULL;
+    cl_mem d_bins = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint) * numberOfBins, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the histogram " << name << endl;
+        return status;
+    }
+    status = clSetKernelArg(histogramKernel, 0, sizeof(cl_mem), &d_result);
+    status |= clSetKernelArg(histogramKernel, 1, sizeof(cl_int), &records);
+    status |= clSetKernelArg(histogramKernel, 2, sizeof(cl_int), &xField);
+    status |= clSetKernelArg(histogramKernel, 3, sizeof(cl_int), &xBins);
+    status |= clSetKernelArg(histogramKernel, 4, sizeof(float), &x.minimum);
+    status |= clSetKernelArg(histogramKernel, 5, sizeof(float), &x.scale);
+    status |= clSetKernelArg(histogramKernel, 6, sizeof(cl_mem), &d_xEdges);
+    status |= clSetKernelArg(histogramKernel, 7, sizeof(cl_int), &yField);
+    status |= clSetKernelArg(histogramKernel, 8, sizeof(cl_int), &yBins);
+    status |= clSetKernelArg(histogramKernel, 9, sizeof(float), &yMinimum);
+    status |= clSetKernelArg(histogramKernel, 10, sizeof(float), &yScale);
+    status |= clSetKernelArg(histogramKernel, 11, sizeof(cl_mem), &d_yEdges);
+    status |= clSetKernelArg(histogramKernel, 12, sizeof(cl_mem), &d_bins);
+    status |= clSetKernelArg(histogramKernel, 13, sizeof(cl_uint) * numberOfBins, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, histogram " << name << endl;
+        return status;
+    }
+
+    int groups = min(HISTOGRAM_MAX_GROUPS, max(1, (records + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE));
+    size_t globalWorkSize = (size_t) groups * LOCAL_WORK_SIZE;
+    size_t localWorkSize = LOCAL_WORK_SIZE;
+    vector<cl_uint> deviceBins(numberOfBins);
+    vector<cl_uint> zeros(numberOfBins, 0);
+    vector<long> deviceTimers;
+    for (int i = 0; i < HISTOGRAM_ITERATIONS; i++) {
+        cl_event histogramEvent;
+        cl_event binsEvent;
+        clEnqueueWriteBuffer(commandQueue, d_bins, CL_TRUE, 0, sizeof(cl_uint) * numberOfBins, &zeros[0], 0, NULL, NULL);
+        status = clEnqueueNDRangeKernel(commandQueue, histogramKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, &histogramEvent);
+        status |= clEnqueueReadBuffer(commandQueue, d_bins, CL_TRUE, 0, sizeof(cl_uint) * numberOfBins, &deviceBins[0], 0, NULL, &binsEvent);
+        if (CL_SUCCESS != status) {
+            cout << "Error in the histogram kernel " << name << endl;
+            return status;
+        }
+        deviceTimers.push_back(getTime(histogramEvent) + getTime(binsEvent));
+        clReleaseEvent(histogramEvent);
+        clReleaseEvent(binsEvent);
+    }
+
+    // Host path: every record is read back and binned
+    vector<AggregationInput> hostRecords(elements);
+    vector<cl_uint> hostBins;
+    vector<long> hostTimers;
+    for (int i = 0; i < HISTOGRAM_ITERATIONS; i++) {
+        cl_event recordsEvent;
+        clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, sizeof(AggregationInput) * elements, &hostRecords[0], 0, NULL, &recordsEvent);
+        auto start = chrono::high_resolution_clock::now();
+        hostHistogram(&hostRecords[0], elements, x, y, hostBins);
+        long binningTime = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+        hostTimers.push_back(getTime(recordsEvent) + binningTime);
+        clReleaseEvent(recordsEvent);
+    }
+
+    cl_ulong counted = 0;
+    for (size_t b = 0; b < numberOfBins; b++) {
+        counted += deviceBins[b];
+    }
+    double deviceTime = median(deviceTimers);
+    double hostTime = median(hostTimers);
+    cout << "Histogram " << name << " (" << numberOfBins << " bins, " << counted << " of " << elements << " records in range): device "
+         << deviceTime << " (ns) reading " << sizeof(cl_uint) * numberOfBins << " bytes, host " << hostTime << " (ns) reading "
+         << sizeof(AggregationInput) * elements << " bytes, speedup " << (deviceTime > 0 ? hostTime / deviceTime : 0) << "x, "
+         << (deviceBins == hostBins ? "bins are correct" : "bins are not correct") << endl;
+
+    if (d_xEdges != NULL) {
+        clReleaseMemObject(d_xEdges);
+    }
+    if (d_yEdges != NULL) {
+        clReleaseMemObject(d_yEdges);
+    }
+    clReleaseMemObject(d_bins);
+    return deviceBins == hostBins ? CL_SUCCESS : -1;
+}
+
+// Lean angle and wheel speed distributions of the map output: fixed-width
+// bins, custom (logarithmic) bins and a 2-D lean angle x speed histogram
+int runHistograms() {
+    cl_int status;
+    // d_result holds the map output of all the records
+    writeBuffer(0, elements);
+    status = runKernel();
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    char *histogramSource;
+    cl_program histogramProgram = buildProgramFromFile(context, devices[0], "histogram.cl", NULL, kernelReport, &histogramSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel histogramKernel = clCreateKernel(histogramProgram, "histogram", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, histogram kernel" << endl;
+        return status;
+    }
+    checkLocalWorkSize(histogramKernel, devices[0], "histogram", LOCAL_WORK_SIZE);
+
+    HistogramAxis leanAngle = fixedWidthAxis("abs_lean_angle", 1, 64, 0.0f, 1.0f);
+    HistogramAxis speed = fixedWidthAxis("abs_front_wheel_speed", 2, 32, 0.0f, elements);
+    // Logarithmic speed bins: [0, e^(1/32)), ..., [e^(31/32), e) with e the
+    // number of records
+    HistogramAxis logSpeed = speed;
+    logSpeed.name = "abs_front_wheel_speed (log bins)";
+    logSpeed.edges.push_back(0.0f);
+    for (int b = 1; b <= logSpeed.bins; b++) {
+        logSpeed.edges.push_back(pow((double) elements, (double) b / logSpeed.bins));
+    }
+    HistogramAxis coarseLeanAngle = fixedWidthAxis("abs_lean_angle", 1, 32, 0.0f, 1.0f);
+
+    bool valid = runHistogram(histogramKernel, leanAngle, NULL) == CL_SUCCESS;
+    valid &= runHistogram(histogramKernel, logSpeed, NULL) == CL_SUCCESS;
+    valid &= runHistogram(histogramKernel, coarseLeanAngle, &speed) == CL_SUCCESS;
+    cout << "\n";
+
+    clReleaseKernel(histogramKernel);
+    clReleaseProgram(histogramProgram);
+    free(histogramSource);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Records of the specialization benchmark that match
+bool sameRecord(const AggregationInput &record, const AggregationInput &reference) {
+    return fabs(record.radius - reference.radius) <= 0.01f;
+}
+
+// A/B benchmark of the generic kernel against the variant specialized for the
+// current number of elements (NUMBER_OF_ELEMENTS)
+int benchmarkSpecialization() {
+    cl_int status;
+    std::map<string, string> constants;
+    constants["NUMBER_OF_ELEMENTS"] = to_string(elements);
+    cl_kernel specialized = getSpecializedKernel(specializationCache, context, devices[0], 1, (const char **) &source, MATH_MODE_OPTIONS[mathMode], "map", constants, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    return runSpecializationBenchmark(kernel, specialized, runKernel, kernelEvent, readEvent1, result, elements, sameRecord);
+}
+
 int main(int argc, char **argv) {
     if (argc > 2) {
         platformId = atoi(argv[1]);
-        elements = atoi(argv[2]);
+        elements = atol(argv[2]);
     } else {
-        cout << "Run: ./host <platformId> <elements>" << endl;
+        cout << "Run: ./host <platformId> <elements> [--specialize] [--seed <n>] [--storage] [--compress] [--math <default|strict|relaxed|native|compare>] [--coexec] [--host-workers <n>] [--profile <file>] [--histogram] [--kernel-report]" << endl;
         return -1;
     }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--specialize") == 0) {
+            specialize = true;
+        } else if (strcmp(argv[i], "--storage") == 0) {
+            storage = true;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            compressTransfer = true;
+        } else if (strcmp(argv[i], "--math") == 0 && i + 1 < argc) {
+            const char *mode = argv[++i];
+            compareMathModes = strcmp(mode, "compare") == 0;
+            mathMode = compareMathModes ? MATH_DEFAULT : NUMBER_OF_MATH_MODES;
+            for (int m = 0; m < NUMBER_OF_MATH_MODES; m++) {
+                if (strcmp(mode, MATH_MODE_NAMES[m]) == 0) {
+                    mathMode = m;
+                }
+            }
+            if (mathMode == NUMBER_OF_MATH_MODES) {
+                cout << "Unknown precision mode: " << mode << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--histogram") == 0) {
+            histograms = true;
+        } else if (strcmp(argv[i], "--coexec") == 0) {
+            coexecute = true;
+        } else if (strcmp(argv[i], "--host-workers") == 0 && i + 1 < argc) {
+            hostWorkers = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profileFile = argv[++i];
+        } else if (strcmp(argv[i], "--kernel-report") == 0) {
+            kernelReport = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
 
     cout << "OpenCL KTM Map " << endl;
-    cout << "Number of Elements = " << elements * elements << endl;
+    cout << "Number of Elements = " << elements << endl;
+    cout << "Precision mode = " << MATH_MODE_NAMES[mathMode] << endl;
 
     vector<long> kernelTimers;
     vector<long> writeTimers;
@@ -380,7 +1232,14 @@ int main(int argc, char **argv) {
     if (openclInitialization() != CL_SUCCESS) {
         return -1;
     }
-    hostDataInitialization(elements);
+    if (chunkElements < (size_t) elements) {
+        cout << "Chunks of " << chunkElements << " records (CL_DEVICE_MAX_MEM_ALLOC_SIZE = " << maxAllocationSize << " bytes)" << endl;
+    }
+    if ((specialize && !fitsOneLaunch("--specialize")) || (storage && !fitsOneLaunch("--storage")) || (compressTransfer && !fitsOneLaunch("--compress"))
+        || (compareMathModes && !fitsOneLaunch("--math compare")) || (histograms && !fitsOneLaunch("--histogram"))) {
+        return -1;
+    }
+    timeHostDataInitialization(hostDataInitialization, elements);
     if (allocateBuffersOnGPU() != CL_SUCCESS) {
         return -1;
     }
@@ -391,15 +1250,16 @@ int main(int argc, char **argv) {
         readTime = 0;
 
         auto start_time = chrono::high_resolution_clock::now();
-        writeBuffer();
-        if (runKernel() != CL_SUCCESS) {
-            return -1;
+        for (size_t offset = 0; offset < (size_t) elements; offset += chunkElements) {
+            size_t count = min(chunkElements, elements - offset);
+            writeBuffer(offset, count);
+            if (runKernel(offset, count) != CL_SUCCESS) {
+                return -1;
+            }
+            writeTime += getTime(writeEvent1);
+            readTime += getTime(readEvent1);
         }
         auto end_time = chrono::high_resolution_clock::now();
-        writeTime = getTime(writeEvent1);
-        writeTime += getTime(writeEvent2);
-        kernelTime = getTime(kernelEvent);
-        readTime = getTime(readEvent1);
 
         kernelTimers.push_back(kernelTime);
         writeTimers.push_back(writeTime);
@@ -416,12 +1276,12 @@ int main(int argc, char **argv) {
         cout << "C++ total: " << total << endl;
         cout << "\n";
 
-        AggregationInput* result_seq = map(input, elements);
+        AggregationInput* result_seq = ::map(input, elements);
         // matrixVectorMultiplication(A_seq, B_seq, C_seq, elements);
 
         if (CHECK_RESULT) {
             bool valid = true;
-            for (int i = 0; i < elements; i++) {
+            for (long i = 0; i < elements; i++) {
                 float diff;
                 diff = fabs(result[i].radius - result_seq[i].radius);
                 if (diff > 0.1f) {
@@ -453,6 +1313,30 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (specialize && benchmarkSpecialization() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (storage && runStorageBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (compressTransfer && runCompressionBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (compareMathModes && runMathModeComparison() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (coexecute && runCoexecution() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (histograms && runHistograms() != CL_SUCCESS) {
+        return -1;
+    }
+
     freeMemory();
 
     // Compute median
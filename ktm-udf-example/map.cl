@@ -1,10 +1,53 @@
-__kernel void map(__global uchar *value, __global uchar *output)
+// Building with -DNUMBER_OF_ELEMENTS=<n> specializes the kernel for one input
+// size; the elements argument is then ignored.
+#ifdef NUMBER_OF_ELEMENTS
+#define ELEMENTS NUMBER_OF_ELEMENTS
+#else
+#define ELEMENTS elements
+#endif
+
+// Precision modes (--math in host.cpp). By default the kernel uses the native
+// cos and sin and exact divisions. Building with -DMATH_STRICT uses the
+// full-precision built-ins; the relaxed mode is the strict source built with
+// -cl-fast-relaxed-math -cl-mad-enable. -DMATH_NATIVE also uses native_divide.
+// The native built-ins have an implementation-defined accuracy.
+#if defined(MATH_STRICT)
+#define MAP_COS cos
+#define MAP_SIN sin
+#define MAP_DIVIDE(x, y) ((x) / (y))
+#elif defined(MATH_NATIVE)
+#define MAP_COS native_cos
+#define MAP_SIN native_sin
+#define MAP_DIVIDE native_divide
+#else
+#define MAP_COS native_cos
+#define MAP_SIN native_sin
+#define MAP_DIVIDE(x, y) ((x) / (y))
+#endif
+
+// Building with -DLONG_INDEX computes the record and float indices, and takes
+// elements, in 64 bits, for chunks of more than INT_MAX / 4 records.
+#ifdef LONG_INDEX
+#define INDEX long
+#else
+#define INDEX int
+#endif
+
+// AggregationInput of one CanData record, in the active precision mode. Also
+// used by the storage variants in storage.cl.
+float3 mapRecord(float4 value)
+{
+    float cotValue = MAP_DIVIDE(MAP_COS(value.s1), MAP_SIN(value.s1));
+    float speed = MAP_DIVIDE(value.s3, 3.6F);
+    return (float3)(MAP_DIVIDE(fabs(cotValue * speed * speed), 9.81F), fabs(value.s1), value.s3);
+}
+
+__kernel void map(__global uchar *value, __global uchar *output, __private INDEX elements)
 {
   ulong ul_1, ul_8, ul_14, ul_0; 
   float3 v3f_25; 
   long l_6, l_7, l_12, l_13; 
-  int i_11, i_10, i_5, i_4, i_3, i_2, i_29; 
-  float f_28, f_27, f_26, f_24, f_23, f_22, f_21, f_20, f_19, f_18, f_17, f_16, f_15; 
+  INDEX i_11, i_10, i_5, i_4, i_3, i_2, i_29; 
   float4 v4f_9; 
 
   // BLOCK 0
@@ -14,7 +57,7 @@ __kernel void map(__global uchar *value, __global uchar *output)
   i_3  =  get_global_id(0);
   // BLOCK 1 MERGES [0 2 ]
   i_4  =  i_3;
-  for(;i_4 < 1024;)
+  for(;i_4 < ELEMENTS;)
   {
     // BLOCK 2
     i_5  =  i_4 << 2;
@@ -27,21 +70,7 @@ __kernel void map(__global uchar *value, __global uchar *output)
     l_12  =  (long) i_11;
     l_13  =  l_12 << 2;
     ul_14  =  ul_1 + l_13;
-    //f_15  =  radians(v4f_9.s1);
-    f_15  =  v4f_9.s1;
-    f_16  =  native_cos(f_15);
-    f_17  =  native_sin(f_15);
-    f_18  =  f_16 / f_17;
-    f_19  =  v4f_9.s3 / 3.6F;
-    f_20  =  pow(f_19, 2.0F);
-    f_21  =  f_18 * f_20;
-    f_22  =  fabs(f_21);
-    f_23  =  f_22 / 9.81F;
-    f_24  =  fabs(v4f_9.s1);
-    f_26  =  f_23;
-    f_27  =  f_24;
-    f_28  =  v4f_9.s3;
-    v3f_25  =  (float3)(f_26, f_27, f_28);
+    v3f_25  =  mapRecord(v4f_9);
     vstore3(v3f_25, 0, (__global float *) ul_14);
     i_29  =  i_2 + i_4;
     i_4  =  i_29;
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Reduced-precision storage variants of the KTM map. The CanData records are
+// stored as four half, bfloat16 or int8 values and the AggregationInput
+// records are computed by mapRecord and written in fp32. The program is built
+// from map.cl and this file, in the precision mode of the map kernel. Half
+// values are accessed with vload_half4, which does not need cl_khr_fp16. int8
+// values are symmetrically quantized with one scale per field, as the fields
+// have different ranges.
+
+__kernel void mapHalf(__global const half *input, __global float *output, const int elements)
+{
+    for (int i = get_global_id(0); i < elements; i += get_global_size(0)) {
+        vstore3(mapRecord(vload_half4(i, input)), i, output);
+    }
+}
+
+__kernel void mapBf16(__global const ushort *input, __global float *output, const int elements)
+{
+    for (int i = get_global_id(0); i < elements; i += get_global_size(0)) {
+        float4 value = as_float4(convert_uint4(vload4(i, input)) << 16);
+        vstore3(mapRecord(value), i, output);
+    }
+}
+
+__kernel void mapInt8(__global const char *input, __global float *output, const int elements, const float4 scales)
+{
+    for (int i = get_global_id(0); i < elements; i += get_global_size(0)) {
+        vstore3(mapRecord(convert_float4(vload4(i, input)) * scales), i, output);
+    }
+}
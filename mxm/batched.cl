@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Batched GEMV and GEMM on many small square matrices with one launch: the
+// work-group b works on matrix b of the batch. The operands of a batch are
+// either packed one after the other (strided batch, the offsets argument is
+// NULL) or placed anywhere in their buffer, with their element offsets in a
+// table (pointer-array batch). The batch index is taken from the global id,
+// so that a single matrix can also be launched with a global work offset.
+
+#define GEMM_TILE 16
+
+int batchIndex()
+{
+    return get_global_id(0) / get_local_size(0);
+}
+
+int operandOffset(__global const int *offsets, const int elementsPerMatrix, int batch)
+{
+    return offsets ? offsets[batch] : batch * elementsPerMatrix;
+}
+
+// y = A * x: x is staged in local memory and every work-item computes the rows
+// lid, lid + local size, ...
+__kernel void gemvBatched(__global const float *A, __global const int *offsetsA,
+                          __global const float *x, __global const int *offsetsX,
+                          __global float *y, __global const int *offsetsY,
+                          const int size, __local float *xLocal)
+{
+    int batch = batchIndex();
+    int lid = get_local_id(0);
+    A += operandOffset(offsetsA, size * size, batch);
+    x += operandOffset(offsetsX, size, batch);
+    y += operandOffset(offsetsY, size, batch);
+
+    for (int j = lid; j < size; j += get_local_size(0)) {
+        xLocal[j] = x[j];
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int row = lid; row < size; row += get_local_size(0)) {
+        float sum = 0.0F;
+        for (int j = 0; j < size; j++) {
+            sum = fma(A[row * size + j], xLocal[j], sum);
+        }
+        y[row] = sum;
+    }
+}
+
+// C = A * B with a work-group of GEMM_TILE x GEMM_TILE work-items, which
+// computes C tile by tile from tiles of A and B staged in local memory. Sizes
+// that are not a multiple of GEMM_TILE are padded with zeros.
+__kernel void gemmBatched(__global const float *A, __global const int *offsetsA,
+                          __global const float *B, __global const int *offsetsB,
+                          __global float *C, __global const int *offsetsC,
+                          const int size)
+{
+    __local float tileA[GEMM_TILE][GEMM_TILE];
+    __local float tileB[GEMM_TILE][GEMM_TILE];
+    int batch = batchIndex();
+    int tx = get_local_id(0) % GEMM_TILE;
+    int ty = get_local_id(0) / GEMM_TILE;
+    A += operandOffset(offsetsA, size * size, batch);
+    B += operandOffset(offsetsB, size * size, batch);
+    C += operandOffset(offsetsC, size * size, batch);
+
+    int tiles = (size + GEMM_TILE - 1) / GEMM_TILE;
+    for (int tileRow = 0; tileRow < tiles; tileRow++) {
+        for (int tileColumn = 0; tileColumn < tiles; tileColumn++) {
+            int row = tileRow * GEMM_TILE + ty;
+            int column = tileColumn * GEMM_TILE + tx;
+            float sum = 0.0F;
+            for (int t = 0; t < tiles; t++) {
+                int k = t * GEMM_TILE;
+                tileA[ty][tx] = (row < size && k + tx < size) ? A[row * size + k + tx] : 0.0F;
+                tileB[ty][tx] = (k + ty < size && column < size) ? B[(k + ty) * size + column] : 0.0F;
+                barrier(CLK_LOCAL_MEM_FENCE);
+                for (int kk = 0; kk < GEMM_TILE; kk++) {
+                    sum = fma(tileA[ty][kk], tileB[kk][tx], sum);
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+            if (row < size && column < size) {
+                C[row * size + column] = sum;
+            }
+        }
+    }
+}
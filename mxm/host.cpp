@@ -28,11 +28,16 @@
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <climits>
 #include <math.h>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 
@@ -46,12 +51,89 @@ const bool CHECK_RESULT = true;
 #include <CL/cl.h>
 #endif
 
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/hostdata.h"
+#include "../common/specialize.h"
+#include "../common/storage.h"
+#include "../common/coexec.h"
+
 int platformId = 0;
 const int LOCAL_WORK_SIZE = 256;
 const int ITERATIONS = 1;
 
+// Seed of the input data (--seed <n>)
+cl_ulong seed = 42;
+
+// Reduced-precision storage compared with fp32 (--storage): the inputs are
+// stored as half, bfloat16 or int8 and widened to fp32 in storage.cl
+const char *STORAGE_KERNELS[] = {"matrixVectorMultiplicationHalf", "matrixVectorMultiplicationBf16", "matrixVectorMultiplicationInt8"};
+bool storage = false;
+
+// Sparse matrix-vector multiplication (--spmv, --matrix <file.mtx>): CSR
+// scalar and vector kernels and SELL-C-sigma (spmv.cl), compared with the
+// dense kernel on random matrices of increasing sparsity or on a Matrix Market
+// file
+const double SPMV_DENSITIES[] = {0.5, 0.2, 0.05, 0.01, 0.001};
+const int NUMBER_OF_SPMV_DENSITIES = 5;
+const int SPMV_WORK_GROUP_SIZE = 256;
+const int CSR_VECTOR_LANES = 32;
+const int SELL_CHUNK = 32;
+const int SELL_SIGMA = 1024;
+const int SPMV_ITERATIONS = 10;
+const double SPMV_TOLERANCE = 1e-3;
+bool spmv = false;
+const char *matrixFile = NULL;
+
+// Batched small GEMV/GEMM (--small-batch <matrices>): one launch covers a
+// strided or pointer-array batch with one work-group per matrix (batched.cl),
+// compared with one launch per matrix
+const int SMALL_BATCH_SIZES[] = {16, 32, 64, 128};
+const int NUMBER_OF_SMALL_BATCH_SIZES = 4;
+const int GEMM_TILE = 16;
+const size_t SMALL_BATCH_MAX_BYTES = 256 << 20;
+const int SMALL_BATCH_ITERATIONS = 5;
+int smallBatchMatrices = 0;
+
+// Out-of-core multiplication (--out-of-core gemv|gemm, --device-mem <MB>): A,
+// and B for GEMM, are generated panel by panel on the host from the same
+// generator as the in-core data, and streamed through a fixed device working
+// set of double-buffered panels. Uploads, kernels and downloads run on their
+// own queues, so the transfers of one panel overlap the kernel of the other.
+enum OutOfCoreMode {OUT_OF_CORE_OFF, OUT_OF_CORE_GEMV, OUT_OF_CORE_GEMM};
+OutOfCoreMode outOfCoreMode = OUT_OF_CORE_OFF;
+size_t deviceMemoryBudget = (size_t) 64 << 20;
+const int PANEL_TILE = 16;
+const int OUT_OF_CORE_CHECKS = 4;
+const double OUT_OF_CORE_TOLERANCE = 1e-3;
+
+// A/B benchmark of the generic and the specialized kernel (--specialize)
+bool specialize = false;
+SpecializationCache specializationCache;
+
+// Resource report of the kernels of every program built (--kernel-report)
+bool kernelReport = false;
+
+// Co-execution of the matrix-vector multiplication on the OpenCL devices and
+// on host worker threads (--coexec [--host-workers <n>]), with the
+// work-stealing scheduler of common/coexec.h over the rows of A. A device
+// runs matrixVectorMultiplicationRows on the rows of its chunks, with B in one
+// buffer shared by the devices. By default there is one host worker per
+// OpenMP thread not driving a device.
+const size_t COEXEC_FIRST_ROWS = 256;
+const size_t COEXEC_MIN_ROWS = 16;
+bool coexecute = false;
+int hostWorkers = -1;
+cl_mem d_coexecB;
+
 int elements = 1024;
 
+// Matrices of more than INT_MAX elements need the -DLONG_INDEX build of
+// mykernel.cl; matrices larger than one device allocation
+// (CL_DEVICE_MAX_MEM_ALLOC_SIZE) only run out-of-core
+cl_ulong maxAllocationSize;
+bool longIndex = false;
+
 float alpha;
 
 // Variables
@@ -67,6 +149,7 @@ string platformName;
 cl_uint numPlatforms;
 cl_platform_id *platforms;
 cl_device_id *devices;
+cl_uint numberOfDevices;
 cl_context context;
 cl_command_queue commandQueue;
 cl_kernel kernel;
@@ -86,65 +169,6 @@ long kernelTime;
 long writeTime;
 long readTime;
 
-long getTime(cl_event event) {
-    clWaitForEvents(1, &event);
-    cl_ulong time_start, time_end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
-    return (time_end - time_start);
-}
-
-char *readsource(const char *sourceFilename) {
-    FILE *fp;
-    int err;
-    int size;
-    char *source;
-
-    fp = fopen(sourceFilename, "rb");
-
-    if (fp == NULL) {
-        printf("Could not open kernel file: %s\n", sourceFilename);
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_END);
-
-    if (err != 0) {
-        printf("Error seeking to end of file\n");
-        exit(-1);
-
-    }
-    size = ftell(fp);
-
-    if (size < 0) {
-        printf("Error getting file position\n");
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_SET);
-    if (err != 0) {
-        printf("Error seeking to start of file\n");
-        exit(-1);
-
-    }
-
-    source = (char *) malloc(size + 1);
-
-    if (source == NULL) {
-        printf("Error allocating %d bytes for the program source\n", size + 1);
-        exit(-1);
-    }
-
-    err = fread(source, 1, size, fp);
-    if (err != size) {
-        printf("only read %d bytes\n", err);
-        exit(0);
-    }
-
-    source[size] = '\0';
-    return source;
-}
-
 int openclInitialization() {
     cl_int status;
     cl_uint numPlatforms = 0;
@@ -202,6 +226,7 @@ int openclInitialization() {
         cout << "\tDEVICE NAME: " << buf << endl;
     }
 
+    numberOfDevices = numDevices;
     context = clCreateContext(NULL, numDevices, devices, NULL, NULL, &status);
     if (status != CL_SUCCESS) {
         cout << "Error in clCreateContext" << endl;
@@ -222,9 +247,12 @@ int openclInitialization() {
         cout << "Error in clCreateProgramWithSource" << endl;
         return status;
     }
-    status = clBuildProgram(program, numDevices, devices, NULL, NULL, NULL);
+    clGetDeviceInfo(devices[0], CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAllocationSize), &maxAllocationSize, NULL);
+    longIndex = (size_t) elements * elements > INT_MAX;
+    status = clBuildProgram(program, numDevices, devices, longIndex ? "-DLONG_INDEX" : NULL, NULL, NULL);
     if (CL_SUCCESS != status) {
         cout << "Error in clBuildProgram" << endl;
+        printBuildLog(program, devices[0]);
         return status;
     }
     kernel = clCreateKernel(program, "matrixVectorMultiplication", &status);
@@ -232,6 +260,10 @@ int openclInitialization() {
         cout << "Error in clCreateKernel, matrixVectorMultiplication kernel" << endl;
         return status;
     }
+    if (kernelReport) {
+        printProgramReport(program, devices[0], sourceFile);
+    }
+    checkLocalWorkSize(kernel, devices[0], "matrixVectorMultiplication", LOCAL_WORK_SIZE);
 
     return status;
 }
@@ -252,25 +284,30 @@ void hostDataInitialization(int elements) {
     B_seq = (float *) malloc(datasize);
     C_seq = (float *) malloc(datasize);
 
-    for (int i = 0; i < elements * elements; i++) {
-        A[i] = 4.0f;
-        A_seq[i] = A[i];
-        B[i] = i;
-        B_seq[i] = B[i];
-    }
+    // One row per index, the same split as the reference computation
+    generateInParallel(elements, [elements](long i) {
+        for (int j = 0; j < elements; j++) {
+            cl_ulong index = (cl_ulong) i * elements + j;
+            A[index] = randomFloat(seed, 2 * index);
+            A_seq[index] = A[index];
+            B[index] = randomFloat(seed, 2 * index + 1);
+            B_seq[index] = B[index];
+            C_seq[index] = 0.0f;
+        }
+    });
 }
 
 int allocateBuffersOnGPU() {
     cl_int status;
-    d_A = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * elements * sizeof(float), NULL, &status);
+    d_A = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) elements * elements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_A" << endl;
     }
-    d_B = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * elements * sizeof(float), NULL, &status);
+    d_B = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) elements * elements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_B" << endl;
     }
-    d_C = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * elements * sizeof(float), NULL, &status);
+    d_C = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) elements * elements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_C" << endl;
     }
@@ -278,8 +315,8 @@ int allocateBuffersOnGPU() {
 }
 
 void writeBuffer() {
-    clEnqueueWriteBuffer(commandQueue, d_A, CL_TRUE, 0, elements * elements * sizeof(float), A, 0, NULL, &writeEvent1);
-    clEnqueueWriteBuffer(commandQueue, d_B, CL_TRUE, 0, elements * elements * sizeof(float), B, 0, NULL, &writeEvent2);
+    clEnqueueWriteBuffer(commandQueue, d_A, CL_TRUE, 0, (size_t) elements * elements * sizeof(float), A, 0, NULL, &writeEvent1);
+    clEnqueueWriteBuffer(commandQueue, d_B, CL_TRUE, 0, (size_t) elements * elements * sizeof(float), B, 0, NULL, &writeEvent2);
     clFlush(commandQueue);
 }
 
@@ -299,12 +336,13 @@ int runKernel() {
     localWorkSize[2] = 1;
 
     clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &kernelEvent);
-    clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * elements * elements, C, 0, NULL, &readEvent1);
+    clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * (size_t) elements * elements, C, 0, NULL, &readEvent1);
 
     return status;
 }
 
 void freeMemory() {
+    releaseSpecializedKernels(specializationCache);
     clReleaseKernel(kernel);
     clReleaseProgram(program);
     clReleaseCommandQueue(commandQueue);
@@ -322,40 +360,1144 @@ void freeMemory() {
     free(devices);
 }
 
-double median(vector<long> data) {
-    if (data.empty()) {
-        return 0;
+void matrixVectorMultiplication(float* A_seq, float* B_seq, float* C_seq, int size) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        float sum = 0.0f;
+        for (int j = 0; j < size; j++) {
+            sum += A_seq[((size_t) i * size) + j] * B_seq[j];
+        }
+        C_seq[i] = sum;
+    }
+}
+
+// Runs the matrix-vector multiplication with A and B stored as half, bf16 and
+// int8 and compares it with the fp32 kernel. The bandwidth counts every byte
+// of A and B once.
+int runStorageBenchmark() {
+    cl_int status;
+    size_t globalWorkSize = elements;
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    // The main kernel keeps the arguments of its last run
+    double fp32Time = timeStorageKernel(commandQueue, kernel, globalWorkSize, localWorkSize, &status);
+    vector<float> reference(elements);
+    status |= clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * elements, &reference[0], 0, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error running the fp32 kernel" << endl;
+        return status;
+    }
+    size_t matrixElements = (size_t) elements * elements;
+    printStorageResult("fp32", fp32Time, sizeof(float) * (matrixElements + 2.0 * elements), fp32Time, 0, 0);
+
+    char *storageSource;
+    cl_program storageProgram = buildProgramFromFile(context, devices[0], "storage.cl", NULL, kernelReport, &storageSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    float scaleA;
+    float scaleB;
+    storageScales(A, matrixElements, 1, &scaleA);
+    storageScales(B, elements, 1, &scaleB);
+    vector<float> values(elements);
+    for (int f = 0; f < NUMBER_OF_STORAGE_FORMATS; f++) {
+        vector<cl_uchar> a = encodeStorage(f, A, matrixElements, &scaleA, 1);
+        vector<cl_uchar> b = encodeStorage(f, B, elements, &scaleB, 1);
+        cl_mem d_a = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, a.size(), &a[0], &status);
+        cl_mem d_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, b.size(), &b[0], &status);
+        cl_mem d_c = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * elements, NULL, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateBuffer for the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+        cl_kernel storageKernel = clCreateKernel(storageProgram, STORAGE_KERNELS[f], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << STORAGE_KERNELS[f] << " kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(storageKernel, devices[0], STORAGE_KERNELS[f], LOCAL_WORK_SIZE);
+        status = clSetKernelArg(storageKernel, 0, sizeof(cl_mem), &d_a);
+        status |= clSetKernelArg(storageKernel, 1, sizeof(cl_mem), &d_b);
+        status |= clSetKernelArg(storageKernel, 2, sizeof(cl_mem), &d_c);
+        status |= clSetKernelArg(storageKernel, 3, sizeof(cl_int), &elements);
+        if (f == STORAGE_INT8) {
+            status |= clSetKernelArg(storageKernel, 4, sizeof(cl_float), &scaleA);
+            status |= clSetKernelArg(storageKernel, 5, sizeof(cl_float), &scaleB);
+        }
+        double kernelTime = timeStorageKernel(commandQueue, storageKernel, globalWorkSize, localWorkSize, &status);
+        status |= clEnqueueReadBuffer(commandQueue, d_c, CL_TRUE, 0, sizeof(float) * elements, &values[0], 0, NULL, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error running the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+
+        double maxError;
+        double rmsError;
+        storageError(&reference[0], &values[0], elements, &maxError, &rmsError);
+        double bytes = STORAGE_BYTES[f] * (double) (matrixElements + elements) + sizeof(float) * elements;
+        printStorageResult(STORAGE_NAMES[f], kernelTime, bytes, fp32Time, maxError, rmsError);
+
+        clReleaseKernel(storageKernel);
+        clReleaseMemObject(d_a);
+        clReleaseMemObject(d_b);
+        clReleaseMemObject(d_c);
+    }
+    cout << "\n";
+
+    clReleaseProgram(storageProgram);
+    free(storageSource);
+    return CL_SUCCESS;
+}
+
+struct CsrMatrix {
+    int rows;
+    int columns;
+    vector<int> rowOffsets;
+    vector<int> columnIndices;
+    vector<float> values;
+};
+
+struct SellMatrix {
+    int chunk;
+    vector<int> sliceOffsets;
+    vector<int> sliceWidths;
+    vector<int> columnIndices;
+    vector<float> values;
+    vector<int> rowPermutation;
+};
+
+// Random square matrix with the values of A where a second draw is below the
+// density, and zeros elsewhere
+CsrMatrix randomCsrMatrix(int size, double density) {
+    CsrMatrix matrix;
+    matrix.rows = size;
+    matrix.columns = size;
+    matrix.rowOffsets.assign(size + 1, 0);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            cl_ulong index = (cl_ulong) i * size + j;
+            matrix.rowOffsets[i + 1] += randomFloat(seed, 3 * index + 2) < density;
+        }
+    }
+    for (int i = 0; i < size; i++) {
+        matrix.rowOffsets[i + 1] += matrix.rowOffsets[i];
+    }
+    matrix.columnIndices.resize(matrix.rowOffsets[size]);
+    matrix.values.resize(matrix.rowOffsets[size]);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        int k = matrix.rowOffsets[i];
+        for (int j = 0; j < size; j++) {
+            cl_ulong index = (cl_ulong) i * size + j;
+            if (randomFloat(seed, 3 * index + 2) < density) {
+                matrix.columnIndices[k] = j;
+                matrix.values[k] = randomFloat(seed, 2 * index);
+                k++;
+            }
+        }
+    }
+    return matrix;
+}
+
+// Reads a Matrix Market coordinate file (real, integer or pattern; general,
+// symmetric or skew-symmetric) into CSR. The indices of the file are 1-based.
+bool loadMatrixMarket(const char *fileName, CsrMatrix &matrix) {
+    ifstream file(fileName);
+    if (!file) {
+        cout << "Could not open matrix file: " << fileName << endl;
+        return false;
+    }
+    string banner;
+    getline(file, banner);
+    transform(banner.begin(), banner.end(), banner.begin(), ::tolower);
+    if (banner.find("%%matrixmarket matrix coordinate") != 0 || banner.find("complex") != string::npos) {
+        cout << "Only real, integer or pattern coordinate Matrix Market files are supported: " << fileName << endl;
+        return false;
+    }
+    bool pattern = banner.find("pattern") != string::npos;
+    bool skew = banner.find("skew-symmetric") != string::npos;
+    bool symmetric = skew || banner.find("symmetric") != string::npos;
+
+    string line;
+    while (getline(file, line) && (line.empty() || line[0] == '%')) {
+    }
+    long entries;
+    istringstream size(line);
+    if (!(size >> matrix.rows >> matrix.columns >> entries) || matrix.rows <= 0 || matrix.columns <= 0 || entries < 0) {
+        cout << "Error reading the size line of " << fileName << endl;
+        return false;
+    }
+    if (symmetric && matrix.rows != matrix.columns) {
+        cout << "Error in loadMatrixMarket: the symmetric matrix of " << fileName << " is not square" << endl;
+        return false;
+    }
+
+    vector<int> rows;
+    vector<int> columns;
+    vector<float> values;
+    for (long e = 0; e < entries; e++) {
+        int row;
+        int column;
+        float value = 1.0f;
+        if (!(file >> row >> column) || (!pattern && !(file >> value))) {
+            cout << "Error reading entry " << e << " of " << fileName << endl;
+            return false;
+        }
+        // Coordinates are 1-based; anything else would index past the CSR arrays
+        if (row < 1 || row > matrix.rows || column < 1 || column > matrix.columns) {
+            cout << "Error in loadMatrixMarket: entry " << e << " (" << row << ", " << column << ") of " << fileName
+                 << " is outside the " << matrix.rows << "x" << matrix.columns << " matrix" << endl;
+            return false;
+        }
+        rows.push_back(row - 1);
+        columns.push_back(column - 1);
+        values.push_back(value);
+        if (symmetric && row != column) {
+            rows.push_back(column - 1);
+            columns.push_back(row - 1);
+            values.push_back(skew ? -value : value);
+        }
+    }
+
+    // Counting sort of the entries by row
+    matrix.rowOffsets.assign(matrix.rows + 1, 0);
+    for (size_t e = 0; e < rows.size(); e++) {
+        matrix.rowOffsets[rows[e] + 1]++;
+    }
+    for (int i = 0; i < matrix.rows; i++) {
+        matrix.rowOffsets[i + 1] += matrix.rowOffsets[i];
+    }
+    vector<int> next(matrix.rowOffsets.begin(), matrix.rowOffsets.end() - 1);
+    matrix.columnIndices.resize(rows.size());
+    matrix.values.resize(rows.size());
+    for (size_t e = 0; e < rows.size(); e++) {
+        int k = next[rows[e]]++;
+        matrix.columnIndices[k] = columns[e];
+        matrix.values[k] = values[e];
+    }
+    return true;
+}
+
+// Sorts the rows by decreasing length within windows of sigma rows, then pads
+// every slice of chunk sorted rows to its longest row, column by column
+SellMatrix csrToSell(const CsrMatrix &csr, int chunk, int sigma) {
+    SellMatrix sell;
+    sell.chunk = chunk;
+    sell.rowPermutation.resize(csr.rows);
+    for (int i = 0; i < csr.rows; i++) {
+        sell.rowPermutation[i] = i;
+    }
+    for (int window = 0; window < csr.rows; window += sigma) {
+        int end = min(csr.rows, window + sigma);
+        stable_sort(sell.rowPermutation.begin() + window, sell.rowPermutation.begin() + end, [&csr](int a, int b) {
+            return csr.rowOffsets[a + 1] - csr.rowOffsets[a] > csr.rowOffsets[b + 1] - csr.rowOffsets[b];
+        });
+    }
+
+    int slices = (csr.rows + chunk - 1) / chunk;
+    int total = 0;
+    for (int s = 0; s < slices; s++) {
+        int width = 0;
+        for (int r = s * chunk; r < min(csr.rows, (s + 1) * chunk); r++) {
+            int row = sell.rowPermutation[r];
+            width = max(width, csr.rowOffsets[row + 1] - csr.rowOffsets[row]);
+        }
+        sell.sliceOffsets.push_back(total);
+        sell.sliceWidths.push_back(width);
+        total += width * chunk;
+    }
+    sell.columnIndices.assign(total, 0);
+    sell.values.assign(total, 0.0f);
+    for (int r = 0; r < csr.rows; r++) {
+        int row = sell.rowPermutation[r];
+        int offset = sell.sliceOffsets[r / chunk] + r % chunk;
+        for (int k = csr.rowOffsets[row]; k < csr.rowOffsets[row + 1]; k++) {
+            int j = k - csr.rowOffsets[row];
+            sell.columnIndices[offset + j * chunk] = csr.columnIndices[k];
+            sell.values[offset + j * chunk] = csr.values[k];
+        }
+    }
+    return sell;
+}
+
+// Reference y = A * x, accumulated in double
+vector<double> spmvReference(const CsrMatrix &csr, const vector<float> &x) {
+    vector<double> y(csr.rows);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < csr.rows; i++) {
+        double sum = 0;
+        for (int k = csr.rowOffsets[i]; k < csr.rowOffsets[i + 1]; k++) {
+            sum += (double) csr.values[k] * x[csr.columnIndices[k]];
+        }
+        y[i] = sum;
+    }
+    return y;
+}
+
+cl_mem createSpmvBuffer(size_t bytes, const void *data, cl_int *status) {
+    // Empty matrices still need a valid buffer
+    if (bytes == 0) {
+        return clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, status);
+    }
+    return clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, bytes, (void *) data, status);
+}
+
+// Median kernel time of SPMV_ITERATIONS launches
+double timeSpmvKernel(cl_kernel spmvKernel, size_t globalWorkSize, size_t localWorkSize, cl_int *status) {
+    vector<long> timers;
+    for (int i = 0; i < SPMV_ITERATIONS; i++) {
+        cl_event event;
+        *status = clEnqueueNDRangeKernel(commandQueue, spmvKernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, &event);
+        if (CL_SUCCESS != *status) {
+            cout << "Error in clEnqueueNDRangeKernel" << endl;
+            return 0;
+        }
+        timers.push_back(getTime(event));
+        clReleaseEvent(event);
+    }
+    return median(timers);
+}
+
+bool checkSpmv(cl_mem d_y, const vector<double> &reference) {
+    vector<float> y(reference.size());
+    if (y.empty()) {
+        return true;
+    }
+    clEnqueueReadBuffer(commandQueue, d_y, CL_TRUE, 0, sizeof(float) * y.size(), &y[0], 0, NULL, NULL);
+    for (size_t i = 0; i < y.size(); i++) {
+        if (fabs(y[i] - reference[i]) > SPMV_TOLERANCE * max(1.0, fabs(reference[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void printSpmvResult(const char *format, double kernelTime, double bytes, double flops, double denseTime, bool valid) {
+    cout << "SpMV " << format << ": Median KernelTime " << kernelTime << " (ns)"
+         << ", Bandwidth " << (kernelTime > 0 ? bytes / kernelTime : 0) << " GB/s"
+         << ", Compute " << (kernelTime > 0 ? flops / kernelTime : 0) << " GFLOP/s";
+    if (denseTime > 0) {
+        cout << ", Speedup vs dense " << (kernelTime > 0 ? denseTime / kernelTime : 0) << "x";
+    }
+    cout << ", " << (valid ? "Result is correct" : "Result is not correct") << endl;
+}
+
+// Runs the dense kernel (square matrices only) and the three sparse kernels
+// on one matrix. The bandwidth counts the bytes of the matrix format, x and y
+// once.
+int benchmarkSpmv(const CsrMatrix &csr, cl_program spmvProgram, bool withDense) {
+    cl_int status;
+    int nonZeros = csr.rowOffsets[csr.rows];
+    vector<float> x(csr.columns);
+    for (int j = 0; j < csr.columns; j++) {
+        x[j] = randomFloat(seed, 2 * (cl_ulong) j + 1);
+    }
+    vector<double> reference = spmvReference(csr, x);
+    SellMatrix sell = csrToSell(csr, SELL_CHUNK, SELL_SIGMA);
+    double vectorBytes = sizeof(float) * ((double) csr.rows + csr.columns);
+    double flops = 2.0 * nonZeros;
+    cout << "Matrix " << csr.rows << " x " << csr.columns << ", " << nonZeros << " non-zeros ("
+         << 100.0 * nonZeros / ((double) csr.rows * csr.columns) << "%), SELL-" << SELL_CHUNK << "-" << SELL_SIGMA
+         << " padding " << (nonZeros > 0 ? (double) sell.values.size() / nonZeros : 0) << "x" << endl;
+
+    cl_mem d_x = createSpmvBuffer(sizeof(float) * x.size(), x.empty() ? NULL : &x[0], &status);
+    cl_mem d_y = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(float) * max(1, csr.rows), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for x and y" << endl;
+        return status;
+    }
+
+    double denseTime = 0;
+    if (withDense) {
+        size_t size = csr.rows;
+        vector<float> dense(size * size, 0.0f);
+        for (int i = 0; i < csr.rows; i++) {
+            for (int k = csr.rowOffsets[i]; k < csr.rowOffsets[i + 1]; k++) {
+                dense[(size_t) i * size + csr.columnIndices[k]] += csr.values[k];
+            }
+        }
+        cl_mem d_dense = createSpmvBuffer(sizeof(float) * dense.size(), &dense[0], &status);
+        status |= clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_dense);
+        status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_x);
+        status |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_y);
+        status |= clSetKernelArg(kernel, 3, sizeof(cl_int), &csr.rows);
+        if (CL_SUCCESS != status) {
+            cout << "Error setting up the dense kernel" << endl;
+            return status;
+        }
+        denseTime = timeSpmvKernel(kernel, size, LOCAL_WORK_SIZE, &status);
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        printSpmvResult("dense     ", denseTime, sizeof(float) * (double) dense.size() + vectorBytes, flops, 0, checkSpmv(d_y, reference));
+        clReleaseMemObject(d_dense);
+    }
+
+    cl_mem d_rowOffsets = createSpmvBuffer(sizeof(int) * csr.rowOffsets.size(), &csr.rowOffsets[0], &status);
+    cl_mem d_columns = createSpmvBuffer(sizeof(int) * csr.columnIndices.size(), nonZeros > 0 ? &csr.columnIndices[0] : NULL, &status);
+    cl_mem d_values = createSpmvBuffer(sizeof(float) * csr.values.size(), nonZeros > 0 ? &csr.values[0] : NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the CSR matrix" << endl;
+        return status;
+    }
+    double csrBytes = sizeof(int) * (csr.rows + 1.0) + (sizeof(int) + sizeof(float)) * (double) nonZeros + vectorBytes;
+    const char *csrKernels[] = {"spmvCsrScalar", "spmvCsrVector"};
+    const char *csrNames[] = {"CSR scalar", "CSR vector"};
+    for (int v = 0; v < 2; v++) {
+        cl_kernel spmvKernel = clCreateKernel(spmvProgram, csrKernels[v], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << csrKernels[v] << " kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(spmvKernel, devices[0], csrKernels[v], SPMV_WORK_GROUP_SIZE);
+        status = clSetKernelArg(spmvKernel, 0, sizeof(cl_mem), &d_rowOffsets);
+        status |= clSetKernelArg(spmvKernel, 1, sizeof(cl_mem), &d_columns);
+        status |= clSetKernelArg(spmvKernel, 2, sizeof(cl_mem), &d_values);
+        status |= clSetKernelArg(spmvKernel, 3, sizeof(cl_mem), &d_x);
+        status |= clSetKernelArg(spmvKernel, 4, sizeof(cl_mem), &d_y);
+        status |= clSetKernelArg(spmvKernel, 5, sizeof(cl_int), &csr.rows);
+        if (v == 1) {
+            status |= clSetKernelArg(spmvKernel, 6, sizeof(cl_float) * SPMV_WORK_GROUP_SIZE, NULL);
+        }
+        if (CL_SUCCESS != status) {
+            cout << "Error in clSetKernelArg, " << csrKernels[v] << endl;
+            return status;
+        }
+        size_t workItems = (size_t) csr.rows * (v == 1 ? CSR_VECTOR_LANES : 1);
+        size_t globalWorkSize = max((size_t) 1, (workItems + SPMV_WORK_GROUP_SIZE - 1) / SPMV_WORK_GROUP_SIZE) * SPMV_WORK_GROUP_SIZE;
+        double kernelTime = timeSpmvKernel(spmvKernel, globalWorkSize, SPMV_WORK_GROUP_SIZE, &status);
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        printSpmvResult(csrNames[v], kernelTime, csrBytes, flops, denseTime, checkSpmv(d_y, reference));
+        clReleaseKernel(spmvKernel);
+    }
+
+    cl_mem d_sliceOffsets = createSpmvBuffer(sizeof(int) * sell.sliceOffsets.size(), sell.sliceOffsets.empty() ? NULL : &sell.sliceOffsets[0], &status);
+    cl_mem d_sliceWidths = createSpmvBuffer(sizeof(int) * sell.sliceWidths.size(), sell.sliceWidths.empty() ? NULL : &sell.sliceWidths[0], &status);
+    cl_mem d_sellColumns = createSpmvBuffer(sizeof(int) * sell.columnIndices.size(), sell.columnIndices.empty() ? NULL : &sell.columnIndices[0], &status);
+    cl_mem d_sellValues = createSpmvBuffer(sizeof(float) * sell.values.size(), sell.values.empty() ? NULL : &sell.values[0], &status);
+    cl_mem d_permutation = createSpmvBuffer(sizeof(int) * sell.rowPermutation.size(), sell.rowPermutation.empty() ? NULL : &sell.rowPermutation[0], &status);
+    cl_kernel sellKernel = clCreateKernel(spmvProgram, "spmvSell", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error setting up the SELL-C-sigma kernel" << endl;
+        return status;
+    }
+    checkLocalWorkSize(sellKernel, devices[0], "spmvSell", SPMV_WORK_GROUP_SIZE);
+    status = clSetKernelArg(sellKernel, 0, sizeof(cl_mem), &d_sliceOffsets);
+    status |= clSetKernelArg(sellKernel, 1, sizeof(cl_mem), &d_sliceWidths);
+    status |= clSetKernelArg(sellKernel, 2, sizeof(cl_mem), &d_sellColumns);
+    status |= clSetKernelArg(sellKernel, 3, sizeof(cl_mem), &d_sellValues);
+    status |= clSetKernelArg(sellKernel, 4, sizeof(cl_mem), &d_permutation);
+    status |= clSetKernelArg(sellKernel, 5, sizeof(cl_mem), &d_x);
+    status |= clSetKernelArg(sellKernel, 6, sizeof(cl_mem), &d_y);
+    status |= clSetKernelArg(sellKernel, 7, sizeof(cl_int), &csr.rows);
+    status |= clSetKernelArg(sellKernel, 8, sizeof(cl_int), &sell.chunk);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, spmvSell" << endl;
+        return status;
+    }
+    size_t sellWorkSize = max((size_t) 1, ((size_t) csr.rows + SPMV_WORK_GROUP_SIZE - 1) / SPMV_WORK_GROUP_SIZE) * SPMV_WORK_GROUP_SIZE;
+    double sellTime = timeSpmvKernel(sellKernel, sellWorkSize, SPMV_WORK_GROUP_SIZE, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    double sellBytes = (sizeof(int) + sizeof(float)) * (double) sell.values.size()
+                       + sizeof(int) * (2.0 * sell.sliceOffsets.size() + csr.rows) + vectorBytes;
+    printSpmvResult("SELL-C-s  ", sellTime, sellBytes, flops, denseTime, checkSpmv(d_y, reference));
+    cout << "\n";
+
+    clReleaseKernel(sellKernel);
+    clReleaseMemObject(d_x);
+    clReleaseMemObject(d_y);
+    clReleaseMemObject(d_rowOffsets);
+    clReleaseMemObject(d_columns);
+    clReleaseMemObject(d_values);
+    clReleaseMemObject(d_sliceOffsets);
+    clReleaseMemObject(d_sliceWidths);
+    clReleaseMemObject(d_sellColumns);
+    clReleaseMemObject(d_sellValues);
+    clReleaseMemObject(d_permutation);
+    return CL_SUCCESS;
+}
+
+// Sparsity sweep on random elements x elements matrices, or one Matrix Market
+// file. The dense kernel runs on square matrices whose size is a multiple of
+// LOCAL_WORK_SIZE.
+int runSpmvBenchmark() {
+    cl_int status;
+    char *spmvSource;
+    cl_program spmvProgram = buildProgramFromFile(context, devices[0], "spmv.cl", NULL, kernelReport, &spmvSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    if (matrixFile != NULL) {
+        CsrMatrix csr;
+        if (!loadMatrixMarket(matrixFile, csr)) {
+            return -1;
+        }
+        bool withDense = csr.rows == csr.columns && csr.rows > 0 && csr.rows % LOCAL_WORK_SIZE == 0;
+        status = benchmarkSpmv(csr, spmvProgram, withDense);
     } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
+        for (int d = 0; d < NUMBER_OF_SPMV_DENSITIES && status == CL_SUCCESS; d++) {
+            CsrMatrix csr = randomCsrMatrix(elements, SPMV_DENSITIES[d]);
+            status = benchmarkSpmv(csr, spmvProgram, true);
+        }
+    }
+    clReleaseProgram(spmvProgram);
+    free(spmvSource);
+    return status;
+}
+
+// Element offsets of the operands of a pointer-array batch: the matrices are
+// shuffled over the slots of their buffer
+vector<int> shuffledOffsets(int matrices, int elementsPerMatrix, cl_ulong stream) {
+    vector<int> offsets(matrices);
+    for (int b = 0; b < matrices; b++) {
+        offsets[b] = b * elementsPerMatrix;
+    }
+    for (int b = matrices - 1; b > 0; b--) {
+        swap(offsets[b], offsets[hashCounter(seed ^ stream, b) % (b + 1)]);
+    }
+    return offsets;
+}
+
+// Median wall-clock time of one batch: one launch with a work-group per
+// matrix, or one launch per matrix (single) placed with a global work offset
+double timeBatch(cl_kernel batchKernel, int matrices, size_t workGroupSize, bool single, cl_int *status) {
+    vector<double> timers;
+    for (int i = 0; i < SMALL_BATCH_ITERATIONS; i++) {
+        auto start = chrono::high_resolution_clock::now();
+        if (single) {
+            for (int b = 0; b < matrices && CL_SUCCESS == *status; b++) {
+                size_t offset = b * workGroupSize;
+                *status = clEnqueueNDRangeKernel(commandQueue, batchKernel, 1, &offset, &workGroupSize, &workGroupSize, 0, NULL, NULL);
+            }
         } else {
-            return double(data[data.size() / 2]);
+            size_t globalWorkSize = matrices * workGroupSize;
+            *status = clEnqueueNDRangeKernel(commandQueue, batchKernel, 1, NULL, &globalWorkSize, &workGroupSize, 0, NULL, NULL);
+        }
+        *status |= clFinish(commandQueue);
+        if (CL_SUCCESS != *status) {
+            cout << "Error in clEnqueueNDRangeKernel" << endl;
+            return 0;
+        }
+        timers.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count());
+    }
+    return median(timers);
+}
+
+// Compares the results of the batch with a CPU GEMV or GEMM of every matrix
+bool checkBatch(bool gemm, int size, int matrices, const vector<float> &a, const vector<float> &b, const vector<float> &result,
+                const vector<int> &offsetsA, const vector<int> &offsetsB, const vector<int> &offsetsC) {
+    int columns = gemm ? size : 1;
+    bool valid = true;
+    #pragma omp parallel for schedule(static) reduction(&&:valid)
+    for (int m = 0; m < matrices; m++) {
+        const float *matrixA = &a[offsetsA[m]];
+        const float *matrixB = &b[offsetsB[m]];
+        const float *matrixC = &result[offsetsC[m]];
+        for (int i = 0; i < size && valid; i++) {
+            for (int j = 0; j < columns; j++) {
+                float sum = 0.0f;
+                for (int k = 0; k < size; k++) {
+                    sum += matrixA[i * size + k] * matrixB[k * columns + j];
+                }
+                if (fabs(matrixC[i * columns + j] - sum) > 0.01f) {
+                    valid = false;
+                }
+            }
+        }
+    }
+    return valid;
+}
+
+// For every matrix size and for GEMV and GEMM: one launch per matrix, then one
+// launch for a strided and for a pointer-array batch
+int runSmallBatchBenchmark() {
+    cl_int status;
+    char *batchedSource;
+    cl_program batchedProgram = buildProgramFromFile(context, devices[0], "batched.cl", NULL, kernelReport, &batchedSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel kernels[2];
+    const char *kernelNames[] = {"gemvBatched", "gemmBatched"};
+    for (int k = 0; k < 2; k++) {
+        kernels[k] = clCreateKernel(batchedProgram, kernelNames[k], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << kernelNames[k] << " kernel" << endl;
+            return status;
+        }
+    }
+
+    for (int s = 0; s < NUMBER_OF_SMALL_BATCH_SIZES; s++) {
+        int size = SMALL_BATCH_SIZES[s];
+        int matrixElements = size * size;
+        // Bounded by the memory of the three GEMM operands
+        int matrices = (int) min((size_t) smallBatchMatrices, SMALL_BATCH_MAX_BYTES / (3 * sizeof(float) * matrixElements));
+        for (int gemm = 0; gemm < 2; gemm++) {
+            int operandElements = gemm ? matrixElements : size;
+            size_t workGroupSize = gemm ? GEMM_TILE * GEMM_TILE : size;
+            vector<float> a((size_t) matrices * matrixElements);
+            vector<float> b((size_t) matrices * operandElements);
+            vector<float> result(b.size());
+            #pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < a.size(); i++) {
+                a[i] = randomFloat(seed, 2 * (cl_ulong) i);
+            }
+            #pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < b.size(); i++) {
+                b[i] = randomFloat(seed, 2 * (cl_ulong) i + 1);
+            }
+            cl_mem d_a = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * a.size(), &a[0], &status);
+            cl_mem d_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * b.size(), &b[0], &status);
+            cl_mem d_result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * result.size(), NULL, &status);
+            if (CL_SUCCESS != status) {
+                cout << "Error in clCreateBuffer for the batch of " << size << "x" << size << " matrices" << endl;
+                return status;
+            }
+
+            vector<int> packedA(matrices);
+            vector<int> packedB(matrices);
+            for (int m = 0; m < matrices; m++) {
+                packedA[m] = m * matrixElements;
+                packedB[m] = m * operandElements;
+            }
+            vector<int> offsetsA = shuffledOffsets(matrices, matrixElements, 1);
+            vector<int> offsetsB = shuffledOffsets(matrices, operandElements, 2);
+            vector<int> offsetsC = shuffledOffsets(matrices, operandElements, 3);
+            cl_mem d_offsetsA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * matrices, &offsetsA[0], &status);
+            cl_mem d_offsetsB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * matrices, &offsetsB[0], &status);
+            cl_mem d_offsetsC = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * matrices, &offsetsC[0], &status);
+            if (CL_SUCCESS != status) {
+                cout << "Error in clCreateBuffer for the offsets of the batch" << endl;
+                return status;
+            }
+
+            cl_kernel batchKernel = kernels[gemm];
+            checkLocalWorkSize(batchKernel, devices[0], kernelNames[gemm], workGroupSize);
+            status = clSetKernelArg(batchKernel, 0, sizeof(cl_mem), &d_a);
+            status |= clSetKernelArg(batchKernel, 2, sizeof(cl_mem), &d_b);
+            status |= clSetKernelArg(batchKernel, 4, sizeof(cl_mem), &d_result);
+            status |= clSetKernelArg(batchKernel, 6, sizeof(cl_int), &size);
+            if (!gemm) {
+                status |= clSetKernelArg(batchKernel, 7, sizeof(float) * size, NULL);
+            }
+            if (CL_SUCCESS != status) {
+                cout << "Error in clSetKernelArg, " << kernelNames[gemm] << endl;
+                return status;
+            }
+
+            double flops = 2.0 * matrices * matrixElements * (gemm ? size : 1);
+            const char *modes[] = {"single launches", "strided batch  ", "pointer array  "};
+            double singleTime = 0;
+            for (int mode = 0; mode < 3; mode++) {
+                // A NULL offsets table selects the packed operands
+                bool pointerArray = mode == 2;
+                status = clSetKernelArg(batchKernel, 1, sizeof(cl_mem), pointerArray ? &d_offsetsA : NULL);
+                status |= clSetKernelArg(batchKernel, 3, sizeof(cl_mem), pointerArray ? &d_offsetsB : NULL);
+                status |= clSetKernelArg(batchKernel, 5, sizeof(cl_mem), pointerArray ? &d_offsetsC : NULL);
+                double time = timeBatch(batchKernel, matrices, workGroupSize, mode == 0, &status);
+                if (CL_SUCCESS != status) {
+                    return status;
+                }
+                status = clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, sizeof(float) * result.size(), &result[0], 0, NULL, NULL);
+                bool valid = pointerArray ? checkBatch(gemm, size, matrices, a, b, result, offsetsA, offsetsB, offsetsC)
+                                          : checkBatch(gemm, size, matrices, a, b, result, packedA, packedB, packedB);
+                if (mode == 0) {
+                    singleTime = time;
+                }
+                cout << "Batched " << kernelNames[gemm] << " " << size << "x" << size << ", " << matrices << " matrices, " << modes[mode]
+                     << ": Median Time " << time << " (ns), " << (time > 0 ? matrices / time * 1e9 : 0) << " matrices/s, "
+                     << (time > 0 ? flops / time : 0) << " GFLOP/s, Speedup " << (time > 0 ? singleTime / time : 0) << "x, "
+                     << (valid ? "Result is correct" : "Result is not correct") << endl;
+            }
+
+            clReleaseMemObject(d_a);
+            clReleaseMemObject(d_b);
+            clReleaseMemObject(d_result);
+            clReleaseMemObject(d_offsetsA);
+            clReleaseMemObject(d_offsetsB);
+            clReleaseMemObject(d_offsetsC);
+        }
+    }
+    cout << "\n";
+
+    clReleaseKernel(kernels[0]);
+    clReleaseKernel(kernels[1]);
+    clReleaseProgram(batchedProgram);
+    free(batchedSource);
+    return CL_SUCCESS;
+}
+
+// Values of A and B as generated by hostDataInitialization; the vector of the
+// GEMV is the first row of B
+float matrixA(cl_ulong row, cl_ulong column, cl_ulong size) {
+    return randomFloat(seed, 2 * (row * size + column));
+}
+
+float matrixB(cl_ulong row, cl_ulong column, cl_ulong size) {
+    return randomFloat(seed, 2 * (row * size + column) + 1);
+}
+
+// Rows [firstRow, firstRow + rows) of A, row-major
+void generateRowPanel(float *panel, size_t firstRow, size_t rows, size_t size) {
+    #pragma omp parallel for schedule(static)
+    for (long r = 0; r < (long) rows; r++) {
+        for (size_t j = 0; j < size; j++) {
+            panel[r * size + j] = matrixA(firstRow + r, j, size);
+        }
+    }
+}
+
+// Columns [firstColumn, firstColumn + columns) of B, row-major
+void generateColumnPanel(float *panel, size_t firstColumn, size_t columns, size_t size) {
+    #pragma omp parallel for schedule(static)
+    for (long k = 0; k < (long) size; k++) {
+        for (size_t c = 0; c < columns; c++) {
+            panel[k * columns + c] = matrixB(k, firstColumn + c, size);
+        }
+    }
+}
+
+// One entry of A * B (GEMM) or of A * x (GEMV), accumulated in double
+double outOfCoreReference(bool gemm, size_t row, size_t column, size_t size) {
+    double sum = 0;
+    for (size_t k = 0; k < size; k++) {
+        sum += (double) matrixA(row, k, size) * (gemm ? matrixB(k, column, size) : matrixB(0, k, size));
+    }
+    return sum;
+}
+
+cl_mem createStaging(size_t bytes, float **hostData, cl_int *status) {
+    cl_mem staging = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, bytes, NULL, status);
+    if (CL_SUCCESS != *status) {
+        return NULL;
+    }
+    *hostData = (float *) clEnqueueMapBuffer(commandQueue, staging, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0, NULL, NULL, status);
+    return staging;
+}
+
+void replaceEvent(cl_event *slot, cl_event event) {
+    if (*slot != NULL) {
+        clReleaseEvent(*slot);
+    }
+    *slot = event;
+}
+
+// Tile of C (or panel of y) produced by one step of the pipeline, checked once
+// its download has completed
+struct OutOfCoreTile {
+    bool pending;
+    size_t step;
+    size_t firstRow;
+    size_t rows;
+    size_t firstColumn;
+    size_t columns;
+};
+
+// Waits for the download of a tile, accounts the device time of its kernel
+// and download and checks OUT_OF_CORE_CHECKS sampled entries
+void consumeTile(OutOfCoreTile &tile, const float *hostData, cl_event *computeEvent, cl_event *readEvent, bool gemm, double *computeTime,
+                 double *transferTime, int *failedChecks) {
+    clWaitForEvents(1, readEvent);
+    *computeTime += getTime(*computeEvent);
+    *transferTime += getTime(*readEvent);
+    replaceEvent(computeEvent, NULL);
+    replaceEvent(readEvent, NULL);
+    for (int c = 0; c < OUT_OF_CORE_CHECKS; c++) {
+        size_t r = hashCounter(seed, 2 * (tile.step * OUT_OF_CORE_CHECKS + c)) % tile.rows;
+        size_t k = hashCounter(seed, 2 * (tile.step * OUT_OF_CORE_CHECKS + c) + 1) % tile.columns;
+        double reference = outOfCoreReference(gemm, tile.firstRow + r, tile.firstColumn + k, elements);
+        if (fabs(hostData[r * tile.columns + k] - reference) > OUT_OF_CORE_TOLERANCE * max(1.0, fabs(reference))) {
+            (*failedChecks)++;
         }
     }
+    tile.pending = false;
 }
 
-double median(vector<double> data) {
-    if (data.empty()) {
-        return 0;
+// Panel height for the device memory budget: GEMV keeps x, two row panels
+// and two y panels; GEMM keeps two row panels of A, two column panels of B
+// and two tiles of C (4pn + 2p^2 floats)
+size_t outOfCorePanel(bool gemm, size_t size) {
+    double budget = (double) deviceMemoryBudget / sizeof(float);
+    double panel;
+    if (gemm) {
+        panel = (-4.0 * size + sqrt(16.0 * size * size + 8.0 * budget)) / 4.0;
     } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
+        panel = (budget - size) / (2.0 * size + 2.0);
+    }
+    size_t rows = panel < 1 ? 0 : min(size, (size_t) panel);
+    if (gemm && rows > PANEL_TILE) {
+        rows -= rows % PANEL_TILE;
+    }
+    return rows;
+}
+
+int runOutOfCore() {
+    cl_int status;
+    bool gemm = outOfCoreMode == OUT_OF_CORE_GEMM;
+    size_t size = elements;
+    size_t panel = outOfCorePanel(gemm, size);
+    if (panel == 0) {
+        cout << "Error: a device memory budget of " << deviceMemoryBudget << " bytes is too small for " << size << "x" << size << " matrices" << endl;
+        return -1;
+    }
+    size_t rowPanels = (size + panel - 1) / panel;
+    size_t columnPanels = gemm ? rowPanels : 1;
+    size_t tileElements = gemm ? panel * panel : panel;
+    double matrixBytes = sizeof(float) * (double) size * size;
+    cout << "Out-of-core " << (gemm ? "GEMM" : "GEMV") << ": " << size << "x" << size << " (" << matrixBytes / 1e6 << " MB per matrix), panels of "
+         << panel << " rows" << (gemm ? " and columns" : "") << ", device working set " << deviceMemoryBudget / 1e6 << " MB" << endl;
+
+    char *outOfCoreSource;
+    cl_program outOfCoreProgram = buildProgramFromFile(context, devices[0], "outofcore.cl", NULL, kernelReport, &outOfCoreSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel panelKernel = clCreateKernel(outOfCoreProgram, gemm ? "gemmTile" : "gemvPanel", &status);
+    cl_command_queue uploadQueue = clCreateCommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE, &status);
+    cl_command_queue downloadQueue = clCreateCommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error creating the kernel and the queues of the out-of-core mode" << endl;
+        return status;
+    }
+    checkLocalWorkSize(panelKernel, devices[0], gemm ? "gemmTile" : "gemvPanel", gemm ? PANEL_TILE * PANEL_TILE : LOCAL_WORK_SIZE);
+
+    size_t rowPanelBytes = sizeof(float) * panel * size;
+    size_t columnPanelBytes = gemm ? rowPanelBytes : 0;
+    size_t tileBytes = sizeof(float) * tileElements;
+    cl_mem d_rowPanels[2];
+    cl_mem d_columnPanels[2] = {NULL, NULL};
+    cl_mem d_tiles[2];
+    cl_mem rowStaging[2];
+    cl_mem columnStaging[2] = {NULL, NULL};
+    cl_mem tileStaging[2];
+    float *rowData[2];
+    float *columnData[2] = {NULL, NULL};
+    float *tileData[2];
+    for (int slot = 0; slot < 2; slot++) {
+        d_rowPanels[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, rowPanelBytes, NULL, &status);
+        d_tiles[slot] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tileBytes, NULL, &status);
+        rowStaging[slot] = createStaging(rowPanelBytes, &rowData[slot], &status);
+        tileStaging[slot] = createStaging(tileBytes, &tileData[slot], &status);
+        if (gemm) {
+            d_columnPanels[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, columnPanelBytes, NULL, &status);
+            columnStaging[slot] = createStaging(columnPanelBytes, &columnData[slot], &status);
+        }
+        if (CL_SUCCESS != status) {
+            cout << "Error allocating the panels of the out-of-core mode" << endl;
+            return status;
+        }
+    }
+    // The vector of the GEMV stays on the device
+    cl_mem d_x = NULL;
+    if (!gemm) {
+        vector<float> x(size);
+        for (size_t j = 0; j < size; j++) {
+            x[j] = matrixB(0, j, size);
+        }
+        d_x = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * size, &x[0], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateBuffer for x" << endl;
+            return status;
+        }
+    }
+
+    cl_event rowUploads[2] = {NULL, NULL};
+    cl_event rowLastCompute[2] = {NULL, NULL};
+    cl_event columnUploads[2] = {NULL, NULL};
+    cl_event computeEvents[2] = {NULL, NULL};
+    cl_event readEvents[2] = {NULL, NULL};
+    OutOfCoreTile tiles[2] = {{false}, {false}};
+    double computeTime = 0;
+    double transferTime = 0;
+    double uploadedBytes = 0;
+    int failedChecks = 0;
+    int innerSize = size;
+
+    auto start = chrono::high_resolution_clock::now();
+    size_t step = 0;
+    for (size_t i = 0; i < rowPanels; i++) {
+        size_t firstRow = i * panel;
+        size_t rows = min(panel, size - firstRow);
+        int rowSlot = i % 2;
+        // The staging memory is free once its previous upload completed, the
+        // device panel once the kernels that read it completed
+        if (rowUploads[rowSlot] != NULL) {
+            transferTime += getTime(rowUploads[rowSlot]);
+        }
+        generateRowPanel(rowData[rowSlot], firstRow, rows, size);
+        cl_event rowUpload;
+        cl_uint waits = rowLastCompute[rowSlot] != NULL ? 1 : 0;
+        status = clEnqueueWriteBuffer(uploadQueue, d_rowPanels[rowSlot], CL_FALSE, 0, sizeof(float) * rows * size, rowData[rowSlot],
+                                      waits, waits ? &rowLastCompute[rowSlot] : NULL, &rowUpload);
+        replaceEvent(&rowUploads[rowSlot], rowUpload);
+        clFlush(uploadQueue);
+        uploadedBytes += sizeof(float) * (double) rows * size;
+
+        for (size_t j = 0; j < columnPanels && CL_SUCCESS == status; j++, step++) {
+            int slot = step % 2;
+            size_t firstColumn = j * panel;
+            size_t columns = gemm ? min(panel, size - firstColumn) : 1;
+            // The tile of two steps before used the same slot
+            if (tiles[slot].pending) {
+                consumeTile(tiles[slot], tileData[slot], &computeEvents[slot], &readEvents[slot], gemm, &computeTime, &transferTime, &failedChecks);
+            }
+
+            vector<cl_event> computeWaits(1, rowUploads[rowSlot]);
+            if (gemm) {
+                if (columnUploads[slot] != NULL) {
+                    transferTime += getTime(columnUploads[slot]);
+                }
+                generateColumnPanel(columnData[slot], firstColumn, columns, size);
+                cl_event columnUpload;
+                status |= clEnqueueWriteBuffer(uploadQueue, d_columnPanels[slot], CL_FALSE, 0, sizeof(float) * size * columns, columnData[slot],
+                                               0, NULL, &columnUpload);
+                replaceEvent(&columnUploads[slot], columnUpload);
+                clFlush(uploadQueue);
+                uploadedBytes += sizeof(float) * (double) size * columns;
+                computeWaits.push_back(columnUpload);
+            }
+
+            cl_int panelRows = rows;
+            cl_int panelColumns = columns;
+            cl_event compute;
+            status |= clSetKernelArg(panelKernel, 0, sizeof(cl_mem), &d_rowPanels[rowSlot]);
+            status |= clSetKernelArg(panelKernel, 1, sizeof(cl_mem), gemm ? &d_columnPanels[slot] : &d_x);
+            status |= clSetKernelArg(panelKernel, 2, sizeof(cl_mem), &d_tiles[slot]);
+            status |= clSetKernelArg(panelKernel, 3, sizeof(cl_int), &panelRows);
+            if (gemm) {
+                status |= clSetKernelArg(panelKernel, 4, sizeof(cl_int), &panelColumns);
+                status |= clSetKernelArg(panelKernel, 5, sizeof(cl_int), &innerSize);
+                size_t localWorkSize[2] = {PANEL_TILE, PANEL_TILE};
+                size_t globalWorkSize[2] = {(columns + PANEL_TILE - 1) / PANEL_TILE * PANEL_TILE, (rows + PANEL_TILE - 1) / PANEL_TILE * PANEL_TILE};
+                status |= clEnqueueNDRangeKernel(commandQueue, panelKernel, 2, NULL, globalWorkSize, localWorkSize,
+                                                 computeWaits.size(), &computeWaits[0], &compute);
+            } else {
+                status |= clSetKernelArg(panelKernel, 4, sizeof(cl_int), &innerSize);
+                size_t localWorkSize = LOCAL_WORK_SIZE;
+                size_t globalWorkSize = (rows + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE;
+                status |= clEnqueueNDRangeKernel(commandQueue, panelKernel, 1, NULL, &globalWorkSize, &localWorkSize,
+                                                 computeWaits.size(), &computeWaits[0], &compute);
+            }
+            clFlush(commandQueue);
+            if (CL_SUCCESS != status) {
+                cout << "Error enqueueing step " << step << " of the out-of-core mode" << endl;
+                break;
+            }
+            computeEvents[slot] = compute;
+            clRetainEvent(compute);
+            replaceEvent(&rowLastCompute[rowSlot], compute);
+
+            status = clEnqueueReadBuffer(downloadQueue, d_tiles[slot], CL_FALSE, 0, sizeof(float) * rows * columns, tileData[slot], 1, &compute, &readEvents[slot]);
+            clFlush(downloadQueue);
+            OutOfCoreTile tile = {true, step, firstRow, rows, firstColumn, columns};
+            tiles[slot] = tile;
+        }
+        if (CL_SUCCESS != status) {
+            break;
+        }
+    }
+    // The last two tiles, oldest first
+    for (size_t s = step; s < step + 2; s++) {
+        if (tiles[s % 2].pending) {
+            consumeTile(tiles[s % 2], tileData[s % 2], &computeEvents[s % 2], &readEvents[s % 2], gemm, &computeTime, &transferTime, &failedChecks);
+        }
+    }
+    for (int slot = 0; slot < 2; slot++) {
+        if (rowUploads[slot] != NULL) {
+            transferTime += getTime(rowUploads[slot]);
+        }
+        if (columnUploads[slot] != NULL) {
+            transferTime += getTime(columnUploads[slot]);
+        }
+    }
+    double wallTime = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+
+    double flops = 2.0 * size * size * (gemm ? size : 1);
+    cout << "Out-of-core time: " << wallTime << " (ns), " << (wallTime > 0 ? flops / wallTime : 0) << " GFLOP/s, "
+         << step << " steps, " << uploadedBytes / 1e9 << " GB uploaded (" << (wallTime > 0 ? uploadedBytes / wallTime : 0) << " GB/s)" << endl;
+    cout << "Device busy: kernels " << (wallTime > 0 ? 100 * computeTime / wallTime : 0) << "%, transfers "
+         << (wallTime > 0 ? 100 * transferTime / wallTime : 0) << "% of the time" << endl;
+    cout << (failedChecks == 0 && CL_SUCCESS == status ? "Result is correct" : "Result is not correct")
+         << " (" << OUT_OF_CORE_CHECKS << " sampled entries per " << (gemm ? "tile" : "panel") << ")" << endl;
+    cout << "\n";
+
+    for (int slot = 0; slot < 2; slot++) {
+        replaceEvent(&rowUploads[slot], NULL);
+        replaceEvent(&rowLastCompute[slot], NULL);
+        replaceEvent(&columnUploads[slot], NULL);
+        clEnqueueUnmapMemObject(commandQueue, rowStaging[slot], rowData[slot], 0, NULL, NULL);
+        clEnqueueUnmapMemObject(commandQueue, tileStaging[slot], tileData[slot], 0, NULL, NULL);
+        if (gemm) {
+            clEnqueueUnmapMemObject(commandQueue, columnStaging[slot], columnData[slot], 0, NULL, NULL);
+        }
+    }
+    clFinish(commandQueue);
+    for (int slot = 0; slot < 2; slot++) {
+        clReleaseMemObject(d_rowPanels[slot]);
+        clReleaseMemObject(d_tiles[slot]);
+        clReleaseMemObject(rowStaging[slot]);
+        clReleaseMemObject(tileStaging[slot]);
+        if (gemm) {
+            clReleaseMemObject(d_columnPanels[slot]);
+            clReleaseMemObject(columnStaging[slot]);
         }
     }
+    if (d_x != NULL) {
+        clReleaseMemObject(d_x);
+    }
+    clReleaseCommandQueue(uploadQueue);
+    clReleaseCommandQueue(downloadQueue);
+    clReleaseKernel(panelKernel);
+    clReleaseProgram(outOfCoreProgram);
+    free(outOfCoreSource);
+    return failedChecks == 0 ? status : -1;
 }
 
-void matrixVectorMultiplication(float* A_seq, float* B_seq, float* C_seq, int size) {
-    for (int i = 0; i < size; i++) {
+// Rows [begin, end) of the matrix-vector multiplication, on one host thread
+void matrixVectorMultiplicationRows(const float *A, const float *B, float *C, int size, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
         float sum = 0.0f;
         for (int j = 0; j < size; j++) {
-            sum += A_seq[(i * size) + j] * B_seq[j];
+            sum += A[i * size + j] * B[j];
         }
-        C_seq[i] = sum;
+        C[i] = sum;
+    }
+}
+
+cl_int processRows(CoexecWorker &worker, size_t begin, size_t end) {
+    size_t rows = end - begin;
+    if (!worker.device) {
+        matrixVectorMultiplicationRows(A, B, C, elements, begin, end);
+        return CL_SUCCESS;
+    }
+    cl_int rowsInt = rows;
+    size_t localWorkSize = LOCAL_WORK_SIZE;
+    size_t globalWorkSize = (rows + LOCAL_WORK_SIZE - 1) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE;
+    cl_int status = clEnqueueWriteBuffer(worker.queue, worker.d_input, CL_FALSE, 0, sizeof(float) * rows * elements, A + begin * elements, 0, NULL, NULL);
+    status |= clSetKernelArg(worker.kernel, 3, sizeof(cl_int), &rowsInt);
+    status |= clEnqueueNDRangeKernel(worker.queue, worker.kernel, 1, NULL, &globalWorkSize, &localWorkSize, 0, NULL, NULL);
+    status |= clEnqueueReadBuffer(worker.queue, worker.d_output, CL_TRUE, 0, sizeof(float) * rows, C + begin, 0, NULL, NULL);
+    return status;
+}
+
+// Runs the matrix-vector multiplication with the devices only, the host
+// workers only and both together, and reports the utilization and the share of
+// the rows of every worker
+int runCoexecution() {
+    cl_int status = CL_SUCCESS;
+    int deviceWorkers = numberOfDevices;
+    if (hostWorkers < 0) {
+        hostWorkers = max(1, omp_get_max_threads() - deviceWorkers);
+    }
+    d_coexecB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * elements, B, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the co-execution vector B" << endl;
+        return status;
+    }
+    vector<CoexecWorker> workers(deviceWorkers + hostWorkers);
+    for (int d = 0; d < deviceWorkers; d++) {
+        CoexecWorker &worker = workers[d];
+        char buf[1000];
+        clGetDeviceInfo(devices[d], CL_DEVICE_NAME, sizeof(buf), buf, NULL);
+        worker.name = "device " + to_string(d) + " (" + buf + ")";
+        worker.device = true;
+        worker.capacity = elements;
+        worker.firstChunk = COEXEC_FIRST_ROWS;
+        worker.minChunk = COEXEC_MIN_ROWS;
+        worker.profiledThroughput = 0;
+        worker.queue = clCreateCommandQueue(context, devices[d], 0, &status);
+        worker.kernel = clCreateKernel(program, "matrixVectorMultiplicationRows", &status);
+        worker.d_input = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(float) * worker.capacity * elements, NULL, &status);
+        worker.d_output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(float) * worker.capacity, NULL, &status);
+        status |= clSetKernelArg(worker.kernel, 0, sizeof(cl_mem), &worker.d_input);
+        status |= clSetKernelArg(worker.kernel, 1, sizeof(cl_mem), &d_coexecB);
+        status |= clSetKernelArg(worker.kernel, 2, sizeof(cl_mem), &worker.d_output);
+        status |= clSetKernelArg(worker.kernel, 4, sizeof(cl_int), &elements);
+        if (CL_SUCCESS != status) {
+            cout << "Error creating the co-execution worker of device " << d << endl;
+            return status;
+        }
+        checkLocalWorkSize(worker.kernel, devices[d], "matrixVectorMultiplicationRows", LOCAL_WORK_SIZE);
+    }
+    for (int h = 0; h < hostWorkers; h++) {
+        workers[deviceWorkers + h].name = "host " + to_string(h);
+        workers[deviceWorkers + h].device = false;
+        workers[deviceWorkers + h].capacity = elements;
+        workers[deviceWorkers + h].firstChunk = COEXEC_FIRST_ROWS;
+        workers[deviceWorkers + h].minChunk = COEXEC_MIN_ROWS;
+        workers[deviceWorkers + h].profiledThroughput = 0;
+    }
+
+    vector<float> reference(elements);
+    matrixVectorMultiplication(A_seq, B_seq, &reference[0], elements);
+    cout << "Co-execution: " << elements << " rows, " << deviceWorkers << " device and " << hostWorkers << " host workers" << endl;
+    const char *names[] = {"Devices only  ", "Host only     ", "Devices + host"};
+    const int firsts[] = {0, deviceWorkers, 0};
+    const int lasts[] = {deviceWorkers, deviceWorkers + hostWorkers, deviceWorkers + hostWorkers};
+    double flops = 2.0 * elements * elements;
+    double devicesTime = 0;
+    bool valid = true;
+    for (int c = 0; c < 3; c++) {
+        if (firsts[c] == lasts[c]) {
+            continue;
+        }
+        memset(C, 0, sizeof(float) * elements);
+        double wallTime = runCoexecConfiguration(workers, firsts[c], lasts[c], elements, processRows, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in the co-execution workers" << endl;
+            return status;
+        }
+        for (int i = 0; i < elements; i++) {
+            if (fabs(C[i] - reference[i]) > 0.1f) {
+                valid = false;
+                break;
+            }
+        }
+        if (c == 0) {
+            devicesTime = wallTime;
+        }
+        cout << names[c] << ": " << wallTime << " (ns), " << (wallTime > 0 ? flops / wallTime : 0) << " GFLOP/s, speedup "
+             << (wallTime > 0 ? devicesTime / wallTime : 0) << "x" << endl;
+    }
+    printCoexecWorkers(workers, elements, "rows");
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+    cout << "\n";
+
+    for (int d = 0; d < deviceWorkers; d++) {
+        clReleaseMemObject(workers[d].d_input);
+        clReleaseMemObject(workers[d].d_output);
+        clReleaseKernel(workers[d].kernel);
+        clReleaseCommandQueue(workers[d].queue);
+    }
+    clReleaseMemObject(d_coexecB);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Records of the specialization benchmark that match
+bool sameValue(const float &value, const float &reference) {
+    return fabs(value - reference) <= 0.01f;
+}
+
+// A/B benchmark of the generic kernel against the variant specialized for the
+// current matrix size (SIZE)
+int benchmarkSpecialization() {
+    cl_int status;
+    map<string, string> constants;
+    constants["SIZE"] = to_string(elements);
+    if (longIndex) {
+        constants["LONG_INDEX"] = "1";
+    }
+    cl_kernel specialized = getSpecializedKernel(specializationCache, context, devices[0], 1, (const char **) &source, "", "matrixVectorMultiplication", constants, &status);
+    if (CL_SUCCESS != status) {
+        return status;
     }
+
+    return runSpecializationBenchmark(kernel, specialized, runKernel, kernelEvent, readEvent1, C, elements, sameValue);
 }
 
 int main(int argc, char **argv) {
@@ -363,12 +1505,49 @@ int main(int argc, char **argv) {
         platformId = atoi(argv[1]);
         elements = atoi(argv[2]);
     } else {
-        cout << "Run: ./host-mxm <platformId> <elements>" << endl;
+        cout << "Run: ./host-mxm <platformId> <elements> [--specialize] [--seed <n>] [--storage] [--spmv] [--matrix <file.mtx>] [--small-batch <matrices>] [--out-of-core <gemv|gemm>] [--device-mem <MB>] [--coexec] [--host-workers <n>] [--kernel-report]" << endl;
         return -1;
     }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--specialize") == 0) {
+            specialize = true;
+        } else if (strcmp(argv[i], "--storage") == 0) {
+            storage = true;
+        } else if (strcmp(argv[i], "--spmv") == 0) {
+            spmv = true;
+        } else if (strcmp(argv[i], "--matrix") == 0 && i + 1 < argc) {
+            spmv = true;
+            matrixFile = argv[++i];
+        } else if (strcmp(argv[i], "--small-batch") == 0 && i + 1 < argc) {
+            smallBatchMatrices = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--out-of-core") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "gemv") == 0) {
+                outOfCoreMode = OUT_OF_CORE_GEMV;
+            } else if (strcmp(argv[i], "gemm") == 0) {
+                outOfCoreMode = OUT_OF_CORE_GEMM;
+            } else {
+                cout << "Unknown out-of-core mode: " << argv[i] << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--device-mem") == 0 && i + 1 < argc) {
+            deviceMemoryBudget = (size_t) atoi(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--coexec") == 0) {
+            coexecute = true;
+        } else if (strcmp(argv[i], "--host-workers") == 0 && i + 1 < argc) {
+            hostWorkers = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--kernel-report") == 0) {
+            kernelReport = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
 
     cout << "OpenCL MxM " << endl;
-    cout << "Number of Elements = " << elements * elements << endl;
+    cout << "Number of Elements = " << (size_t) elements * elements << endl;
 
     vector<long> kernelTimers;
     vector<long> writeTimers;
@@ -378,7 +1557,25 @@ int main(int argc, char **argv) {
     if (openclInitialization() != CL_SUCCESS) {
         return -1;
     }
-    hostDataInitialization(elements);
+    // The out-of-core mode never holds the whole matrices, on the host or on
+    // the device
+    if (outOfCoreMode != OUT_OF_CORE_OFF) {
+        int status = runOutOfCore();
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        clReleaseCommandQueue(commandQueue);
+        clReleaseContext(context);
+        free(source);
+        free(platforms);
+        free(devices);
+        return status == CL_SUCCESS ? 0 : -1;
+    }
+    if (sizeof(float) * (size_t) elements * elements > maxAllocationSize) {
+        cout << "Error: a " << elements << "x" << elements << " matrix exceeds CL_DEVICE_MAX_MEM_ALLOC_SIZE (" << maxAllocationSize
+             << " bytes), use --out-of-core" << endl;
+        return -1;
+    }
+    timeHostDataInitialization(hostDataInitialization, elements);
     if (allocateBuffersOnGPU() != CL_SUCCESS) {
         return -1;
     }
@@ -420,7 +1617,7 @@ int main(int argc, char **argv) {
             bool valid = true;
             for (int i = 0; i < elements; i++) {
                 for (int j = 0; j < elements; j++) {
-                    float diff = fabs(C[i * elements + j] - C_seq[i * elements + j]);
+                    float diff = fabs(C[(size_t) i * elements + j] - C_seq[(size_t) i * elements + j]);
                     if (diff > 0.1f) {
                         valid = false;
                         break;
@@ -437,6 +1634,26 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (specialize && benchmarkSpecialization() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (storage && runStorageBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (spmv && runSpmvBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (smallBatchMatrices > 0 && runSmallBatchBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (coexecute && runCoexecution() != CL_SUCCESS) {
+        return -1;
+    }
+
     freeMemory();
 
     // Compute median
@@ -23,25 +23,41 @@
  * SOFTWARE.
  */
 
-#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+// Building with -DSIZE=<n> specializes the kernel for one matrix size, so the
+// compiler can strength-reduce the row offset and unroll the inner loop. The
+// size argument is then ignored.
+#ifdef SIZE
+#define MATRIX_SIZE SIZE
+#else
+#define MATRIX_SIZE size
+#endif
+
+// Building with -DLONG_INDEX computes the element indices in 64 bits, for
+// matrices of more than INT_MAX elements.
+#ifdef LONG_INDEX
+#define INDEX long
+#else
+#define INDEX int
+#endif
+
 __kernel void matrixVectorMultiplication(__global uchar *A, __global uchar *B, __global uchar *C, __private int size)
 {
   ulong ul_23, ul_30, ul_2, ul_18, ul_1, ul_0;
   float f_25, f_24, f_11, f_19;
   long l_22, l_21, l_20, l_27, l_15, l_29, l_28, l_17, l_16;
-  int i_26, i_31, i_8, i_9, i_10, i_12, i_13, i_14, i_3, i_4, i_5, i_6, i_7;
+  INDEX i_26, i_31, i_8, i_9, i_10, i_12, i_13, i_14, i_3, i_4, i_5, i_6, i_7;
 
   // BLOCK 0
   ul_0  =  (ulong) A;
   ul_1  =  (ulong) B;
   ul_2  =  (ulong) C;
   i_3  =  get_global_size(0);
-  i_4  =  i_3 + (size-1);
+  i_4  =  i_3 + (MATRIX_SIZE-1);
   i_5  =  i_4 / i_3;
   i_6  =  get_global_id(0);
   i_7  =  i_5 * i_6;
   i_8  =  i_7 + i_5;
-  i_9  =  min(i_8, size);
+  i_9  =  min(i_8, (INDEX) MATRIX_SIZE);
   // BLOCK 1 MERGES [0 5 ]
   i_10  =  i_7;
   for(;i_10 < i_9;)
@@ -50,10 +66,10 @@ __kernel void matrixVectorMultiplication(__global uchar *A, __global uchar *B, _
     // BLOCK 3 MERGES [2 4 ]
     f_11  =  0.0F;
     i_12  =  0;
-    for(;i_12 < size;)
+    for(;i_12 < MATRIX_SIZE;)
     {
       // BLOCK 4
-      i_13  =  i_10 << 9;
+      i_13  =  i_10 * MATRIX_SIZE;
       i_14  =  i_13 + i_12;
       l_15  =  (long) i_14;
       l_16  =  l_15 << 2;
@@ -81,4 +97,19 @@ __kernel void matrixVectorMultiplication(__global uchar *A, __global uchar *B, _
   }  // B5
   // BLOCK 6
   return;
-}  //  kernel
\ No newline at end of file
+}  //  kernel
+
+// Rows [0, rows) of the product of the rows of A in the buffer with B, each of
+// size elements. The co-execution (--coexec) runs it on the chunks of rows it
+// gives to a device.
+__kernel void matrixVectorMultiplicationRows(__global const float *A, __global const float *B, __global float *C, __private int rows, __private int size)
+{
+  for (int row = get_global_id(0); row < rows; row += get_global_size(0)) {
+    __global const float *rowA = A + (long) row * size;
+    float sum = 0.0F;
+    for (int j = 0; j < size; j++) {
+      sum = fma(rowA[j], B[j], sum);
+    }
+    C[row] = sum;
+  }
+}
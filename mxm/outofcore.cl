@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Kernels of the out-of-core mode, on one panel of the matrices at a time.
+// Panel offsets are computed in size_t, as a panel can hold more than 2^31
+// elements only if the device allows allocations that large.
+
+#define PANEL_TILE 16
+
+// y = A * x for a panel of rows x columns of A and the whole x
+__kernel void gemvPanel(__global const float *panel, __global const float *x, __global float *y, const int rows, const int columns)
+{
+    int row = get_global_id(0);
+    if (row < rows) {
+        __global const float *rowValues = panel + (size_t) row * columns;
+        float sum = 0.0F;
+        for (int j = 0; j < columns; j++) {
+            sum = fma(rowValues[j], x[j], sum);
+        }
+        y[row] = sum;
+    }
+}
+
+// C tile (rows x columns) = A row panel (rows x inner) * B column panel
+// (inner x columns), in PANEL_TILE x PANEL_TILE work-groups that stage tiles
+// of both panels in local memory
+__kernel void gemmTile(__global const float *A, __global const float *B, __global float *C, const int rows, const int columns, const int inner)
+{
+    __local float tileA[PANEL_TILE][PANEL_TILE];
+    __local float tileB[PANEL_TILE][PANEL_TILE];
+    int tx = get_local_id(0);
+    int ty = get_local_id(1);
+    int column = get_global_id(0);
+    int row = get_global_id(1);
+    float sum = 0.0F;
+    for (int k = 0; k < inner; k += PANEL_TILE) {
+        tileA[ty][tx] = (row < rows && k + tx < inner) ? A[(size_t) row * inner + k + tx] : 0.0F;
+        tileB[ty][tx] = (k + ty < inner && column < columns) ? B[(size_t) (k + ty) * columns + column] : 0.0F;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for (int kk = 0; kk < PANEL_TILE; kk++) {
+            sum = fma(tileA[ty][kk], tileB[kk][tx], sum);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (row < rows && column < columns) {
+        C[(size_t) row * columns + column] = sum;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Sparse matrix-vector multiplication y = A * x, with A in CSR or SELL-C-sigma.
+
+// CSR, one work-item per row
+__kernel void spmvCsrScalar(__global const int *rowOffsets, __global const int *columns, __global const float *values,
+                            __global const float *x, __global float *y, const int rows)
+{
+    int row = get_global_id(0);
+    if (row < rows) {
+        float sum = 0.0F;
+        for (int k = rowOffsets[row]; k < rowOffsets[row + 1]; k++) {
+            sum = fma(values[k], x[columns[k]], sum);
+        }
+        y[row] = sum;
+    }
+}
+
+// CSR, CSR_VECTOR_LANES work-items per row: the lanes read consecutive
+// non-zeros of the row and their sums are reduced in local memory. The
+// work-group size must be a multiple of CSR_VECTOR_LANES.
+#define CSR_VECTOR_LANES 32
+
+__kernel void spmvCsrVector(__global const int *rowOffsets, __global const int *columns, __global const float *values,
+                            __global const float *x, __global float *y, const int rows, __local float *scratch)
+{
+    int lid = get_local_id(0);
+    int lane = lid % CSR_VECTOR_LANES;
+    int row = get_global_id(0) / CSR_VECTOR_LANES;
+    float sum = 0.0F;
+    if (row < rows) {
+        for (int k = rowOffsets[row] + lane; k < rowOffsets[row + 1]; k += CSR_VECTOR_LANES) {
+            sum = fma(values[k], x[columns[k]], sum);
+        }
+    }
+    scratch[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int stride = CSR_VECTOR_LANES / 2; stride > 0; stride >>= 1) {
+        if (lane < stride) {
+            scratch[lid] += scratch[lid + stride];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if (lane == 0 && row < rows) {
+        y[row] = scratch[lid];
+    }
+}
+
+// SELL-C-sigma: the rows are sorted by length within windows of sigma rows and
+// grouped into slices of chunk rows. Every slice is padded to its longest row
+// and stored column by column, so the work-items of a slice, one per sorted
+// row, read consecutive values. Padding entries have column 0 and value 0.
+__kernel void spmvSell(__global const int *sliceOffsets, __global const int *sliceWidths, __global const int *columns,
+                       __global const float *values, __global const int *rowPermutation, __global const float *x,
+                       __global float *y, const int rows, const int chunk)
+{
+    int sortedRow = get_global_id(0);
+    if (sortedRow < rows) {
+        int slice = sortedRow / chunk;
+        int offset = sliceOffsets[slice] + sortedRow % chunk;
+        int width = sliceWidths[slice];
+        float sum = 0.0F;
+        for (int j = 0; j < width; j++) {
+            int k = offset + j * chunk;
+            sum = fma(values[k], x[columns[k]], sum);
+        }
+        y[rowPermutation[sortedRow]] = sum;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Reduced-precision storage variants of matrixVectorMultiplication. A and B
+// are stored as half, bfloat16 or int8 and every row is accumulated in fp32
+// into C. Half values are accessed with vload_half, which does not need
+// cl_khr_fp16. int8 values are symmetrically quantized: value = q * scale, with
+// one scale per matrix, so the scales are applied once per row.
+
+float bf16ToFloat(ushort value)
+{
+    return as_float(((uint) value) << 16);
+}
+
+__kernel void matrixVectorMultiplicationHalf(__global const half *A, __global const half *B, __global float *C, const int size)
+{
+    for (int i = get_global_id(0); i < size; i += get_global_size(0)) {
+        float sum = 0.0f;
+        for (int j = 0; j < size; j++) {
+            sum = fma(vload_half(i * size + j, A), vload_half(j, B), sum);
+        }
+        C[i] = sum;
+    }
+}
+
+__kernel void matrixVectorMultiplicationBf16(__global const ushort *A, __global const ushort *B, __global float *C, const int size)
+{
+    for (int i = get_global_id(0); i < size; i += get_global_size(0)) {
+        float sum = 0.0f;
+        for (int j = 0; j < size; j++) {
+            sum = fma(bf16ToFloat(A[i * size + j]), bf16ToFloat(B[j]), sum);
+        }
+        C[i] = sum;
+    }
+}
+
+__kernel void matrixVectorMultiplicationInt8(__global const char *A, __global const char *B, __global float *C, const int size, const float scaleA, const float scaleB)
+{
+    for (int i = get_global_id(0); i < size; i += get_global_size(0)) {
+        float sum = 0.0f;
+        for (int j = 0; j < size; j++) {
+            sum = fma((float) A[i * size + j], (float) B[j], sum);
+        }
+        C[i] = sum * (scaleA * scaleB);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Batched variant of computeNesMap: many independent tuple batches are packed
+// into one tuple buffer and processed by a single launch. batchOffsets holds the
+// index of the first tuple of every batch, followed by the total number of
+// tuples, so batch b covers [batchOffsets[b], batchOffsets[b + 1]). Each
+// work-group processes whole batches and the results keep the packed layout.
+// The map itself is mapTuple (tuplemap.cl).
+
+__kernel void computeNesMapBatched(__global const uchar *inputTuples, __global uchar *resultTuples, __global const int *batchOffsets, const int numberOfBatches)
+{
+    __global const int *input = (__global const int *) (inputTuples + *((__global const ulong *) inputTuples));
+    __global int *result = (__global int *) (resultTuples + *((__global const ulong *) resultTuples));
+
+    for (int b = get_group_id(0); b < numberOfBatches; b += get_num_groups(0)) {
+        int begin = batchOffsets[b];
+        int end = batchOffsets[b + 1];
+        for (int i = begin + get_local_id(0); i < end; i += get_local_size(0)) {
+            int2 tuple = vload2(i, input);
+            vstore4(mapTuple(tuple), i, result);
+        }
+    }
+}
@@ -28,10 +28,18 @@
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <sys/time.h>
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <climits>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <deque>
 
 using namespace std;
 
@@ -45,28 +53,131 @@ const bool CHECK_RESULT = true;
 #include <CL/cl.h>
 #endif
 
-struct __attribute__((packed)) InputRecord {
-    uint32_t default_logical$id;
-    uint32_t default_logical$value;
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/hostdata.h"
+#include "../common/specialize.h"
+
+// The packed InputRecord and OutputRecord and the sequential referenceMap,
+// generated by kernelgen from nes_map.schema (make generate)
+#include "nes_map.h"
+
+// Tuple buffer format. The TornadoVM-generated kernels read the first word of
+// a buffer as the byte offset of the first tuple; the rest of the header
+// describes the payload. The payload starts on a cache line, which is also a
+// multiple of the widest vector access of the kernels (vstore4 of int).
+const size_t TUPLE_BUFFER_ALIGNMENT = 64;
+
+enum SchemaId {
+    INPUT_RECORD_SCHEMA = 1,
+    OUTPUT_RECORD_SCHEMA = 2
 };
-struct __attribute__((packed)) OutputRecord {
-    uint32_t default_logical$id;
-    uint32_t default_logical$value;
-    int32_t default_logical$new1;
-    int32_t default_logical$new2;
+
+struct TupleBufferHeader {
+    cl_ulong dataOffset;
+    cl_ulong numberOfTuples;
+    cl_uint tupleSize;
+    cl_uint schemaId;
 };
 
+const size_t TUPLE_DATA_OFFSET = ((sizeof(TupleBufferHeader) + TUPLE_BUFFER_ALIGNMENT - 1) / TUPLE_BUFFER_ALIGNMENT) * TUPLE_BUFFER_ALIGNMENT;
+
 int platformId = 0;
 const int LOCAL_WORK_SIZE = 16;
+const int SCAN_WORK_GROUP_SIZE = 256;
 const int ITERATIONS = 1;
 
-int elements = 1024;
-
-int numberOfTuples;
+// A/B benchmark of the generic and the specialized kernel (--specialize)
+bool specialize = false;
+SpecializationCache specializationCache;
+
+// Resource report of the kernels of every program built (--kernel-report)
+bool kernelReport = false;
+
+// Seed of the input data (--seed <n>)
+cl_ulong seed = 42;
+
+// Asynchronous pipeline (--async <batches>): batches in flight at once. The
+// pipeline runs on one in-order queue, on a pool of --queues <n> in-order
+// queues and on one out-of-order queue, and the throughputs are compared.
+const int ASYNC_SLOTS = 3;
+int asyncBatches = 0;
+int numberOfQueues = 4;
+
+// Adaptive batch size (--adaptive <batches> [--slo-us <us>]): an AIMD controller
+// sizes the batches, up to <elements> tuples, so that the p99 latency stays
+// under the target. The p99 is taken over a sliding window of the last
+// ADAPTIVE_WINDOW batches of the current size; with fewer samples the nearest
+// rank p99 would just be the maximum. Every ADAPTIVE_INTERVAL batches, once the
+// window is full, the controller grows the batch by ADAPTIVE_INCREASE of the
+// maximum while the p99 is under ADAPTIVE_HEADROOM of the target and halves it
+// when the p99 is over the target. A new batch size starts a new window.
+const int ADAPTIVE_WINDOW = 100;
+const int ADAPTIVE_INTERVAL = 20;
+const int ADAPTIVE_MIN_TUPLES = 256;
+const double ADAPTIVE_INCREASE = 1.0 / 32;
+const double ADAPTIVE_HEADROOM = 0.9;
+int adaptiveBatches = 0;
+double latencyTarget = 1000000;
+
+// Batched multi-query execution (--batched <batches>): independent batches of
+// different sizes packed into one launch, for every packing limit below
+const int BATCH_PACKING_LIMITS[] = {1, 4, 16, 64, 256};
+const int BATCH_WORK_GROUP_SIZE = 64;
+int packedBatches = 0;
+
+// Ingest ring (--ingest <batches>): producer threads fill pinned batch slots
+// that the main thread uploads and launches. With --producers <n> the number
+// of producer threads.
+const int INGEST_SLOTS = 8;
+int ingestBatches = 0;
+int ingestProducers = 2;
+
+// Persistent kernel polling a ring of batch descriptors (--persistent),
+// compared with one launch per batch. OpenCL 2.x devices with fine-grained SVM
+// and SVM atomics only.
+const int PERSISTENT_RING_SIZE = 4;
+const int PERSISTENT_BATCHES = 100;
+const int PERSISTENT_WORK_GROUP_SIZE = 256;
+const long PERSISTENT_TIMEOUT_NS = 5000000000L;
+bool persistent = false;
+
+// SVM path compared with the buffer path (--svm), OpenCL 2.x devices only
+const int SVM_ITERATIONS = 10;
+bool useSvm = false;
+
+long elements = 1024;
+
+long numberOfTuples;
+long maxNumberOfTuples;
+
+// Inputs larger than one device allocation (CL_DEVICE_MAX_MEM_ALLOC_SIZE) are
+// processed in chunks of tuple buffers that fit in one, and chunks of more
+// work-items than MAX_LAUNCH_ITEMS are split into launches with global offsets.
+// computeNesMap indexes the ints of the tuples, so the map kernels are built
+// with -DLONG_INDEX when a chunk holds more than INT_MAX / 4 tuples.
+const size_t MAX_LAUNCH_ITEMS = (size_t) 1 << 30;
+cl_ulong maxAllocationSize;
+size_t chunkTuples;
+bool longIndex = false;
+
+// Map kernel source, e.g. one generated by kernelgen (--kernel <file>). A map
+// kernel other than mykernel.cl is timed against computeNesMap afterwards.
+const char *kernelFile = "mykernel.cl";
+const int GENERATED_ITERATIONS = 10;
+
+// Device-side CSV parsing (--csv <file>)
+const char *csvFile = NULL;
+char *csvText;
+int textSize;
 
 // Variables
 size_t inputSize;
 size_t outputSize;
+cl_mem pinnedInput;
+cl_mem pinnedResult;
+char *inputBuffer;
+char *resultBuffer;
 InputRecord *input;
 OutputRecord *result;
 
@@ -78,78 +189,36 @@ cl_context context;
 cl_command_queue commandQueue;
 cl_kernel kernel;
 cl_program program;
+char *tupleMapSource;
 char *source;
+char *parserSource;
+char *batchSource;
+const char *programSources[4];
+
+cl_kernel markRecordEndsKernel;
+cl_kernel scanBlocksKernel;
+cl_kernel addBlockOffsetsKernel;
+cl_kernel compactRecordEndsKernel;
+cl_kernel parseRecordsKernel;
 
 cl_mem d_input;
 cl_mem d_result;
 
+cl_mem d_text;
+cl_mem d_positions;
+cl_mem d_recordEnds;
+cl_mem d_numberOfRecords;
+vector<cl_mem> d_scanLevels;
+
 cl_event kernelEvent;
 cl_event writeEvent1;
-cl_event writeEvent2;
 cl_event readEvent1;
+vector<cl_event> parseEvents;
 
 long kernelTime;
 long writeTime;
 long readTime;
-
-long getTime(cl_event event) {
-    clWaitForEvents(1, &event);
-    cl_ulong time_start, time_end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
-    return (time_end - time_start);
-}
-
-char *readsource(const char *sourceFilename) {
-    FILE *fp;
-    int err;
-    int size;
-    char *source;
-
-    fp = fopen(sourceFilename, "rb");
-
-    if (fp == NULL) {
-        printf("Could not open kernel file: %s\n", sourceFilename);
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_END);
-
-    if (err != 0) {
-        printf("Error seeking to end of file\n");
-        exit(-1);
-
-    }
-    size = ftell(fp);
-
-    if (size < 0) {
-        printf("Error getting file position\n");
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_SET);
-    if (err != 0) {
-        printf("Error seeking to start of file\n");
-        exit(-1);
-
-    }
-
-    source = (char *) malloc(size + 1);
-
-    if (source == NULL) {
-        printf("Error allocating %d bytes for the program source\n", size + 1);
-        exit(-1);
-    }
-
-    err = fread(source, 1, size, fp);
-    if (err != size) {
-        printf("only read %d bytes\n", err);
-        exit(0);
-    }
-
-    source[size] = '\0';
-    return source;
-}
+long parseTime;
 
 int openclInitialization() {
     cl_int status;
@@ -220,17 +289,32 @@ int openclInitialization() {
         return status;
     }
 
-    // Build from source
-    const char *sourceFile = "mykernel.cl";
+    clGetDeviceInfo(devices[0], CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAllocationSize), &maxAllocationSize, NULL);
+    chunkTuples = min((cl_ulong) elements, (maxAllocationSize - TUPLE_DATA_OFFSET) / sizeof(OutputRecord));
+    longIndex = chunkTuples > INT_MAX / 4;
+
+    // Build from source: the map of one tuple, the generated map kernel and the
+    // hand-written parser and batched kernels
+    const char *sourceFile = kernelFile;
+    const char *parserSourceFile = "parser.cl";
+    const char *batchSourceFile = "batch.cl";
+    tupleMapSource = readsource("tuplemap.cl");
     source = readsource(sourceFile);
-    program = clCreateProgramWithSource(context, 1, (const char **) &source, NULL, &status);
+    parserSource = readsource(parserSourceFile);
+    batchSource = readsource(batchSourceFile);
+    programSources[0] = tupleMapSource;
+    programSources[1] = source;
+    programSources[2] = parserSource;
+    programSources[3] = batchSource;
+    program = clCreateProgramWithSource(context, 4, programSources, NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateProgramWithSource" << endl;
         return status;
     }
-    status = clBuildProgram(program, numDevices, devices, NULL, NULL, NULL);
+    status = clBuildProgram(program, numDevices, devices, longIndex ? "-DLONG_INDEX" : NULL, NULL, NULL);
     if (CL_SUCCESS != status) {
         cout << "Error in clBuildProgram" << endl;
+        printBuildLog(program, devices[0]);
         return status;
     }
     kernel = clCreateKernel(program, "computeNesMap", &status);
@@ -238,26 +322,166 @@ int openclInitialization() {
         cout << "Error in clCreateKernel, computeNesMap kernel" << endl;
         return status;
     }
+    if (kernelReport) {
+        printProgramReport(program, devices[0], sourceFile);
+    }
+
+    if (csvFile != NULL) {
+        markRecordEndsKernel = clCreateKernel(program, "markRecordEnds", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, markRecordEnds kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(markRecordEndsKernel, devices[0], "markRecordEnds", SCAN_WORK_GROUP_SIZE);
+        scanBlocksKernel = clCreateKernel(program, "scanBlocks", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, scanBlocks kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(scanBlocksKernel, devices[0], "scanBlocks", SCAN_WORK_GROUP_SIZE);
+        addBlockOffsetsKernel = clCreateKernel(program, "addBlockOffsets", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, addBlockOffsets kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(addBlockOffsetsKernel, devices[0], "addBlockOffsets", SCAN_WORK_GROUP_SIZE);
+        compactRecordEndsKernel = clCreateKernel(program, "compactRecordEnds", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, compactRecordEnds kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(compactRecordEndsKernel, devices[0], "compactRecordEnds", SCAN_WORK_GROUP_SIZE);
+        parseRecordsKernel = clCreateKernel(program, "parseRecords", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, parseRecords kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(parseRecordsKernel, devices[0], "parseRecords", SCAN_WORK_GROUP_SIZE);
+    }
 
     return status;
 }
 
-void hostDataInitialization(int elements) {
-    numberOfTuples = elements;
-    inputSize = sizeof(InputRecord) * numberOfTuples;
-    outputSize = sizeof(OutputRecord) * numberOfTuples;
+size_t roundUp(size_t value, size_t multiple) {
+    return ((value + multiple - 1) / multiple) * multiple;
+}
 
-    cl_mem ddInput = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, inputSize, NULL, NULL);
-    cl_mem ddResult = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, outputSize, NULL, NULL);
+// Sequential parser, only used to validate the device-side parser
+int parseRecordsOnHost(const char *text, int size, InputRecord *records) {
+    int count = 0;
+    int field = 0;
+    bool inRecord = false;
+    uint32_t fields[2] = {0, 0};
+    for (int i = 0; i <= size; i++) {
+        char c = (i < size) ? text[i] : '\n';
+        if (c == '\n') {
+            if (inRecord) {
+                records[count].default_logical$id = fields[0];
+                records[count].default_logical$value = fields[1];
+                count++;
+            }
+            inRecord = false;
+            field = 0;
+            fields[0] = 0;
+            fields[1] = 0;
+            continue;
+        }
+        inRecord = true;
+        if (c >= '0' && c <= '9') {
+            fields[field] = fields[field] * 10 + (c - '0');
+        } else if (c == ',' && field < 1) {
+            field++;
+        }
+    }
+    return count;
+}
 
-    input = (InputRecord *) clEnqueueMapBuffer(commandQueue, ddInput, CL_TRUE, CL_MAP_WRITE, 0, inputSize, 0, NULL, NULL, NULL);
-    result = (OutputRecord *) clEnqueueMapBuffer(commandQueue, ddResult, CL_TRUE, CL_MAP_READ, 0, outputSize, 0, NULL, NULL, NULL);
+size_t tupleBufferSize(size_t tuples, size_t tupleSize) {
+    return TUPLE_DATA_OFFSET + tuples * tupleSize;
+}
 
-//    #pragma omp parallel for
-    for (int i = 0; i < numberOfTuples; i++) {
-        input[i].default_logical$id=i;
-        input[i].default_logical$value=i;
+void writeTupleBufferHeader(char *buffer, size_t tuples, size_t tupleSize, cl_uint schemaId) {
+    TupleBufferHeader *header = (TupleBufferHeader *) buffer;
+    header->dataOffset = TUPLE_DATA_OFFSET;
+    header->numberOfTuples = tuples;
+    header->tupleSize = tupleSize;
+    header->schemaId = schemaId;
+}
+
+// Allocates a pinned tuple buffer, maps it and writes its header. Returns the
+// start of the buffer, the tuples are at tupleData().
+char *allocateTupleBuffer(cl_command_queue queue, cl_mem *pinned, size_t tuples, size_t tupleSize, cl_uint schemaId, cl_int *status) {
+    size_t size = tupleBufferSize(tuples, tupleSize);
+    *pinned = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, size, NULL, status);
+    if (CL_SUCCESS != *status) {
+        cout << "Error in clCreateBuffer for a tuple buffer" << endl;
+        return NULL;
+    }
+    char *buffer = (char *) clEnqueueMapBuffer(queue, *pinned, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, size, 0, NULL, NULL, status);
+    if (CL_SUCCESS != *status) {
+        cout << "Error in clEnqueueMapBuffer for a tuple buffer" << endl;
+        return NULL;
+    }
+    if (((uintptr_t) buffer) % TUPLE_BUFFER_ALIGNMENT != 0) {
+        cout << "[WARNING] Tuple buffer is not aligned to " << TUPLE_BUFFER_ALIGNMENT << " bytes" << endl;
     }
+    writeTupleBufferHeader(buffer, tuples, tupleSize, schemaId);
+    return buffer;
+}
+
+// Pageable tuple buffer, for inputs larger than one pinned allocation
+char *allocatePageableTupleBuffer(size_t tuples, size_t tupleSize, cl_uint schemaId) {
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, TUPLE_BUFFER_ALIGNMENT, tupleBufferSize(tuples, tupleSize)) != 0) {
+        cout << "Error in posix_memalign for a tuple buffer" << endl;
+        return NULL;
+    }
+    writeTupleBufferHeader((char *) buffer, tuples, tupleSize, schemaId);
+    return (char *) buffer;
+}
+
+template <typename T>
+T *tupleData(char *buffer) {
+    return (T *) (buffer + ((TupleBufferHeader *) buffer)->dataOffset);
+}
+
+void hostDataInitialization(long elements) {
+    if (csvFile != NULL) {
+        csvText = readsource(csvFile);
+        textSize = strlen(csvText);
+        // Every record takes at least one digit and one delimiter
+        maxNumberOfTuples = (textSize + 1) / 2;
+        // The parser writes all the tuples of the text at once
+        chunkTuples = maxNumberOfTuples;
+    } else {
+        maxNumberOfTuples = elements;
+    }
+    numberOfTuples = maxNumberOfTuples;
+    inputSize = tupleBufferSize(numberOfTuples, sizeof(InputRecord));
+    outputSize = tupleBufferSize(numberOfTuples, sizeof(OutputRecord));
+
+    // Pinned host memory is itself a buffer, so it is limited to one device
+    // allocation; larger inputs are kept in pageable memory
+    cl_int status;
+    if (outputSize <= maxAllocationSize) {
+        inputBuffer = allocateTupleBuffer(commandQueue, &pinnedInput, numberOfTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA, &status);
+        resultBuffer = allocateTupleBuffer(commandQueue, &pinnedResult, numberOfTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA, &status);
+    } else {
+        inputBuffer = allocatePageableTupleBuffer(numberOfTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA);
+        resultBuffer = allocatePageableTupleBuffer(numberOfTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA);
+    }
+    input = tupleData<InputRecord>(inputBuffer);
+    result = tupleData<OutputRecord>(resultBuffer);
+
+    if (csvFile != NULL) {
+        // The tuples are parsed on the device from the CSV text
+        return;
+    }
+
+    generateInParallel(numberOfTuples, [](long i) {
+        input[i].default_logical$id=i;
+        input[i].default_logical$value=hashCounter(seed, i) >> 32;
+    });
 
 //    To print the initialized data
 //    for (int i = 0; i < 16; i++) {
@@ -268,84 +492,1438 @@ void hostDataInitialization(int elements) {
 
 int allocateBuffersOnGPU() {
     cl_int status;
-    d_input = clCreateBuffer(context, CL_MEM_READ_WRITE, numberOfTuples * sizeof(InputRecord), NULL, &status);
+    d_input = clCreateBuffer(context, CL_MEM_READ_WRITE, tupleBufferSize(chunkTuples, sizeof(InputRecord)), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_input" << endl;
     }
-    d_result = clCreateBuffer(context, CL_MEM_READ_WRITE, numberOfTuples * sizeof(OutputRecord), NULL, &status);
+    d_result = clCreateBuffer(context, CL_MEM_READ_WRITE, tupleBufferSize(chunkTuples, sizeof(OutputRecord)), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_result" << endl;
     }
+    if (csvFile == NULL) {
+        return status;
+    }
+
+    d_text = clCreateBuffer(context, CL_MEM_READ_ONLY, textSize, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for array d_text" << endl;
+        return status;
+    }
+    d_positions = clCreateBuffer(context, CL_MEM_READ_WRITE, textSize * sizeof(cl_int), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for array d_positions" << endl;
+        return status;
+    }
+    d_recordEnds = clCreateBuffer(context, CL_MEM_READ_WRITE, maxNumberOfTuples * sizeof(cl_int), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for array d_recordEnds" << endl;
+        return status;
+    }
+    d_numberOfRecords = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for d_numberOfRecords" << endl;
+        return status;
+    }
+    // One buffer of block totals per level of the recursive scan
+    int n = textSize;
+    int blocks;
+    do {
+        blocks = (n + SCAN_WORK_GROUP_SIZE - 1) / SCAN_WORK_GROUP_SIZE;
+        cl_mem d_blockSums = clCreateBuffer(context, CL_MEM_READ_WRITE, blocks * sizeof(cl_int), NULL, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateBuffer for the scan block sums" << endl;
+            return status;
+        }
+        d_scanLevels.push_back(d_blockSums);
+        n = blocks;
+    } while (blocks > 1);
     return status;
 }
 
-void writeBuffer() {
-    clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, numberOfTuples * sizeof(InputRecord), input, 0, NULL, &writeEvent1);
+// Writes the tuples [offset, offset + count) to the device tuple buffer. The
+// kernel reads the offset of the tuples from the headers, which are written
+// on their own when the tuples are not the whole input.
+void writeBuffer(size_t offset, size_t count) {
+    clEnqueueWriteBuffer(commandQueue, d_result, CL_TRUE, 0, TUPLE_DATA_OFFSET, resultBuffer, 0, NULL, NULL);
+    if (csvFile != NULL) {
+        // Only the header; the tuples are written by the parser
+        clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, TUPLE_DATA_OFFSET, inputBuffer, 0, NULL, NULL);
+        clEnqueueWriteBuffer(commandQueue, d_text, CL_TRUE, 0, textSize, csvText, 0, NULL, &writeEvent1);
+        clFlush(commandQueue);
+        return;
+    }
+    if (count == (size_t) numberOfTuples) {
+        clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, tupleBufferSize(count, sizeof(InputRecord)), inputBuffer, 0, NULL, &writeEvent1);
+    } else {
+        clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, 0, TUPLE_DATA_OFFSET, inputBuffer, 0, NULL, NULL);
+        clEnqueueWriteBuffer(commandQueue, d_input, CL_TRUE, TUPLE_DATA_OFFSET, count * sizeof(InputRecord), input + offset, 0, NULL, &writeEvent1);
+    }
     clFlush(commandQueue);
 }
 
-int runKernel() {
+void writeBuffer() {
+    writeBuffer(0, numberOfTuples);
+}
+
+// Multi-level inclusive scan: scan every block, scan the block totals and add
+// them back to the blocks.
+int scanInPlace(cl_mem data, int n, int level) {
     cl_int status;
-    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_input);
-    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_result);
-    status |= clSetKernelArg(kernel, 2, sizeof(cl_float), &numberOfTuples);
+    cl_event event;
+    int blocks = (n + SCAN_WORK_GROUP_SIZE - 1) / SCAN_WORK_GROUP_SIZE;
+    cl_mem blockSums = d_scanLevels[level];
 
     size_t globalWorkSize[1];
     size_t localWorkSize[1];
+    globalWorkSize[0] = blocks * SCAN_WORK_GROUP_SIZE;
+    localWorkSize[0] = SCAN_WORK_GROUP_SIZE;
+
+    status = clSetKernelArg(scanBlocksKernel, 0, sizeof(cl_mem), &data);
+    status |= clSetKernelArg(scanBlocksKernel, 1, sizeof(cl_mem), &blockSums);
+    status |= clSetKernelArg(scanBlocksKernel, 2, sizeof(cl_int), &n);
+    status |= clSetKernelArg(scanBlocksKernel, 3, SCAN_WORK_GROUP_SIZE * sizeof(cl_int), NULL);
+    status |= clEnqueueNDRangeKernel(commandQueue, scanBlocksKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+    parseEvents.push_back(event);
+
+    if (blocks > 1) {
+        status |= scanInPlace(blockSums, blocks, level + 1);
+        status |= clSetKernelArg(addBlockOffsetsKernel, 0, sizeof(cl_mem), &data);
+        status |= clSetKernelArg(addBlockOffsetsKernel, 1, sizeof(cl_mem), &blockSums);
+        status |= clSetKernelArg(addBlockOffsetsKernel, 2, sizeof(cl_int), &n);
+        status |= clEnqueueNDRangeKernel(commandQueue, addBlockOffsetsKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+        parseEvents.push_back(event);
+    }
+    return status;
+}
 
-    globalWorkSize[0] = numberOfTuples;
+// Parses the CSV text into d_input on the device. Only the number of records
+// is read back, as computeNesMap takes it as a scalar argument.
+int runParser() {
+    cl_int status;
+    cl_event event;
+
+    size_t globalWorkSize[1];
+    size_t localWorkSize[1];
+    globalWorkSize[0] = roundUp(textSize, SCAN_WORK_GROUP_SIZE);
+    localWorkSize[0] = SCAN_WORK_GROUP_SIZE;
+
+    status = clSetKernelArg(markRecordEndsKernel, 0, sizeof(cl_mem), &d_text);
+    status |= clSetKernelArg(markRecordEndsKernel, 1, sizeof(cl_int), &textSize);
+    status |= clSetKernelArg(markRecordEndsKernel, 2, sizeof(cl_mem), &d_positions);
+    status |= clEnqueueNDRangeKernel(commandQueue, markRecordEndsKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+    parseEvents.push_back(event);
+
+    status |= scanInPlace(d_positions, textSize, 0);
+
+    status |= clSetKernelArg(compactRecordEndsKernel, 0, sizeof(cl_mem), &d_positions);
+    status |= clSetKernelArg(compactRecordEndsKernel, 1, sizeof(cl_int), &textSize);
+    status |= clSetKernelArg(compactRecordEndsKernel, 2, sizeof(cl_mem), &d_recordEnds);
+    status |= clSetKernelArg(compactRecordEndsKernel, 3, sizeof(cl_mem), &d_numberOfRecords);
+    status |= clEnqueueNDRangeKernel(commandQueue, compactRecordEndsKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+    parseEvents.push_back(event);
+
+    globalWorkSize[0] = roundUp(maxNumberOfTuples, SCAN_WORK_GROUP_SIZE);
+    status |= clSetKernelArg(parseRecordsKernel, 0, sizeof(cl_mem), &d_text);
+    status |= clSetKernelArg(parseRecordsKernel, 1, sizeof(cl_mem), &d_recordEnds);
+    status |= clSetKernelArg(parseRecordsKernel, 2, sizeof(cl_mem), &d_numberOfRecords);
+    status |= clSetKernelArg(parseRecordsKernel, 3, sizeof(cl_mem), &d_input);
+    status |= clEnqueueNDRangeKernel(commandQueue, parseRecordsKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+    parseEvents.push_back(event);
+
+    cl_int parsedTuples = 0;
+    status |= clEnqueueReadBuffer(commandQueue, d_numberOfRecords, CL_TRUE, 0, sizeof(cl_int), &parsedTuples, 0, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error while parsing the CSV input on the device" << endl;
+    }
+    numberOfTuples = parsedTuples;
+    return status;
+}
+
+// Runs the map kernel on the chunk in the device buffers, in launches of at
+// most MAX_LAUNCH_ITEMS work-items, and reads it back to result + offset. The
+// numberOfTuples argument of each launch is the end of its range, so the
+// grid-stride loop of the kernel stops there. With --csv the chunk is the
+// whole input, parsed on the device first. The time of every launch is added
+// to kernelTime; kernelEvent is the last launch.
+int runKernel(size_t offset, size_t count) {
+    cl_int status;
+    if (csvFile != NULL) {
+        status = runParser();
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        count = numberOfTuples;
+    }
+    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_input);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_result);
+
+    size_t localWorkSize[1];
     localWorkSize[0] = LOCAL_WORK_SIZE;
 
-    clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, globalWorkSize, NULL, 0, NULL, &kernelEvent);
-    clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, sizeof(OutputRecord) * numberOfTuples, result, 0, NULL, &readEvent1);
+    vector<cl_event> launches;
+    for (size_t first = 0; first < count && CL_SUCCESS == status; first += MAX_LAUNCH_ITEMS) {
+        size_t launchItems = min(MAX_LAUNCH_ITEMS, count - first);
+        cl_long end = first + launchItems;
+        cl_int endInt = end;
+        status |= clSetKernelArg(kernel, 2, longIndex ? sizeof(cl_long) : sizeof(cl_int), longIndex ? (void *) &end : (void *) &endInt);
+
+        size_t globalWorkOffset[1] = {first};
+        size_t globalWorkSize[1] = {roundUp(launchItems, LOCAL_WORK_SIZE)};
+        status |= clEnqueueNDRangeKernel(commandQueue, kernel, 1, globalWorkOffset, globalWorkSize, localWorkSize, 0, NULL, &kernelEvent);
+        launches.push_back(kernelEvent);
+    }
+    if (CL_SUCCESS != status) {
+        cout << "Error in clEnqueueNDRangeKernel" << endl;
+        return status;
+    }
+    clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, TUPLE_DATA_OFFSET, sizeof(OutputRecord) * count, result + offset, 0, NULL, &readEvent1);
+    for (size_t l = 0; l < launches.size(); l++) {
+        kernelTime += getTime(launches[l]);
+        if (l + 1 < launches.size()) {
+            clReleaseEvent(launches[l]);
+        }
+    }
     return status;
 }
 
+int runKernel() {
+    return runKernel(0, numberOfTuples);
+}
+
+// The modes other than the main run and the comparison with the hand-written
+// kernel take the whole input in one device allocation and one launch, with
+// int sizes
+bool fitsOneLaunch(const char *option) {
+    if ((size_t) elements > chunkTuples || (size_t) elements > MAX_LAUNCH_ITEMS || longIndex) {
+        cout << "Error: " << option << " needs at most " << min(chunkTuples, (size_t) INT_MAX / 4) << " elements" << endl;
+        return false;
+    }
+    return true;
+}
+
 void freeMemory() {
+    releaseSpecializedKernels(specializationCache);
     clReleaseKernel(kernel);
     clReleaseProgram(program);
+    if (inputBuffer != NULL && pinnedInput == NULL) {
+        free(inputBuffer);
+        free(resultBuffer);
+    } else if (inputBuffer != NULL) {
+        clEnqueueUnmapMemObject(commandQueue, pinnedInput, inputBuffer, 0, NULL, NULL);
+        clEnqueueUnmapMemObject(commandQueue, pinnedResult, resultBuffer, 0, NULL, NULL);
+        clFinish(commandQueue);
+        clReleaseMemObject(pinnedInput);
+        clReleaseMemObject(pinnedResult);
+    }
     clReleaseCommandQueue(commandQueue);
     clReleaseMemObject(d_input);
     clReleaseMemObject(d_result);
+    if (csvFile != NULL) {
+        clReleaseKernel(markRecordEndsKernel);
+        clReleaseKernel(scanBlocksKernel);
+        clReleaseKernel(addBlockOffsetsKernel);
+        clReleaseKernel(compactRecordEndsKernel);
+        clReleaseKernel(parseRecordsKernel);
+        clReleaseMemObject(d_text);
+        clReleaseMemObject(d_positions);
+        clReleaseMemObject(d_recordEnds);
+        clReleaseMemObject(d_numberOfRecords);
+        for (size_t i = 0; i < d_scanLevels.size(); i++) {
+            clReleaseMemObject(d_scanLevels[i]);
+        }
+        free(csvText);
+    }
     clReleaseContext(context);
 
+    free(tupleMapSource);
     free(source);
+    free(parserSource);
+    free(batchSource);
     free(platforms);
     free(devices);
 }
 
-double median(vector<long> data) {
-    if (data.empty()) {
-        return 0;
+// Non-blocking execution layer: every operation is enqueued with an explicit
+// list of events it depends on and returns its own event, and completion is
+// observed through futures fulfilled by clSetEventCallback.
+cl_event enqueueWriteAsync(cl_command_queue queue, cl_mem buffer, size_t offset, size_t size, const void *ptr, const vector<cl_event> &dependencies, cl_int *status) {
+    cl_event event = NULL;
+    *status = clEnqueueWriteBuffer(queue, buffer, CL_FALSE, offset, size, ptr, dependencies.size(), dependencies.empty() ? NULL : &dependencies[0], &event);
+    return event;
+}
+
+cl_event enqueueKernelAsync(cl_command_queue queue, cl_kernel asyncKernel, size_t globalWorkSize, const vector<cl_event> &dependencies, cl_int *status) {
+    cl_event event = NULL;
+    *status = clEnqueueNDRangeKernel(queue, asyncKernel, 1, NULL, &globalWorkSize, NULL, dependencies.size(), dependencies.empty() ? NULL : &dependencies[0], &event);
+    return event;
+}
+
+cl_event enqueueReadAsync(cl_command_queue queue, cl_mem buffer, size_t offset, size_t size, void *ptr, const vector<cl_event> &dependencies, cl_int *status) {
+    cl_event event = NULL;
+    *status = clEnqueueReadBuffer(queue, buffer, CL_FALSE, offset, size, ptr, dependencies.size(), dependencies.empty() ? NULL : &dependencies[0], &event);
+    return event;
+}
+
+void CL_CALLBACK completionCallback(cl_event event, cl_int executionStatus, void *userData) {
+    promise<cl_int> *completion = (promise<cl_int> *) userData;
+    completion->set_value(executionStatus);
+    delete completion;
+}
+
+// The future holds CL_COMPLETE, or the negative error code if the command failed
+future<cl_int> whenComplete(cl_event event) {
+    promise<cl_int> *completion = new promise<cl_int>();
+    future<cl_int> completed = completion->get_future();
+    if (clSetEventCallback(event, CL_COMPLETE, completionCallback, completion) != CL_SUCCESS) {
+        completion->set_value(CL_INVALID_OPERATION);
+        delete completion;
+    }
+    return completed;
+}
+
+// One batch slot of the asynchronous pipeline: pinned host staging buffers, the
+// device buffers and the events of the batch currently in flight.
+struct AsyncBatch {
+    cl_mem pinnedInput;
+    cl_mem pinnedResult;
+    char *inputBuffer;
+    char *resultBuffer;
+    InputRecord *input;
+    OutputRecord *result;
+    cl_mem d_input;
+    cl_mem d_result;
+    cl_event writeEvent;
+    cl_event kernelEvent;
+    cl_event readEvent;
+    future<cl_int> completed;
+    int batchId;
+    bool inFlight;
+};
+
+void fillBatch(InputRecord *batchInput, int batchId, int tuples) {
+    for (int i = 0; i < tuples; i++) {
+        batchInput[i].default_logical$id = batchId * tuples + i;
+        batchInput[i].default_logical$value = i;
+    }
+}
+
+bool sameRecord(const OutputRecord &record, const OutputRecord &reference) {
+    return memcmp(&record, &reference, sizeof(OutputRecord)) == 0;
+}
+
+// Index of the first result tuple that differs from referenceMap, or -1
+long firstWrongTuple(const InputRecord *input, const OutputRecord *result, long tuples) {
+    OutputRecord expected;
+    for (long i = 0; i < tuples; i++) {
+        referenceMap(&input[i], &expected, 1);
+        if (!sameRecord(result[i], expected)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool checkBatch(const InputRecord *batchInput, const OutputRecord *batchResult, int tuples) {
+    return firstWrongTuple(batchInput, batchResult, tuples) < 0;
+}
+
+// Waits for the batch in the slot, checks it and accumulates its device time.
+// Returns false if the batch failed or produced a wrong result.
+bool retireBatch(AsyncBatch &batch, int tuples, vector<long> &batchTimers) {
+    cl_int executionStatus = batch.completed.get();
+    bool valid = executionStatus == CL_COMPLETE;
+    if (valid) {
+        // Device latency of the batch: from the start of the upload to the end of the read
+        cl_ulong start, end;
+        clGetEventProfilingInfo(batch.writeEvent, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+        clGetEventProfilingInfo(batch.readEvent, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+        batchTimers.push_back(end - start);
+        if (CHECK_RESULT && !checkBatch(batch.input, batch.result, tuples)) {
+            cout << "Result of batch " << batch.batchId << " is not correct" << endl;
+            valid = false;
+        }
     } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
+        cout << "Batch " << batch.batchId << " failed with status " << executionStatus << endl;
+    }
+    clReleaseEvent(batch.writeEvent);
+    clReleaseEvent(batch.kernelEvent);
+    clReleaseEvent(batch.readEvent);
+    batch.inFlight = false;
+    return valid;
+}
+
+// Streams asyncBatches batches through ASYNC_SLOTS slots, spread round-robin
+// over the given queues. The host thread fills the next batch while the
+// previous ones are still running on the device, and only blocks when it needs
+// a slot whose batch has not completed yet. Returns the total time in ns, or a
+// negative value on error.
+double runAsyncPipeline(const vector<cl_command_queue> &asyncQueues, int tuples, int batches, bool *valid) {
+    cl_int status;
+    size_t batchInputSize = sizeof(InputRecord) * tuples;
+    size_t batchOutputSize = sizeof(OutputRecord) * tuples;
+
+    AsyncBatch slots[ASYNC_SLOTS];
+    for (int s = 0; s < ASYNC_SLOTS; s++) {
+        AsyncBatch &slot = slots[s];
+        cl_command_queue asyncQueue = asyncQueues[s % asyncQueues.size()];
+        slot.inputBuffer = allocateTupleBuffer(asyncQueue, &slot.pinnedInput, tuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA, &status);
+        slot.resultBuffer = allocateTupleBuffer(asyncQueue, &slot.pinnedResult, tuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA, &status);
+        if (CL_SUCCESS != status) {
+            return -1;
+        }
+        slot.input = tupleData<InputRecord>(slot.inputBuffer);
+        slot.result = tupleData<OutputRecord>(slot.resultBuffer);
+        slot.d_input = clCreateBuffer(context, CL_MEM_READ_ONLY, tupleBufferSize(tuples, sizeof(InputRecord)), NULL, &status);
+        slot.d_result = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tupleBufferSize(tuples, sizeof(OutputRecord)), NULL, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error allocating the buffers of the asynchronous pipeline" << endl;
+            return -1;
+        }
+        // The headers are written once, every batch only moves the tuples
+        clEnqueueWriteBuffer(asyncQueue, slot.d_input, CL_TRUE, 0, TUPLE_DATA_OFFSET, slot.inputBuffer, 0, NULL, NULL);
+        clEnqueueWriteBuffer(asyncQueue, slot.d_result, CL_TRUE, 0, TUPLE_DATA_OFFSET, slot.resultBuffer, 0, NULL, NULL);
+        slot.inFlight = false;
+    }
+
+    // One kernel object per slot, so the arguments are only set once
+    cl_kernel slotKernels[ASYNC_SLOTS];
+    for (int s = 0; s < ASYNC_SLOTS; s++) {
+        slotKernels[s] = clCreateKernel(program, "computeNesMap", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, computeNesMap kernel" << endl;
+            return -1;
         }
+        status = clSetKernelArg(slotKernels[s], 0, sizeof(cl_mem), &slots[s].d_input);
+        status |= clSetKernelArg(slotKernels[s], 1, sizeof(cl_mem), &slots[s].d_result);
+        status |= clSetKernelArg(slotKernels[s], 2, sizeof(cl_int), &tuples);
     }
+
+    vector<long> batchTimers;
+    long ingestTime = 0;
+    long waitTime = 0;
+
+    auto start_time = chrono::high_resolution_clock::now();
+    for (int b = 0; b < batches; b++) {
+        AsyncBatch &slot = slots[b % ASYNC_SLOTS];
+        cl_command_queue asyncQueue = asyncQueues[(b % ASYNC_SLOTS) % asyncQueues.size()];
+        if (slot.inFlight) {
+            auto wait_start = chrono::high_resolution_clock::now();
+            *valid &= retireBatch(slot, tuples, batchTimers);
+            waitTime += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - wait_start).count();
+        }
+
+        // Ingest: prepare the next batch while the device works on the others
+        auto ingest_start = chrono::high_resolution_clock::now();
+        fillBatch(slot.input, b, tuples);
+        ingestTime += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - ingest_start).count();
+
+        // write -> kernel -> read, chained by events only
+        vector<cl_event> noDependencies;
+        slot.writeEvent = enqueueWriteAsync(asyncQueue, slot.d_input, TUPLE_DATA_OFFSET, batchInputSize, slot.input, noDependencies, &status);
+        slot.kernelEvent = enqueueKernelAsync(asyncQueue, slotKernels[b % ASYNC_SLOTS], tuples, vector<cl_event>(1, slot.writeEvent), &status);
+        slot.readEvent = enqueueReadAsync(asyncQueue, slot.d_result, TUPLE_DATA_OFFSET, batchOutputSize, slot.result, vector<cl_event>(1, slot.kernelEvent), &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error enqueuing batch " << b << endl;
+            return -1;
+        }
+        slot.completed = whenComplete(slot.readEvent);
+        slot.batchId = b;
+        slot.inFlight = true;
+        clFlush(asyncQueue);
+    }
+    for (int s = 0; s < ASYNC_SLOTS; s++) {
+        if (slots[s].inFlight) {
+            auto wait_start = chrono::high_resolution_clock::now();
+            *valid &= retireBatch(slots[s], tuples, batchTimers);
+            waitTime += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - wait_start).count();
+        }
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+    double total = chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count();
+
+    cout << "Median BatchLatency: " << median(batchTimers) << " (ns)";
+    cout << ", Host IngestTime: " << ingestTime << " (ns), Host WaitTime: " << waitTime << " (ns)" << endl;
+
+    for (int s = 0; s < ASYNC_SLOTS; s++) {
+        cl_command_queue asyncQueue = asyncQueues[s % asyncQueues.size()];
+        clReleaseKernel(slotKernels[s]);
+        clEnqueueUnmapMemObject(asyncQueue, slots[s].pinnedInput, slots[s].inputBuffer, 0, NULL, NULL);
+        clEnqueueUnmapMemObject(asyncQueue, slots[s].pinnedResult, slots[s].resultBuffer, 0, NULL, NULL);
+        clFinish(asyncQueue);
+        clReleaseMemObject(slots[s].pinnedInput);
+        clReleaseMemObject(slots[s].pinnedResult);
+        clReleaseMemObject(slots[s].d_input);
+        clReleaseMemObject(slots[s].d_result);
+    }
+    return total;
 }
 
-double median(vector<double> data) {
+// Runs the asynchronous pipeline on one in-order queue, on a pool of
+// numberOfQueues in-order queues and on one out-of-order queue, and reports
+// the throughput of each configuration against the single in-order queue.
+int runAsyncComparison(int tuples, int batches) {
+    cl_int status;
+    cl_command_queue_properties supported = 0;
+    clGetDeviceInfo(devices[0], CL_DEVICE_QUEUE_PROPERTIES, sizeof(supported), &supported, NULL);
+
+    vector<cl_command_queue> serialQueue;
+    vector<cl_command_queue> queuePool;
+    vector<cl_command_queue> outOfOrderQueue;
+    vector<cl_command_queue> *configurations[] = {&serialQueue, &queuePool, &outOfOrderQueue};
+    const char *names[] = {"In-order queue     ", "In-order queue pool", "Out-of-order queue "};
+    int queueCounts[] = {1, numberOfQueues, 0};
+    if (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+        queueCounts[2] = 1;
+    } else {
+        cout << "[WARNING] Out-of-order queues not supported by the device" << endl;
+    }
+    for (int c = 0; c < 3; c++) {
+        cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE | (c == 2 ? CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE : 0);
+        for (int q = 0; q < queueCounts[c]; q++) {
+            cl_command_queue asyncQueue = clCreateCommandQueue(context, devices[0], properties, &status);
+            if (status != CL_SUCCESS || asyncQueue == NULL) {
+                cout << "Error in clCreateCommandQueue for the asynchronous pipeline" << endl;
+                return status;
+            }
+            configurations[c]->push_back(asyncQueue);
+        }
+    }
+
+    cout << "Asynchronous pipeline: " << batches << " batches of " << tuples << " tuples, " << ASYNC_SLOTS << " in flight, pool of " << numberOfQueues << " queues" << endl;
+    double serialTime = 0;
+    bool valid = true;
+    for (int c = 0; c < 3; c++) {
+        if (configurations[c]->empty()) {
+            continue;
+        }
+        cout << names[c] << ": ";
+        double total = runAsyncPipeline(*configurations[c], tuples, batches, &valid);
+        if (total < 0) {
+            return -1;
+        }
+        if (c == 0) {
+            serialTime = total;
+        }
+        cout << names[c] << ": " << total << " (ns), " << (total > 0 ? (double) batches * tuples / (total * 1e-9) : 0) << " tuples/s";
+        cout << ", speedup " << (total > 0 ? serialTime / total : 0) << "x" << endl;
+    }
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+
+    for (int c = 0; c < 3; c++) {
+        for (size_t q = 0; q < configurations[c]->size(); q++) {
+            clReleaseCommandQueue((*configurations[c])[q]);
+        }
+    }
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Nearest-rank percentile
+double percentile(vector<long> data, int percent) {
     if (data.empty()) {
         return 0;
-    } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
+    }
+    sort(data.begin(), data.end());
+    size_t rank = (data.size() * percent + 99) / 100;
+    return double(data[max((size_t) 1, rank) - 1]);
+}
+
+// Streams batches one at a time on commandQueue, with the batch size chosen
+// by the AIMD controller from the latencies of the sliding window. The
+// latency of a batch is measured from the start of its write to the end of
+// its read.
+int runAdaptiveBatches(int maxTuples, int batches) {
+    cl_int status;
+    cl_mem pinnedInput;
+    cl_mem pinnedResult;
+    char *batchInputBuffer = allocateTupleBuffer(commandQueue, &pinnedInput, maxTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA, &status);
+    char *batchResultBuffer = allocateTupleBuffer(commandQueue, &pinnedResult, maxTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    InputRecord *batchInput = tupleData<InputRecord>(batchInputBuffer);
+    OutputRecord *batchResult = tupleData<OutputRecord>(batchResultBuffer);
+    cl_mem d_batchInput = clCreateBuffer(context, CL_MEM_READ_ONLY, tupleBufferSize(maxTuples, sizeof(InputRecord)), NULL, &status);
+    cl_mem d_batchResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tupleBufferSize(maxTuples, sizeof(OutputRecord)), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error allocating the buffers of the adaptive batches" << endl;
+        return status;
+    }
+    // The headers are written once, every batch only moves the tuples
+    clEnqueueWriteBuffer(commandQueue, d_batchInput, CL_TRUE, 0, TUPLE_DATA_OFFSET, batchInputBuffer, 0, NULL, NULL);
+    clEnqueueWriteBuffer(commandQueue, d_batchResult, CL_TRUE, 0, TUPLE_DATA_OFFSET, batchResultBuffer, 0, NULL, NULL);
+    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_batchInput);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_batchResult);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg" << endl;
+        return status;
+    }
+
+    int minTuples = min(ADAPTIVE_MIN_TUPLES, maxTuples);
+    int increase = max(1, (int) (maxTuples * ADAPTIVE_INCREASE));
+    int tuples = minTuples;
+    deque<long> window;
+    vector<long> latencies;
+    long intervalWrite = 0;
+    long intervalKernel = 0;
+    long intervalRead = 0;
+    double intervalTuples = 0;
+    double totalTuples = 0;
+    int decisions = 0;
+    int decisionsOverTarget = 0;
+    bool valid = true;
+
+    cout << "Adaptive batches: " << batches << " batches of up to " << maxTuples << " tuples, p99 target " << latencyTarget / 1e3 << " (us), window of " << ADAPTIVE_WINDOW << " batches" << endl;
+    cout << "Interval, BatchTuples, Window, p99 Latency (us), Write (us), Kernel (us), Read (us), Throughput (tuples/s)" << endl;
+    auto start_time = chrono::high_resolution_clock::now();
+    auto interval_start = start_time;
+    for (int b = 0; b < batches; b++) {
+        fillBatch(batchInput, b, tuples);
+        cl_event batchWrite;
+        cl_event batchKernel;
+        cl_event batchRead;
+        size_t globalWorkSize = tuples;
+        status = clSetKernelArg(kernel, 2, sizeof(cl_int), &tuples);
+        status |= clEnqueueWriteBuffer(commandQueue, d_batchInput, CL_FALSE, TUPLE_DATA_OFFSET, sizeof(InputRecord) * tuples, batchInput, 0, NULL, &batchWrite);
+        status |= clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, &globalWorkSize, NULL, 0, NULL, &batchKernel);
+        status |= clEnqueueReadBuffer(commandQueue, d_batchResult, CL_TRUE, TUPLE_DATA_OFFSET, sizeof(OutputRecord) * tuples, batchResult, 0, NULL, &batchRead);
+        if (CL_SUCCESS != status) {
+            cout << "Error enqueuing batch " << b << endl;
+            return status;
+        }
+        cl_ulong start, end;
+        clGetEventProfilingInfo(batchWrite, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+        clGetEventProfilingInfo(batchRead, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+        window.push_back(end - start);
+        if ((int) window.size() > ADAPTIVE_WINDOW) {
+            window.pop_front();
+        }
+        latencies.push_back(end - start);
+        intervalWrite += getTime(batchWrite);
+        intervalKernel += getTime(batchKernel);
+        intervalRead += getTime(batchRead);
+        clReleaseEvent(batchWrite);
+        clReleaseEvent(batchKernel);
+        clReleaseEvent(batchRead);
+        if (CHECK_RESULT && !checkBatch(batchInput, batchResult, tuples)) {
+            cout << "Result of batch " << b << " is not correct" << endl;
+            valid = false;
+        }
+        intervalTuples += tuples;
+        totalTuples += tuples;
+
+        if ((b + 1) % ADAPTIVE_INTERVAL == 0 || b == batches - 1) {
+            auto interval_end = chrono::high_resolution_clock::now();
+            double intervalTime = chrono::duration_cast<chrono::nanoseconds>(interval_end - interval_start).count();
+            double p99 = percentile(vector<long>(window.begin(), window.end()), 99);
+            int n = b % ADAPTIVE_INTERVAL + 1;
+            cout << (b / ADAPTIVE_INTERVAL) << ", " << tuples << ", " << window.size() << ", " << p99 / 1e3 << ", " << intervalWrite / 1e3 / n
+                 << ", " << intervalKernel / 1e3 / n << ", " << intervalRead / 1e3 / n << ", " << (intervalTime > 0 ? intervalTuples / (intervalTime * 1e-9) : 0) << endl;
+            if ((int) window.size() == ADAPTIVE_WINDOW) {
+                int previousTuples = tuples;
+                decisions++;
+                if (p99 > latencyTarget) {
+                    decisionsOverTarget++;
+                    tuples = max(minTuples, tuples / 2);
+                } else if (p99 < ADAPTIVE_HEADROOM * latencyTarget) {
+                    tuples = min(maxTuples, tuples + increase);
+                }
+                if (tuples != previousTuples) {
+                    window.clear();
+                }
+            }
+            intervalWrite = 0;
+            intervalKernel = 0;
+            intervalRead = 0;
+            intervalTuples = 0;
+            interval_start = interval_end;
+        }
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+    double total = chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count();
+
+    cout << "Final BatchTuples: " << tuples << endl;
+    cout << "p99 BatchLatency: " << percentile(latencies, 99) / 1e3 << " (us), " << decisionsOverTarget << " of " << decisions << " decisions over the target" << endl;
+    cout << "TotalTime: " << total << " (ns)" << endl;
+    cout << "Throughput: " << (total > 0 ? totalTuples / (total * 1e-9) : 0) << " tuples/s" << endl;
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+
+    clEnqueueUnmapMemObject(commandQueue, pinnedInput, batchInputBuffer, 0, NULL, NULL);
+    clEnqueueUnmapMemObject(commandQueue, pinnedResult, batchResultBuffer, 0, NULL, NULL);
+    clFinish(commandQueue);
+    clReleaseMemObject(pinnedInput);
+    clReleaseMemObject(pinnedResult);
+    clReleaseMemObject(d_batchInput);
+    clReleaseMemObject(d_batchResult);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Batches of the batched mode have different sizes, between half and all of
+// the requested tuples
+int batchTuples(int batchId, int tuples) {
+    int half = max(1, tuples / 2);
+    return half + (batchId * 7919) % (max(tuples, half) - half + 1);
+}
+
+// Packs batches [first, first + count) into the packed input buffer, after its
+// header, and fills the offsets table. Returns the number of packed tuples.
+int packBatches(const vector<vector<InputRecord> > &batchInput, int first, int count, char *packedInput, vector<cl_int> &batchOffsets) {
+    InputRecord *tuples = tupleData<InputRecord>(packedInput);
+    int packed = 0;
+    for (int k = 0; k < count; k++) {
+        const vector<InputRecord> &batch = batchInput[first + k];
+        batchOffsets[k] = packed;
+        memcpy(tuples + packed, &batch[0], batch.size() * sizeof(InputRecord));
+        packed += batch.size();
+    }
+    batchOffsets[count] = packed;
+    writeTupleBufferHeader(packedInput, packed, sizeof(InputRecord), INPUT_RECORD_SCHEMA);
+    return packed;
+}
+
+// Copies the packed results back to the result of every batch
+void scatterBatches(const char *packedResult, int first, int count, const vector<cl_int> &batchOffsets, vector<vector<OutputRecord> > &batchResult) {
+    const OutputRecord *tuples = (const OutputRecord *) (packedResult + TUPLE_DATA_OFFSET);
+    for (int k = 0; k < count; k++) {
+        vector<OutputRecord> &batch = batchResult[first + k];
+        memcpy(&batch[0], tuples + batchOffsets[k], batch.size() * sizeof(OutputRecord));
+    }
+}
+
+// Runs the same batches with one launch per group of up to `limit` batches, for
+// every packing limit. The latency of a batch is the time from the packing of
+// its group to the scatter of its results; batches of a group share it.
+int runBatchedQueries(int tuples, int batches) {
+    cl_int status;
+    cl_kernel batchedKernel = clCreateKernel(program, "computeNesMapBatched", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, computeNesMapBatched kernel" << endl;
+        return status;
+    }
+    checkLocalWorkSize(batchedKernel, devices[0], "computeNesMapBatched", BATCH_WORK_GROUP_SIZE);
+
+    vector<vector<InputRecord> > batchInput(batches);
+    vector<vector<OutputRecord> > batchResult(batches);
+    int totalTuples = 0;
+    for (int b = 0; b < batches; b++) {
+        int n = batchTuples(b, tuples);
+        batchInput[b].resize(n);
+        batchResult[b].resize(n);
+        fillBatch(&batchInput[b][0], b, n);
+        totalTuples += n;
+    }
+
+    // Sized for all the batches, which is the largest packing limit
+    cl_mem pinnedPackedInput;
+    cl_mem pinnedPackedResult;
+    char *packedInput = allocateTupleBuffer(commandQueue, &pinnedPackedInput, totalTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA, &status);
+    char *packedResult = allocateTupleBuffer(commandQueue, &pinnedPackedResult, totalTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_mem d_packedInput = clCreateBuffer(context, CL_MEM_READ_ONLY, tupleBufferSize(totalTuples, sizeof(InputRecord)), NULL, &status);
+    cl_mem d_packedResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tupleBufferSize(totalTuples, sizeof(OutputRecord)), NULL, &status);
+    cl_mem d_batchOffsets = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(cl_int) * (batches + 1), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error allocating the buffers of the batched mode" << endl;
+        return status;
+    }
+    clEnqueueWriteBuffer(commandQueue, d_packedResult, CL_TRUE, 0, TUPLE_DATA_OFFSET, packedResult, 0, NULL, NULL);
+    status = clSetKernelArg(batchedKernel, 0, sizeof(cl_mem), &d_packedInput);
+    status |= clSetKernelArg(batchedKernel, 1, sizeof(cl_mem), &d_packedResult);
+    status |= clSetKernelArg(batchedKernel, 2, sizeof(cl_mem), &d_batchOffsets);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, computeNesMapBatched kernel" << endl;
+        return status;
+    }
+
+    vector<int> limits;
+    for (size_t l = 0; l < sizeof(BATCH_PACKING_LIMITS) / sizeof(BATCH_PACKING_LIMITS[0]) && BATCH_PACKING_LIMITS[l] < batches; l++) {
+        limits.push_back(BATCH_PACKING_LIMITS[l]);
+    }
+    limits.push_back(batches);
+
+    cout << "Batched execution: " << batches << " batches, " << totalTuples << " tuples" << endl;
+    bool valid = true;
+    vector<cl_int> batchOffsets(batches + 1);
+    for (size_t l = 0; l < limits.size(); l++) {
+        int limit = limits[l];
+        int launches = 0;
+        vector<long> latencies;
+        bool limitValid = true;
+
+        auto start_time = chrono::high_resolution_clock::now();
+        for (int first = 0; first < batches; first += limit) {
+            int count = min(limit, batches - first);
+            auto group_start = chrono::high_resolution_clock::now();
+            int packed = packBatches(batchInput, first, count, packedInput, batchOffsets);
+
+            status = clEnqueueWriteBuffer(commandQueue, d_packedInput, CL_FALSE, 0, tupleBufferSize(packed, sizeof(InputRecord)), packedInput, 0, NULL, NULL);
+            status |= clEnqueueWriteBuffer(commandQueue, d_batchOffsets, CL_FALSE, 0, sizeof(cl_int) * (count + 1), &batchOffsets[0], 0, NULL, NULL);
+            status |= clSetKernelArg(batchedKernel, 3, sizeof(cl_int), &count);
+            size_t globalWorkSize[1] = {(size_t) count * BATCH_WORK_GROUP_SIZE};
+            size_t localWorkSize[1] = {(size_t) BATCH_WORK_GROUP_SIZE};
+            status |= clEnqueueNDRangeKernel(commandQueue, batchedKernel, 1, NULL, globalWorkSize, localWorkSize, 0, NULL, NULL);
+            status |= clEnqueueReadBuffer(commandQueue, d_packedResult, CL_TRUE, TUPLE_DATA_OFFSET, packed * sizeof(OutputRecord), packedResult + TUPLE_DATA_OFFSET, 0, NULL, NULL);
+            if (CL_SUCCESS != status) {
+                cout << "Error running the batched kernel" << endl;
+                return status;
+            }
+            scatterBatches(packedResult, first, count, batchOffsets, batchResult);
+            long latency = chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - group_start).count();
+            latencies.insert(latencies.end(), count, latency);
+            launches++;
+        }
+        auto end_time = chrono::high_resolution_clock::now();
+        double total = chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count();
+
+        if (CHECK_RESULT) {
+            for (int b = 0; b < batches && limitValid; b++) {
+                limitValid = checkBatch(&batchInput[b][0], &batchResult[b][0], batchInput[b].size());
+            }
+            valid &= limitValid;
+            for (int b = 0; b < batches; b++) {
+                memset(&batchResult[b][0], 0, batchResult[b].size() * sizeof(OutputRecord));
+            }
+        }
+
+        cout << "Packing limit " << limit << ": " << launches << " launches"
+             << ", Median BatchLatency: " << median(latencies) << " (ns)"
+             << ", Throughput: " << (total > 0 ? totalTuples / (total * 1e-9) : 0) << " tuples/s"
+             << (limitValid ? "" : ", result is not correct") << endl;
+    }
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+
+    clReleaseKernel(batchedKernel);
+    clEnqueueUnmapMemObject(commandQueue, pinnedPackedInput, packedInput, 0, NULL, NULL);
+    clEnqueueUnmapMemObject(commandQueue, pinnedPackedResult, packedResult, 0, NULL, NULL);
+    clFinish(commandQueue);
+    clReleaseMemObject(pinnedPackedInput);
+    clReleaseMemObject(pinnedPackedResult);
+    clReleaseMemObject(d_packedInput);
+    clReleaseMemObject(d_packedResult);
+    clReleaseMemObject(d_batchOffsets);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Bounded lock-free queue of slot indices, after Vyukov's bounded MPMC queue.
+// Every cell carries a sequence number that tells producers and consumers
+// whether it belongs to the current lap, so neither side takes a lock. The
+// capacity must be a power of two.
+class SlotQueue {
+public:
+    explicit SlotQueue(size_t capacity) : cells(capacity), mask(capacity - 1) {
+        for (size_t i = 0; i < capacity; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+        }
+        enqueuePosition.store(0, memory_order_relaxed);
+        dequeuePosition.store(0, memory_order_relaxed);
+    }
+
+    // Returns false if the queue is full
+    bool tryPush(int value) {
+        size_t position = enqueuePosition.load(memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Returns false if the queue is empty
+    bool tryPop(int &value) {
+        size_t position = dequeuePosition.load(memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+            if (difference == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1, memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = dequeuePosition.load(memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        int value;
+    };
+
+    vector<Cell> cells;
+    size_t mask;
+    // Producers and consumers update different cache lines
+    char padding0[64];
+    atomic<size_t> enqueuePosition;
+    char padding1[64];
+    atomic<size_t> dequeuePosition;
+    char padding2[64];
+};
+
+// One pinned batch slot of the ingest ring
+struct IngestSlot {
+    cl_mem pinnedInput;
+    cl_mem pinnedResult;
+    char *inputBuffer;
+    char *resultBuffer;
+    InputRecord *input;
+    OutputRecord *result;
+    int batchId;
+};
+
+// Backpressure counters: a stall is one wait for a slot, the time is the sum of
+// all the waits
+struct StallCounter {
+    atomic<long> stalls;
+    atomic<long> time;
+};
+
+// Pops a slot index, spinning while the queue is empty and counting the wait
+int popSlot(SlotQueue &queue, StallCounter &counter) {
+    int slot;
+    if (queue.tryPop(slot)) {
+        return slot;
+    }
+    auto wait_start = chrono::high_resolution_clock::now();
+    while (!queue.tryPop(slot)) {
+        this_thread::yield();
+    }
+    counter.stalls++;
+    counter.time += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - wait_start).count();
+    return slot;
+}
+
+// Producer threads take free slots, fill them with the next batch and hand them
+// to the main thread, which uploads them, runs computeNesMap, checks the result
+// and returns the slots. Production and device execution overlap, and the full
+// and empty stalls show which side is the bottleneck.
+int runIngestRing(int tuples, int batches, int producers) {
+    cl_int status;
+    size_t batchInputSize = sizeof(InputRecord) * tuples;
+    size_t batchOutputSize = sizeof(OutputRecord) * tuples;
+
+    IngestSlot slots[INGEST_SLOTS];
+    SlotQueue freeSlots(INGEST_SLOTS);
+    SlotQueue filledSlots(INGEST_SLOTS);
+    for (int s = 0; s < INGEST_SLOTS; s++) {
+        IngestSlot &slot = slots[s];
+        slot.inputBuffer = allocateTupleBuffer(commandQueue, &slot.pinnedInput, tuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA, &status);
+        slot.resultBuffer = allocateTupleBuffer(commandQueue, &slot.pinnedResult, tuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA, &status);
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        slot.input = tupleData<InputRecord>(slot.inputBuffer);
+        slot.result = tupleData<OutputRecord>(slot.resultBuffer);
+        freeSlots.tryPush(s);
+    }
+
+    cl_mem d_ingestInput = clCreateBuffer(context, CL_MEM_READ_ONLY, tupleBufferSize(tuples, sizeof(InputRecord)), NULL, &status);
+    cl_mem d_ingestResult = clCreateBuffer(context, CL_MEM_WRITE_ONLY, tupleBufferSize(tuples, sizeof(OutputRecord)), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error allocating the buffers of the ingest ring" << endl;
+        return status;
+    }
+    clEnqueueWriteBuffer(commandQueue, d_ingestInput, CL_TRUE, 0, TUPLE_DATA_OFFSET, slots[0].inputBuffer, 0, NULL, NULL);
+    clEnqueueWriteBuffer(commandQueue, d_ingestResult, CL_TRUE, 0, TUPLE_DATA_OFFSET, slots[0].resultBuffer, 0, NULL, NULL);
+    status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_ingestInput);
+    status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_ingestResult);
+    status |= clSetKernelArg(kernel, 2, sizeof(cl_int), &tuples);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, computeNesMap kernel" << endl;
+        return status;
+    }
+
+    StallCounter fullStalls;
+    StallCounter emptyStalls;
+    fullStalls.stalls.store(0);
+    fullStalls.time.store(0);
+    emptyStalls.stalls.store(0);
+    emptyStalls.time.store(0);
+    atomic<int> nextBatch(0);
+
+    auto start_time = chrono::high_resolution_clock::now();
+    vector<thread> producerThreads;
+    for (int p = 0; p < producers; p++) {
+        producerThreads.push_back(thread([&]() {
+            for (int b = nextBatch++; b < batches; b = nextBatch++) {
+                int s = popSlot(freeSlots, fullStalls);
+                fillBatch(slots[s].input, b, tuples);
+                slots[s].batchId = b;
+                filledSlots.tryPush(s);
+            }
+        }));
+    }
+
+    bool valid = true;
+    for (int submitted = 0; submitted < batches; submitted++) {
+        int s = popSlot(filledSlots, emptyStalls);
+        IngestSlot &slot = slots[s];
+        size_t globalWorkSize[1] = {(size_t) tuples};
+        status = clEnqueueWriteBuffer(commandQueue, d_ingestInput, CL_FALSE, TUPLE_DATA_OFFSET, batchInputSize, slot.input, 0, NULL, NULL);
+        status |= clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, globalWorkSize, NULL, 0, NULL, NULL);
+        status |= clEnqueueReadBuffer(commandQueue, d_ingestResult, CL_TRUE, TUPLE_DATA_OFFSET, batchOutputSize, slot.result, 0, NULL, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error submitting batch " << slot.batchId << endl;
+            valid = false;
+        } else if (CHECK_RESULT && !checkBatch(slot.input, slot.result, tuples)) {
+            cout << "Result of batch " << slot.batchId << " is not correct" << endl;
+            valid = false;
+        }
+        freeSlots.tryPush(s);
+    }
+    for (size_t p = 0; p < producerThreads.size(); p++) {
+        producerThreads[p].join();
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+    double total = chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count();
+
+    cout << "Ingest ring: " << batches << " batches of " << tuples << " tuples, " << producers << " producers, " << INGEST_SLOTS << " slots" << endl;
+    cout << "Full stalls: " << fullStalls.stalls.load() << " (" << fullStalls.time.load() << " ns)" << endl;
+    cout << "Empty stalls: " << emptyStalls.stalls.load() << " (" << emptyStalls.time.load() << " ns)" << endl;
+    cout << "TotalTime: " << total << " (ns)" << endl;
+    cout << "Throughput: " << (total > 0 ? (double) batches * tuples / (total * 1e-9) : 0) << " tuples/s" << endl;
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+
+    for (int s = 0; s < INGEST_SLOTS; s++) {
+        clEnqueueUnmapMemObject(commandQueue, slots[s].pinnedInput, slots[s].inputBuffer, 0, NULL, NULL);
+        clEnqueueUnmapMemObject(commandQueue, slots[s].pinnedResult, slots[s].resultBuffer, 0, NULL, NULL);
+    }
+    clFinish(commandQueue);
+    for (int s = 0; s < INGEST_SLOTS; s++) {
+        clReleaseMemObject(slots[s].pinnedInput);
+        clReleaseMemObject(slots[s].pinnedResult);
+    }
+    clReleaseMemObject(d_ingestInput);
+    clReleaseMemObject(d_ingestResult);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Shared Virtual Memory path (--svm): the tuple buffers live in SVM
+// allocations that the host fills in place and the kernel receives as raw
+// pointers, so no staging copies are needed. Returns the SVM capabilities of the
+// device, or 0 when it only supports OpenCL 1.x.
+cl_device_svm_capabilities svmCapabilities() {
+    char version[256];
+    clGetDeviceInfo(devices[0], CL_DEVICE_VERSION, sizeof(version), version, NULL);
+    if (strncmp(version, "OpenCL 1.", 9) == 0) {
+        return 0;
+    }
+    cl_device_svm_capabilities capabilities = 0;
+    if (clGetDeviceInfo(devices[0], CL_DEVICE_SVM_CAPABILITIES, sizeof(capabilities), &capabilities, NULL) != CL_SUCCESS) {
+        return 0;
+    }
+    return capabilities;
+}
+
+// Compares the SVM path against the buffer path (write + kernel + read) on the
+// same tuples. Fine-grained buffers are used when the device supports them;
+// coarse-grained buffers need a map/unmap around every host access.
+int runSvmBenchmark(cl_device_svm_capabilities capabilities) {
+    cl_int status;
+    bool fineGrained = (capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) != 0;
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE | (fineGrained ? CL_MEM_SVM_FINE_GRAIN_BUFFER : 0);
+    size_t svmInputSize = tupleBufferSize(numberOfTuples, sizeof(InputRecord));
+    size_t svmOutputSize = tupleBufferSize(numberOfTuples, sizeof(OutputRecord));
+
+    char *svmInput = (char *) clSVMAlloc(context, flags, svmInputSize, TUPLE_BUFFER_ALIGNMENT);
+    char *svmResult = (char *) clSVMAlloc(context, flags, svmOutputSize, TUPLE_BUFFER_ALIGNMENT);
+    if (svmInput == NULL || svmResult == NULL) {
+        cout << "Error in clSVMAlloc" << endl;
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+
+    if (!fineGrained) {
+        clEnqueueSVMMap(commandQueue, CL_TRUE, CL_MAP_WRITE, svmInput, svmInputSize, 0, NULL, NULL);
+        clEnqueueSVMMap(commandQueue, CL_TRUE, CL_MAP_WRITE, svmResult, svmOutputSize, 0, NULL, NULL);
+    }
+    writeTupleBufferHeader(svmInput, numberOfTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA);
+    writeTupleBufferHeader(svmResult, numberOfTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA);
+    InputRecord *svmTuples = tupleData<InputRecord>(svmInput);
+    OutputRecord *svmOutput = tupleData<OutputRecord>(svmResult);
+    memcpy(svmTuples, input, sizeof(InputRecord) * numberOfTuples);
+    if (!fineGrained) {
+        clEnqueueSVMUnmap(commandQueue, svmInput, 0, NULL, NULL);
+        clEnqueueSVMUnmap(commandQueue, svmResult, 0, NULL, NULL);
+    }
+
+    cl_kernel svmKernel = clCreateKernel(program, "computeNesMap", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, computeNesMap kernel" << endl;
+        return status;
+    }
+    status = clSetKernelArgSVMPointer(svmKernel, 0, svmInput);
+    status |= clSetKernelArgSVMPointer(svmKernel, 1, svmResult);
+    status |= clSetKernelArg(svmKernel, 2, sizeof(cl_int), &numberOfTuples);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArgSVMPointer" << endl;
+        return status;
+    }
+
+    size_t globalWorkSize[1];
+    globalWorkSize[0] = numberOfTuples;
+    vector<double> svmTimers;
+    vector<double> bufferTimers;
+    bool valid = true;
+
+    for (int i = 0; i < SVM_ITERATIONS; i++) {
+        auto start_time = chrono::high_resolution_clock::now();
+        if (!fineGrained) {
+            // Hand the (already filled) tuples over to the device
+            clEnqueueSVMMap(commandQueue, CL_FALSE, CL_MAP_WRITE, svmInput, svmInputSize, 0, NULL, NULL);
+            clEnqueueSVMUnmap(commandQueue, svmInput, 0, NULL, NULL);
+        }
+        clEnqueueNDRangeKernel(commandQueue, svmKernel, 1, NULL, globalWorkSize, NULL, 0, NULL, NULL);
+        if (!fineGrained) {
+            clEnqueueSVMMap(commandQueue, CL_TRUE, CL_MAP_READ, svmResult, svmOutputSize, 0, NULL, NULL);
         } else {
-            return double(data[data.size() / 2]);
+            clFinish(commandQueue);
         }
+        auto end_time = chrono::high_resolution_clock::now();
+        svmTimers.push_back(chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count());
+
+        // The result is mapped for reading, but the input is not mapped on the
+        // coarse-grained path: check against the host copy of the tuples
+        if (CHECK_RESULT) {
+            long wrongTuple = firstWrongTuple(input, svmOutput, numberOfTuples);
+            if (wrongTuple >= 0) {
+                cout << "SVM result is not correct for tuple: " << wrongTuple << endl;
+                valid = false;
+            }
+        }
+        if (!fineGrained) {
+            clEnqueueSVMUnmap(commandQueue, svmResult, 0, NULL, NULL);
+        }
+
+        start_time = chrono::high_resolution_clock::now();
+        writeBuffer();
+        if (runKernel() != CL_SUCCESS) {
+            return -1;
+        }
+        end_time = chrono::high_resolution_clock::now();
+        bufferTimers.push_back(chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count());
+        clReleaseEvent(writeEvent1);
+        clReleaseEvent(kernelEvent);
+        clReleaseEvent(readEvent1);
     }
+    clFinish(commandQueue);
+
+    double medianSvm = median(svmTimers);
+    double medianBuffer = median(bufferTimers);
+    cout << "SVM mode: " << (fineGrained ? "fine-grained buffer" : "coarse-grained buffer") << endl;
+    cout << "Median SVM TotalTime: " << medianSvm << " (ns)" << endl;
+    cout << "Median Buffer TotalTime: " << medianBuffer << " (ns)" << endl;
+    cout << "SVM speedup: " << (medianSvm > 0 ? medianBuffer / medianSvm : 0) << "x" << endl;
+    cout << (valid ? "SVM result is correct" : "SVM result is not correct") << endl;
+    cout << "\n";
+
+    clReleaseKernel(svmKernel);
+    clSVMFree(context, svmInput);
+    clSVMFree(context, svmResult);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Batch descriptor shared with computeNesMapPersistent (persistent.cl)
+enum SlotState {
+    SLOT_EMPTY = 0,
+    SLOT_READY = 1,
+    SLOT_DONE = 2
+};
+
+struct PersistentDescriptor {
+    atomic<cl_int> state;
+    cl_int tuples;
+};
+
+// Spins until the slot reaches the given state. Returns false on timeout.
+bool waitForSlot(PersistentDescriptor &descriptor, cl_int state) {
+    auto start_time = chrono::high_resolution_clock::now();
+    while (descriptor.state.load(memory_order_acquire) != state) {
+        if (chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start_time).count() > PERSISTENT_TIMEOUT_NS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compares the latency of a batch handed to a running persistent kernel with
+// the latency of a batch that is written, launched and read back. One batch is
+// in flight at a time, so the latency does not include any queueing.
+int runPersistentBenchmark(cl_device_svm_capabilities capabilities) {
+    cl_int status;
+    if (!(capabilities & CL_DEVICE_SVM_FINE_GRAIN_BUFFER) || !(capabilities & CL_DEVICE_SVM_ATOMICS)) {
+        cout << "[WARNING] The persistent kernel needs fine-grained SVM buffers with atomics" << endl;
+        return CL_SUCCESS;
+    }
+    static_assert(sizeof(atomic<cl_int>) == sizeof(cl_int), "atomic<cl_int> must match atomic_int");
+
+    char *persistentSource = readsource("persistent.cl");
+    const char *persistentSources[] = {tupleMapSource, persistentSource};
+    cl_program persistentProgram = clCreateProgramWithSource(context, 2, persistentSources, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateProgramWithSource" << endl;
+        return status;
+    }
+    status = clBuildProgram(persistentProgram, 1, devices, "-cl-std=CL2.0", NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clBuildProgram, persistent.cl" << endl;
+        printBuildLog(persistentProgram, devices[0]);
+        return status;
+    }
+    cl_kernel persistentKernel = clCreateKernel(persistentProgram, "computeNesMapPersistent", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, computeNesMapPersistent kernel" << endl;
+        return status;
+    }
+
+    cl_svm_mem_flags flags = CL_MEM_READ_WRITE | CL_MEM_SVM_FINE_GRAIN_BUFFER;
+    cl_ulong inputSlotSize = roundUp(tupleBufferSize(numberOfTuples, sizeof(InputRecord)), TUPLE_BUFFER_ALIGNMENT);
+    cl_ulong resultSlotSize = roundUp(tupleBufferSize(numberOfTuples, sizeof(OutputRecord)), TUPLE_BUFFER_ALIGNMENT);
+    PersistentDescriptor *ring = (PersistentDescriptor *) clSVMAlloc(context, flags | CL_MEM_SVM_ATOMICS, sizeof(PersistentDescriptor) * PERSISTENT_RING_SIZE, 0);
+    atomic<cl_int> *shutdown = (atomic<cl_int> *) clSVMAlloc(context, flags | CL_MEM_SVM_ATOMICS, sizeof(atomic<cl_int>), 0);
+    char *inputSlots = (char *) clSVMAlloc(context, flags, inputSlotSize * PERSISTENT_RING_SIZE, TUPLE_BUFFER_ALIGNMENT);
+    char *resultSlots = (char *) clSVMAlloc(context, flags, resultSlotSize * PERSISTENT_RING_SIZE, TUPLE_BUFFER_ALIGNMENT);
+    if (ring == NULL || shutdown == NULL || inputSlots == NULL || resultSlots == NULL) {
+        cout << "Error in clSVMAlloc" << endl;
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+    for (int s = 0; s < PERSISTENT_RING_SIZE; s++) {
+        ring[s].state.store(SLOT_EMPTY);
+        ring[s].tuples = 0;
+        writeTupleBufferHeader(inputSlots + s * inputSlotSize, numberOfTuples, sizeof(InputRecord), INPUT_RECORD_SCHEMA);
+        writeTupleBufferHeader(resultSlots + s * resultSlotSize, numberOfTuples, sizeof(OutputRecord), OUTPUT_RECORD_SCHEMA);
+    }
+    shutdown->store(0);
+
+    cl_int ringSize = PERSISTENT_RING_SIZE;
+    status = clSetKernelArgSVMPointer(persistentKernel, 0, ring);
+    status |= clSetKernelArg(persistentKernel, 1, sizeof(cl_int), &ringSize);
+    status |= clSetKernelArgSVMPointer(persistentKernel, 2, inputSlots);
+    status |= clSetKernelArgSVMPointer(persistentKernel, 3, resultSlots);
+    status |= clSetKernelArg(persistentKernel, 4, sizeof(cl_ulong), &inputSlotSize);
+    status |= clSetKernelArg(persistentKernel, 5, sizeof(cl_ulong), &resultSlotSize);
+    status |= clSetKernelArgSVMPointer(persistentKernel, 6, shutdown);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, computeNesMapPersistent kernel" << endl;
+        return status;
+    }
+
+    // A single work-group: work-groups are not guaranteed to run concurrently,
+    // so a larger launch could wait forever on a batch owned by a stalled group
+    size_t maxWorkGroupSize = PERSISTENT_WORK_GROUP_SIZE;
+    clGetKernelWorkGroupInfo(persistentKernel, devices[0], CL_KERNEL_WORK_GROUP_SIZE, sizeof(maxWorkGroupSize), &maxWorkGroupSize, NULL);
+    size_t workGroupSize[1] = {min((size_t) PERSISTENT_WORK_GROUP_SIZE, maxWorkGroupSize)};
+    status = clEnqueueNDRangeKernel(commandQueue, persistentKernel, 1, NULL, workGroupSize, workGroupSize, 0, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error launching the persistent kernel" << endl;
+        return status;
+    }
+    clFlush(commandQueue);
+
+    vector<long> persistentTimers;
+    bool valid = true;
+    for (int b = 0; b < PERSISTENT_BATCHES && valid; b++) {
+        PersistentDescriptor &descriptor = ring[b % PERSISTENT_RING_SIZE];
+        InputRecord *slotInput = tupleData<InputRecord>(inputSlots + (b % PERSISTENT_RING_SIZE) * inputSlotSize);
+        OutputRecord *slotResult = tupleData<OutputRecord>(resultSlots + (b % PERSISTENT_RING_SIZE) * resultSlotSize);
+        fillBatch(slotInput, b, numberOfTuples);
+        descriptor.tuples = numberOfTuples;
+
+        auto start_time = chrono::high_resolution_clock::now();
+        descriptor.state.store(SLOT_READY, memory_order_release);
+        if (!waitForSlot(descriptor, SLOT_DONE)) {
+            cout << "Timeout waiting for batch " << b << " of the persistent kernel" << endl;
+            valid = false;
+            break;
+        }
+        auto end_time = chrono::high_resolution_clock::now();
+        persistentTimers.push_back(chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count());
+        if (CHECK_RESULT && !checkBatch(slotInput, slotResult, numberOfTuples)) {
+            cout << "Result of batch " << b << " of the persistent kernel is not correct" << endl;
+            valid = false;
+        }
+        descriptor.state.store(SLOT_EMPTY, memory_order_relaxed);
+    }
+    shutdown->store(1, memory_order_release);
+    clFinish(commandQueue);
+
+    // Baseline: write, launch and read back every batch
+    vector<long> launchTimers;
+    for (int b = 0; b < PERSISTENT_BATCHES && valid; b++) {
+        fillBatch(input, b, numberOfTuples);
+        auto start_time = chrono::high_resolution_clock::now();
+        writeBuffer();
+        if (runKernel() != CL_SUCCESS) {
+            return -1;
+        }
+        auto end_time = chrono::high_resolution_clock::now();
+        launchTimers.push_back(chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count());
+        clReleaseEvent(writeEvent1);
+        clReleaseEvent(kernelEvent);
+        clReleaseEvent(readEvent1);
+    }
+
+    double medianPersistent = median(persistentTimers);
+    double medianLaunch = median(launchTimers);
+    cout << "Persistent kernel: " << PERSISTENT_BATCHES << " batches of " << numberOfTuples << " tuples, ring of " << PERSISTENT_RING_SIZE << " slots" << endl;
+    cout << "Median Persistent BatchLatency: " << medianPersistent << " (ns)" << endl;
+    cout << "Median Launch BatchLatency: " << medianLaunch << " (ns)" << endl;
+    cout << "Persistent speedup: " << (medianPersistent > 0 ? medianLaunch / medianPersistent : 0) << "x" << endl;
+    cout << (valid ? "Persistent result is correct" : "Persistent result is not correct") << endl;
+    cout << "\n";
+
+    clReleaseKernel(persistentKernel);
+    clReleaseProgram(persistentProgram);
+    clSVMFree(context, ring);
+    clSVMFree(context, shutdown);
+    clSVMFree(context, inputSlots);
+    clSVMFree(context, resultSlots);
+    free(persistentSource);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// A/B benchmark of the generic kernel against the variant specialized for the
+// current number of tuples (NUMBER_OF_TUPLES)
+int benchmarkSpecialization() {
+    cl_int status;
+    map<string, string> constants;
+    constants["NUMBER_OF_TUPLES"] = to_string(numberOfTuples);
+    cl_kernel specialized = getSpecializedKernel(specializationCache, context, devices[0], 3, programSources, "", "computeNesMap", constants, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    return runSpecializationBenchmark(kernel, specialized, runKernel, kernelEvent, readEvent1, result, numberOfTuples, sameRecord);
+}
+
+// A/B benchmark of the map kernel of --kernel, e.g. one generated by kernelgen
+// from nes_map.schema, against the hand-written computeNesMap of mykernel.cl.
+// Both results are checked against referenceMap.
+int benchmarkGeneratedKernel() {
+    cl_int status;
+    const char *handWrittenFiles[] = {"tuplemap.cl", "mykernel.cl"};
+    char *handWrittenSources[2];
+    cl_program handWrittenProgram = buildProgramFromFiles(context, devices[0], 2, handWrittenFiles, longIndex ? "-DLONG_INDEX" : NULL, false, handWrittenSources, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel handWritten = clCreateKernel(handWrittenProgram, "computeNesMap", &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, hand-written computeNesMap kernel" << endl;
+        return status;
+    }
+
+    cl_kernel generated = kernel;
+    cl_kernel variants[] = {handWritten, generated};
+    const char *names[] = {"Hand-written", "Generated   "};
+    double medians[2];
+    bool valid[2];
+    for (int v = 0; v < 2; v++) {
+        kernel = variants[v];
+        vector<long> timers;
+        for (int i = 0; i < GENERATED_ITERATIONS && CL_SUCCESS == status; i++) {
+            kernelTime = 0;
+            for (size_t offset = 0; offset < (size_t) numberOfTuples && CL_SUCCESS == status; offset += chunkTuples) {
+                size_t count = min(chunkTuples, numberOfTuples - offset);
+                writeBuffer(offset, count);
+                status = runKernel(offset, count);
+                if (CL_SUCCESS == status) {
+                    clReleaseEvent(kernelEvent);
+                    clReleaseEvent(readEvent1);
+                }
+            }
+            timers.push_back(kernelTime);
+        }
+        if (CL_SUCCESS != status) {
+            break;
+        }
+        medians[v] = median(timers);
+        valid[v] = firstWrongTuple(input, result, numberOfTuples) < 0;
+    }
+    kernel = generated;
+    clReleaseKernel(handWritten);
+    clReleaseProgram(handWrittenProgram);
+    free(handWrittenSources[0]);
+    free(handWrittenSources[1]);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    for (int v = 0; v < 2; v++) {
+        cout << "Median KernelTime " << names[v] << ": " << medians[v] << " (ns)" << (valid[v] ? "" : " (result is not correct)") << endl;
+    }
+    cout << "Generated / hand-written kernel time: " << (medians[0] > 0 ? medians[1] / medians[0] : 0) << endl;
+    cout << "\n";
+    return (valid[0] && valid[1]) ? CL_SUCCESS : -1;
 }
 
 int main(int argc, char **argv) {
     if (argc > 2) {
         platformId = atoi(argv[1]);
-        elements = atoi(argv[2]);
+        elements = atol(argv[2]);
     } else {
-        cout << "Run: ./host-mxm <platformId> <elements>" << endl;
+        cout << "Run: ./host-mxm <platformId> <elements> [--csv <file>] [--kernel <file>] [--specialize] [--seed <n>] [--async <batches>] [--queues <n>] [--batched <batches>] [--ingest <batches>] [--producers <n>] [--svm] [--persistent] [--adaptive <batches>] [--slo-us <us>] [--kernel-report]" << endl;
+        return -1;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csvFile = argv[++i];
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            kernelFile = argv[++i];
+        } else if (strcmp(argv[i], "--specialize") == 0) {
+            specialize = true;
+        } else if (strcmp(argv[i], "--kernel-report") == 0) {
+            kernelReport = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--async") == 0 && i + 1 < argc) {
+            asyncBatches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--queues") == 0 && i + 1 < argc) {
+            numberOfQueues = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--batched") == 0 && i + 1 < argc) {
+            packedBatches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ingest") == 0 && i + 1 < argc) {
+            ingestBatches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--producers") == 0 && i + 1 < argc) {
+            ingestProducers = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--adaptive") == 0 && i + 1 < argc) {
+            adaptiveBatches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--slo-us") == 0 && i + 1 < argc) {
+            latencyTarget = atof(argv[++i]) * 1e3;
+        } else if (strcmp(argv[i], "--svm") == 0) {
+            useSvm = true;
+        } else if (strcmp(argv[i], "--persistent") == 0) {
+            persistent = true;
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
+    // The batched and persistent kernels map the tuples with mapTuple
+    // (tuplemap.cl), the map of mykernel.cl, so they would not run the map of
+    // another kernel file
+    if (packedBatches > 0 && strcmp(kernelFile, "mykernel.cl") != 0) {
+        cout << "--batched runs the map of mykernel.cl and cannot be combined with --kernel" << endl;
+        return -1;
+    }
+    if (persistent && strcmp(kernelFile, "mykernel.cl") != 0) {
+        cout << "--persistent runs the map of mykernel.cl and cannot be combined with --kernel" << endl;
         return -1;
     }
 
@@ -355,12 +1933,41 @@ int main(int argc, char **argv) {
     vector<long> kernelTimers;
     vector<long> writeTimers;
     vector<long> readTimers;
+    vector<long> parseTimers;
     vector<double> totalTime;
 
     if (openclInitialization() != CL_SUCCESS) {
         return -1;
     }
-    hostDataInitialization(elements);
+    if (chunkTuples < (size_t) elements) {
+        cout << "Chunks of " << chunkTuples << " tuples (CL_DEVICE_MAX_MEM_ALLOC_SIZE = " << maxAllocationSize << " bytes)" << endl;
+    }
+    if ((specialize && !fitsOneLaunch("--specialize")) || (useSvm && !fitsOneLaunch("--svm")) || (persistent && !fitsOneLaunch("--persistent"))
+        || (asyncBatches > 0 && !fitsOneLaunch("--async")) || (ingestBatches > 0 && !fitsOneLaunch("--ingest"))
+        || (packedBatches > 0 && !fitsOneLaunch("--batched")) || (adaptiveBatches > 0 && !fitsOneLaunch("--adaptive"))) {
+        return -1;
+    }
+    if (asyncBatches > 0) {
+        int status = runAsyncComparison(elements, asyncBatches);
+        freeMemory();
+        return status == CL_SUCCESS ? 0 : -1;
+    }
+    if (ingestBatches > 0) {
+        int status = runIngestRing(elements, ingestBatches, ingestProducers);
+        freeMemory();
+        return status == CL_SUCCESS ? 0 : -1;
+    }
+    if (packedBatches > 0) {
+        int status = runBatchedQueries(elements, packedBatches);
+        freeMemory();
+        return status == CL_SUCCESS ? 0 : -1;
+    }
+    if (adaptiveBatches > 0) {
+        int status = runAdaptiveBatches(elements, adaptiveBatches);
+        freeMemory();
+        return status == CL_SUCCESS ? 0 : -1;
+    }
+    timeHostDataInitialization(hostDataInitialization, elements);
     if (allocateBuffersOnGPU() != CL_SUCCESS) {
         return -1;
     }
@@ -371,17 +1978,25 @@ int main(int argc, char **argv) {
         readTime = 0;
 
         auto start_time = chrono::high_resolution_clock::now();
-        writeBuffer();
-        if (runKernel() != CL_SUCCESS) {
-            return -1;
+        for (size_t offset = 0; offset < (size_t) numberOfTuples; offset += chunkTuples) {
+            size_t count = min(chunkTuples, numberOfTuples - offset);
+            writeBuffer(offset, count);
+            if (runKernel(offset, count) != CL_SUCCESS) {
+                return -1;
+            }
+            writeTime += getTime(writeEvent1);
+            readTime += getTime(readEvent1);
         }
         auto end_time = chrono::high_resolution_clock::now();
-        writeTime = getTime(writeEvent1);
-        writeTime += getTime(writeEvent2);
-        kernelTime = getTime(kernelEvent);
-        readTime = getTime(readEvent1);
+        parseTime = 0;
+        for (size_t e = 0; e < parseEvents.size(); e++) {
+            parseTime += getTime(parseEvents[e]);
+            clReleaseEvent(parseEvents[e]);
+        }
+        parseEvents.clear();
 
         kernelTimers.push_back(kernelTime);
+        parseTimers.push_back(parseTime);
         writeTimers.push_back(writeTime);
         readTimers.push_back(readTime);
 
@@ -391,6 +2006,10 @@ int main(int argc, char **argv) {
         // Print info ocl timers
         cout << "Iteration: " << i << endl;
         cout << "Write    : " << writeTime << endl;
+        if (csvFile != NULL) {
+            cout << "Parse    : " << parseTime << endl;
+            cout << "Tuples   : " << numberOfTuples << endl;
+        }
         cout << "X        : " << kernelTime << endl;
         cout << "Reading  : " << readTime << endl;
         cout << "C++ total: " << total << endl;
@@ -398,19 +2017,18 @@ int main(int argc, char **argv) {
 
         if (CHECK_RESULT) {
             bool valid = true;
-            for (int i = 0; i < 16; i++) {
-                if ((result[i].default_logical$new1 - input[i].default_logical$id*2) > 0.01f) {
-                    cout << result[i].default_logical$new1 << "  != " << (input[i].default_logical$id*2) << " for tuple: " << i << endl;
+            if (csvFile != NULL) {
+                int expectedTuples = parseRecordsOnHost(csvText, textSize, input);
+                if (expectedTuples != numberOfTuples) {
+                    cout << numberOfTuples << " tuples parsed != " << expectedTuples << endl;
                     valid = false;
-                    break;
-                }
-
-                if ((result[i].default_logical$new2 - (input[i].default_logical$id+2)) > 0.01f) {
-                    cout << result[i].default_logical$new2 << "  != " << (input[i].default_logical$id+2) << " for tuple: " << i << endl;
-                    valid = false;
-                    break;
                 }
             }
+            long wrongTuple = firstWrongTuple(input, result, numberOfTuples);
+            if (wrongTuple >= 0) {
+                cout << "Tuple " << wrongTuple << " does not match the reference map" << endl;
+                valid = false;
+            }
 
             if (valid) {
                 cout << "Result is correct" << endl;
@@ -421,16 +2039,47 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (specialize && benchmarkSpecialization() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (strcmp(kernelFile, "mykernel.cl") != 0 && benchmarkGeneratedKernel() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (useSvm) {
+        cl_device_svm_capabilities capabilities = svmCapabilities();
+        if (capabilities == 0) {
+            cout << "[WARNING] SVM is not supported by the device, using the buffer path only" << endl;
+        } else if (csvFile != NULL) {
+            cout << "[WARNING] The SVM path does not support --csv" << endl;
+        } else if (runSvmBenchmark(capabilities) != CL_SUCCESS) {
+            return -1;
+        }
+    }
+
+    if (persistent) {
+        if (csvFile != NULL) {
+            cout << "[WARNING] The persistent kernel does not support --csv" << endl;
+        } else if (runPersistentBenchmark(svmCapabilities()) != CL_SUCCESS) {
+            return -1;
+        }
+    }
+
     freeMemory();
 
     // Compute median
     double medianKernel = median(kernelTimers);
     double medianWrite = median(writeTimers);
     double medianRead = median(readTimers);
+    double medianParse = median(parseTimers);
     double medianTotalTime = median(totalTime);
 
     cout << "Median KernelTime: " << medianKernel << " (ns)" << endl;
     cout << "Median CopyInTime: " << medianWrite << " (ns)" << endl;
+    if (csvFile != NULL) {
+        cout << "Median ParseTime: " << medianParse << " (ns)" << endl;
+    }
     cout << "Median CopyOutTime: " << medianRead << " (ns)" << endl;
     cout << "Median TotalTime: " << medianTotalTime << " (ns)" << endl;
 
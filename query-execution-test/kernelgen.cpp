@@ -0,0 +1,469 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Generates a specialized NES map kernel from a schema description.
+ *
+ * Schema file format (one statement per line, '#' starts a comment):
+ *
+ *   kernel computeNesMap
+ *   input  default_logical$id:uint32 default_logical$value:uint32
+ *   output default_logical$id:uint32 default_logical$value:uint32 default_logical$new1:int32 default_logical$new2:int32
+ *   map    default_logical$new1 = default_logical$id * 2
+ *   map    default_logical$new2 = default_logical$id + 2
+ *
+ * Output fields without a map expression are copied from the input field with
+ * the same name. Map expressions may use input fields, literals and any operator
+ * or function that is valid in both OpenCL C and C.
+ *
+ * Run: ./kernelgen <schema> <output prefix>
+ * It writes <prefix>.cl (the kernel) and <prefix>.h (the packed host records
+ * and a sequential reference implementation).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+using namespace std;
+
+// Signed and unsigned integers of the same width share a vector type, as in
+// the TornadoVM-generated kernels (int4 for uint32/int32 records).
+struct FieldType {
+    const char *name;
+    const char *clType;
+    const char *hostType;
+    const char *vectorType;
+    int size;
+};
+
+const FieldType FIELD_TYPES[] = {
+    {"int8", "char", "int8_t", "char", 1},
+    {"uint8", "uchar", "uint8_t", "char", 1},
+    {"int16", "short", "int16_t", "short", 2},
+    {"uint16", "ushort", "uint16_t", "short", 2},
+    {"int32", "int", "int32_t", "int", 4},
+    {"uint32", "uint", "uint32_t", "int", 4},
+    {"int64", "long", "int64_t", "long", 8},
+    {"uint64", "ulong", "uint64_t", "long", 8},
+    {"float32", "float", "float", "float", 4},
+    {"float64", "double", "double", "double", 8},
+};
+const int NUMBER_OF_FIELD_TYPES = sizeof(FIELD_TYPES) / sizeof(FIELD_TYPES[0]);
+
+struct Field {
+    string name;
+    const FieldType *type;
+    int offset;
+};
+
+struct Schema {
+    string kernelName;
+    vector<Field> input;
+    vector<Field> output;
+    map<string, string> expressions;
+    int inputSize;
+    int outputSize;
+};
+
+const FieldType *findFieldType(const string &name) {
+    for (int i = 0; i < NUMBER_OF_FIELD_TYPES; i++) {
+        if (name == FIELD_TYPES[i].name) {
+            return &FIELD_TYPES[i];
+        }
+    }
+    return NULL;
+}
+
+int findField(const vector<Field> &fields, const string &name) {
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (fields[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool parseFields(istringstream &line, vector<Field> &fields, int &recordSize) {
+    string token;
+    recordSize = 0;
+    while (line >> token) {
+        size_t colon = token.find(':');
+        if (colon == string::npos) {
+            cout << "Missing type for field: " << token << endl;
+            return false;
+        }
+        Field field;
+        field.name = token.substr(0, colon);
+        field.type = findFieldType(token.substr(colon + 1));
+        if (field.type == NULL) {
+            cout << "Unknown type for field: " << token << endl;
+            return false;
+        }
+        // Records are packed, as in the host structs
+        field.offset = recordSize;
+        recordSize += field.type->size;
+        fields.push_back(field);
+    }
+    return !fields.empty();
+}
+
+bool readSchema(const char *fileName, Schema &schema) {
+    ifstream file(fileName);
+    if (!file) {
+        cout << "Could not open schema file: " << fileName << endl;
+        return false;
+    }
+    schema.kernelName = "computeNesMap";
+    string text;
+    int lineNumber = 0;
+    while (getline(file, text)) {
+        lineNumber++;
+        size_t comment = text.find('#');
+        if (comment != string::npos) {
+            text = text.substr(0, comment);
+        }
+        istringstream line(text);
+        string keyword;
+        if (!(line >> keyword)) {
+            continue;
+        }
+        if (keyword == "kernel") {
+            line >> schema.kernelName;
+        } else if (keyword == "input") {
+            if (!parseFields(line, schema.input, schema.inputSize)) {
+                cout << "Invalid input record at line " << lineNumber << endl;
+                return false;
+            }
+        } else if (keyword == "output") {
+            if (!parseFields(line, schema.output, schema.outputSize)) {
+                cout << "Invalid output record at line " << lineNumber << endl;
+                return false;
+            }
+        } else if (keyword == "map") {
+            string name, equals, expression;
+            line >> name >> equals;
+            getline(line, expression);
+            size_t first = expression.find_first_not_of(" \t");
+            expression = (first == string::npos) ? "" : expression.substr(first);
+            if (equals != "=" || expression.empty()) {
+                cout << "Invalid map expression at line " << lineNumber << endl;
+                return false;
+            }
+            schema.expressions[name] = expression;
+        } else {
+            cout << "Unknown statement '" << keyword << "' at line " << lineNumber << endl;
+            return false;
+        }
+    }
+
+    if (schema.input.empty() || schema.output.empty()) {
+        cout << "The schema needs an input and an output record" << endl;
+        return false;
+    }
+    for (size_t i = 0; i < schema.output.size(); i++) {
+        const Field &field = schema.output[i];
+        if (schema.expressions.count(field.name) == 0 && findField(schema.input, field.name) < 0) {
+            cout << "Output field " << field.name << " has no map expression and no input field" << endl;
+            return false;
+        }
+    }
+    for (map<string, string>::iterator it = schema.expressions.begin(); it != schema.expressions.end(); ++it) {
+        if (findField(schema.output, it->first) < 0) {
+            cout << "Map expression for unknown output field " << it->first << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Replaces every input field name in the expression with the kernel variable
+// that holds the field, in_<field index> (kernel), or with the field access
+// (reference implementation).
+string rewriteExpression(const string &expression, const Schema &schema, bool kernel) {
+    string rewritten;
+    size_t i = 0;
+    while (i < expression.size()) {
+        char c = expression[i];
+        if (isalpha(c) || c == '_') {
+            size_t start = i;
+            while (i < expression.size() && (isalnum(expression[i]) || expression[i] == '_' || expression[i] == '$')) {
+                i++;
+            }
+            string identifier = expression.substr(start, i - start);
+            int field = findField(schema.input, identifier);
+            if (field < 0) {
+                rewritten += identifier;
+            } else if (kernel) {
+                ostringstream name;
+                name << "in_" << field;
+                rewritten += name.str();
+            } else {
+                rewritten += "input[i]." + identifier;
+            }
+        } else {
+            rewritten += c;
+            i++;
+        }
+    }
+    return rewritten;
+}
+
+int log2IfPowerOfTwo(int value) {
+    int shift = 0;
+    while ((1 << shift) < value) {
+        shift++;
+    }
+    return ((1 << shift) == value) ? shift : -1;
+}
+
+// Returns the vector width when every field has the same vector type and the
+// record maps onto a single OpenCL vload/vstore, 0 otherwise.
+int vectorWidth(const vector<Field> &fields) {
+    int n = fields.size();
+    for (size_t i = 1; i < fields.size(); i++) {
+        if (string(fields[i].type->vectorType) != fields[0].type->vectorType) {
+            return 0;
+        }
+    }
+    if (n == 2 || n == 3 || n == 4 || n == 8 || n == 16) {
+        return n;
+    }
+    return 0;
+}
+
+string component(int index) {
+    const char *digits = "0123456789abcdef";
+    return string(".s") + digits[index];
+}
+
+string recordAddress(const char *base, int recordSize) {
+    ostringstream address;
+    int shift = log2IfPowerOfTwo(recordSize);
+    if (shift >= 0) {
+        address << base << " + (((long) i) << " << shift << ")";
+    } else {
+        address << base << " + (((long) i) * " << recordSize << "L)";
+    }
+    return address.str();
+}
+
+// Scalar access to a packed field. The direct typed access needs the field to
+// be naturally aligned in every record, so both its offset and the record size
+// must be multiples of its size. Other fields are loaded and stored through
+// uchar vectors, which only require byte alignment.
+bool alignedField(const Field &field, int recordSize) {
+    int size = field.type->size;
+    return recordSize % size == 0 && field.offset % size == 0;
+}
+
+string loadField(const Field &field, int recordSize) {
+    ostringstream load;
+    int size = field.type->size;
+    if (alignedField(field, recordSize)) {
+        load << "*((__global " << field.type->clType << " *) (inputRecord + " << field.offset << "))";
+    } else {
+        load << "as_" << field.type->clType << "(vload" << size << "(0, (__global uchar *) (inputRecord + " << field.offset << ")))";
+    }
+    return load.str();
+}
+
+string storeField(const Field &field, int recordSize, const string &value) {
+    ostringstream store;
+    int size = field.type->size;
+    if (alignedField(field, recordSize)) {
+        store << "*((__global " << field.type->clType << " *) (resultRecord + " << field.offset << ")) = " << value << ";";
+    } else {
+        store << "vstore" << size << "(as_uchar" << size << "(" << value << "), 0, (__global uchar *) (resultRecord + " << field.offset << "));";
+    }
+    return store.str();
+}
+
+string outputValue(int index) {
+    ostringstream value;
+    value << "out_" << index;
+    return value.str();
+}
+
+void emitKernel(ostream &out, const Schema &schema, const char *schemaFile) {
+    out << "// Generated by kernelgen from " << schemaFile << ". Do not edit." << endl;
+    out << endl;
+    out << "// Building with -DNUMBER_OF_TUPLES=<n> specializes the kernel for one batch size" << endl;
+    out << "#ifdef NUMBER_OF_TUPLES" << endl;
+    out << "#define TUPLES NUMBER_OF_TUPLES" << endl;
+    out << "#else" << endl;
+    out << "#define TUPLES numberOfTuples" << endl;
+    out << "#endif" << endl;
+    out << endl;
+    out << "// Building with -DLONG_INDEX takes the tuple index and numberOfTuples as longs, for batches of more than INT_MAX tuples" << endl;
+    out << "#ifdef LONG_INDEX" << endl;
+    out << "#define INDEX long" << endl;
+    out << "#else" << endl;
+    out << "#define INDEX int" << endl;
+    out << "#endif" << endl;
+    out << endl;
+    out << "__kernel void " << schema.kernelName << "(__global uchar *inputTuples, __global uchar *resultTuples, __private INDEX numberOfTuples)" << endl;
+    out << "{" << endl;
+    out << "    // The first ulong of each buffer holds the byte offset of the first tuple" << endl;
+    out << "    ulong inputData = (ulong) inputTuples + *((__global ulong *) inputTuples);" << endl;
+    out << "    ulong resultData = (ulong) resultTuples + *((__global ulong *) resultTuples);" << endl;
+    out << endl;
+    out << "    for (INDEX i = get_global_id(0); i < TUPLES; i += get_global_size(0)) {" << endl;
+    out << "        ulong inputRecord = " << recordAddress("inputData", schema.inputSize) << ";" << endl;
+    out << "        ulong resultRecord = " << recordAddress("resultData", schema.outputSize) << ";" << endl;
+
+    int inputWidth = vectorWidth(schema.input);
+    if (inputWidth > 0) {
+        const char *type = schema.input[0].type->vectorType;
+        out << "        " << type << inputWidth << " record = vload" << inputWidth << "(0, (__global " << type << " *) inputRecord);" << endl;
+        for (int f = 0; f < inputWidth; f++) {
+            const char *fieldType = schema.input[f].type->clType;
+            out << "        " << fieldType << " in_" << f << " = (" << fieldType << ") record" << component(f) << ";" << endl;
+        }
+    } else {
+        for (size_t f = 0; f < schema.input.size(); f++) {
+            const Field &field = schema.input[f];
+            out << "        " << field.type->clType << " in_" << f << " = " << loadField(field, schema.inputSize) << ";" << endl;
+        }
+    }
+
+    for (size_t f = 0; f < schema.output.size(); f++) {
+        const Field &field = schema.output[f];
+        map<string, string>::const_iterator expression = schema.expressions.find(field.name);
+        out << "        " << field.type->clType << " out_" << f << " = ";
+        if (expression != schema.expressions.end()) {
+            out << "(" << field.type->clType << ") (" << rewriteExpression(expression->second, schema, true) << ");" << endl;
+        } else {
+            out << "(" << field.type->clType << ") in_" << findField(schema.input, field.name) << ";" << endl;
+        }
+    }
+
+    int outputWidth = vectorWidth(schema.output);
+    if (outputWidth > 0) {
+        const char *type = schema.output[0].type->vectorType;
+        out << "        vstore" << outputWidth << "((" << type << outputWidth << ")(";
+        for (int f = 0; f < outputWidth; f++) {
+            out << (f > 0 ? ", " : "") << "(" << type << ") " << outputValue(f);
+        }
+        out << "), 0, (__global " << type << " *) resultRecord);" << endl;
+    } else {
+        for (size_t f = 0; f < schema.output.size(); f++) {
+            out << "        " << storeField(schema.output[f], schema.outputSize, outputValue(f)) << endl;
+        }
+    }
+    out << "    }" << endl;
+    out << "}  //  kernel" << endl;
+}
+
+void emitStruct(ostream &out, const char *name, const vector<Field> &fields) {
+    out << "struct __attribute__((packed)) " << name << " {" << endl;
+    for (size_t f = 0; f < fields.size(); f++) {
+        out << "    " << fields[f].type->hostType << " " << fields[f].name << ";" << endl;
+    }
+    out << "};" << endl;
+}
+
+void emitHeader(ostream &out, const Schema &schema, const char *schemaFile, const string &guard) {
+    out << "// Generated by kernelgen from " << schemaFile << ". Do not edit." << endl;
+    out << "#ifndef " << guard << endl;
+    out << "#define " << guard << endl;
+    out << endl;
+    out << "#include <stdint.h>" << endl;
+    out << endl;
+    emitStruct(out, "InputRecord", schema.input);
+    emitStruct(out, "OutputRecord", schema.output);
+    out << endl;
+    out << "// Sequential reference implementation of " << schema.kernelName << endl;
+    out << "static inline void referenceMap(const InputRecord *input, OutputRecord *output, long numberOfTuples) {" << endl;
+    out << "    for (long i = 0; i < numberOfTuples; i++) {" << endl;
+    for (size_t f = 0; f < schema.output.size(); f++) {
+        const Field &field = schema.output[f];
+        map<string, string>::const_iterator expression = schema.expressions.find(field.name);
+        out << "        output[i]." << field.name << " = (" << field.type->hostType << ") (";
+        if (expression != schema.expressions.end()) {
+            out << rewriteExpression(expression->second, schema, false);
+        } else {
+            out << "input[i]." << field.name;
+        }
+        out << ");" << endl;
+    }
+    out << "    }" << endl;
+    out << "}" << endl;
+    out << endl;
+    out << "#endif" << endl;
+}
+
+string headerGuard(const string &prefix) {
+    string guard;
+    size_t slash = prefix.find_last_of('/');
+    string base = (slash == string::npos) ? prefix : prefix.substr(slash + 1);
+    for (size_t i = 0; i < base.size(); i++) {
+        guard += isalnum(base[i]) ? (char) toupper(base[i]) : '_';
+    }
+    return guard + "_H";
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        cout << "Run: ./kernelgen <schema> <output prefix>" << endl;
+        return -1;
+    }
+
+    Schema schema;
+    if (!readSchema(argv[1], schema)) {
+        return -1;
+    }
+
+    string prefix = argv[2];
+    string kernelFile = prefix + ".cl";
+    string headerFile = prefix + ".h";
+
+    ofstream kernel(kernelFile.c_str());
+    if (!kernel) {
+        cout << "Could not write kernel file: " << kernelFile << endl;
+        return -1;
+    }
+    emitKernel(kernel, schema, argv[1]);
+
+    ofstream header(headerFile.c_str());
+    if (!header) {
+        cout << "Could not write header file: " << headerFile << endl;
+        return -1;
+    }
+    emitHeader(header, schema, argv[1], headerGuard(prefix));
+
+    cout << "Input record : " << schema.input.size() << " fields, " << schema.inputSize << " bytes";
+    cout << (vectorWidth(schema.input) > 0 ? " (vector load)" : " (scalar loads)") << endl;
+    cout << "Output record: " << schema.output.size() << " fields, " << schema.outputSize << " bytes";
+    cout << (vectorWidth(schema.output) > 0 ? " (vector store)" : " (scalar stores)") << endl;
+    cout << "Generated " << kernelFile << " and " << headerFile << endl;
+    return 0;
+}
@@ -1,16 +1,35 @@
 #pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
-__kernel void computeNesMap(__global uchar *inputTuples, __global uchar *resultTuples, __private int numberOfTuples)
+
+// Building with -DNUMBER_OF_TUPLES=<n> specializes the kernel for one batch
+// size; the numberOfTuples argument is then ignored.
+#ifdef NUMBER_OF_TUPLES
+#define TUPLES NUMBER_OF_TUPLES
+#else
+#define TUPLES numberOfTuples
+#endif
+
+// Building with -DLONG_INDEX computes the tuple and int indices in 64 bits,
+// and takes numberOfTuples as a long, for batches of more than INT_MAX / 4
+// tuples.
+#ifdef LONG_INDEX
+#define INDEX long
+#else
+#define INDEX int
+#endif
+
+// mapTuple is defined in tuplemap.cl, which the host builds with this file
+__kernel void computeNesMap(__global uchar *inputTuples, __global uchar *resultTuples, __private INDEX numberOfTuples)
 {
     int2 v2i_12;
     int4 v4i_22;
     ulong ul_14, ul_15, ul_13, ul_11, ul_6, ul_7, ul_5, ul_19, ul_0, ul_1;
-    int i_25, i_24, i_23, i_28, i_27, i_26, i_16, i_21, i_20, i_8, i_4, i_3, i_2;
+    INDEX i_28, i_27, i_16, i_8, i_4, i_3, i_2;
     long l_17, l_18, l_9, l_10;
 
     // BLOCK 0
     ul_0  =  (ulong) inputTuples;
     ul_1  =  (ulong) resultTuples;
-    i_2  =  (ulong) numberOfTuples;
+    i_2  =  (ulong) TUPLES;
     i_3  =  get_global_id(0);
     // BLOCK 1 MERGES [0 2 ]
     i_4  =  i_3;
@@ -32,13 +51,7 @@ __kernel void computeNesMap(__global uchar *inputTuples, __global uchar *resultT
         l_17  =  (long) i_16;
         l_18  =  l_17 << 2;
         ul_19  =  ul_15 + l_18;
-        i_20  =  v2i_12.s0 << 1;
-        i_21  =  v2i_12.s0 + 2;
-        i_23  =  v2i_12.s0;
-        i_24  =  v2i_12.s1;
-        i_25  =  i_20;
-        i_26  =  i_21;
-        v4i_22  =  (int4)(i_23, i_24, i_25, i_26);
+        v4i_22  =  mapTuple(v2i_12);
         vstore4(v4i_22, 0, (__global int *) ul_19);
         i_27  =  get_global_size(0);
         i_28  =  i_27 + i_4;
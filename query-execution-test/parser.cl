@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Device-side parser for newline-delimited records of the form "<id>,<value>".
+// The pipeline is: markRecordEnds -> scanBlocks/addBlockOffsets (prefix sum of
+// the flags) -> compactRecordEnds -> parseRecords. The parsed tuples are written
+// into the payload of the input tuple buffer consumed by computeNesMap. The
+// header starts with the byte offset of the payload and the number of tuples.
+
+#define RECORD_DELIMITER '\n'
+#define FIELD_DELIMITER ','
+#define FIELDS_PER_RECORD 2
+
+// Flags the last byte of every non-empty record. Empty lines are not flagged and
+// a final record without a trailing delimiter is still flagged.
+__kernel void markRecordEnds(__global const uchar *text, const int textSize, __global int *flags)
+{
+    int i = get_global_id(0);
+    if (i < textSize) {
+        uchar c = text[i];
+        int isLast = (i == textSize - 1) || (text[i + 1] == RECORD_DELIMITER);
+        flags[i] = (c != RECORD_DELIMITER && isLast) ? 1 : 0;
+    }
+}
+
+// Inclusive scan of one work-group in local memory. The total of each block is
+// stored in blockSums so that the host can scan the block totals recursively.
+__kernel void scanBlocks(__global int *data, __global int *blockSums, const int n, __local int *scratch)
+{
+    int gid = get_global_id(0);
+    int lid = get_local_id(0);
+    int localSize = get_local_size(0);
+
+    scratch[lid] = (gid < n) ? data[gid] : 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (int offset = 1; offset < localSize; offset <<= 1) {
+        int value = (lid >= offset) ? scratch[lid - offset] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        scratch[lid] += value;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (gid < n) {
+        data[gid] = scratch[lid];
+    }
+    if (lid == localSize - 1) {
+        blockSums[get_group_id(0)] = scratch[lid];
+    }
+}
+
+// Adds the scanned total of all previous blocks to every element of a block.
+__kernel void addBlockOffsets(__global int *data, __global const int *blockSums, const int n)
+{
+    int gid = get_global_id(0);
+    int group = get_group_id(0);
+    if (group > 0 && gid < n) {
+        data[gid] += blockSums[group - 1];
+    }
+}
+
+// Turns the scanned flags into the list of record end positions. The scan value
+// at a flagged byte is the 1-based index of the record it terminates.
+__kernel void compactRecordEnds(__global const int *positions, const int textSize, __global int *recordEnds, __global int *numberOfRecords)
+{
+    int i = get_global_id(0);
+    if (i < textSize) {
+        int previous = (i > 0) ? positions[i - 1] : 0;
+        if (positions[i] != previous) {
+            recordEnds[previous] = i;
+        }
+        if (i == textSize - 1) {
+            *numberOfRecords = positions[i];
+        }
+    }
+}
+
+// One work-item per record: accumulates the decimal digits of each field and
+// stores the tuple with a single vstore2 at its packed position.
+__kernel void parseRecords(__global const uchar *text, __global const int *recordEnds, __global const int *numberOfRecords, __global uchar *inputTuples)
+{
+    int records = *numberOfRecords;
+    __global ulong *header = (__global ulong *) inputTuples;
+    __global uint *tuples = (__global uint *) (inputTuples + header[0]);
+    if (get_global_id(0) == 0) {
+        header[1] = records;
+    }
+
+    for (int r = get_global_id(0); r < records; r += get_global_size(0)) {
+        int begin = (r == 0) ? 0 : recordEnds[r - 1] + 1;
+        int end = recordEnds[r];
+        uint fields[FIELDS_PER_RECORD] = {0, 0};
+        int field = 0;
+        for (int i = begin; i <= end; i++) {
+            uchar c = text[i];
+            if (c >= '0' && c <= '9') {
+                fields[field] = fields[field] * 10 + (c - '0');
+            } else if (c == FIELD_DELIMITER && field < FIELDS_PER_RECORD - 1) {
+                field++;
+            }
+        }
+        vstore2((uint2)(fields[0], fields[1]), r, tuples);
+    }
+}
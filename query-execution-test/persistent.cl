@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Persistent variant of computeNesMap (OpenCL 2.0, fine-grained SVM with
+// atomics). A single work-group is launched once and polls a ring of batch
+// descriptors written by the host: the host fills the tuple buffer of a slot,
+// then publishes the slot as READY; the kernel processes it in place and marks
+// it DONE. The kernel returns once the host sets the shutdown flag.
+// The map itself is mapTuple (tuplemap.cl).
+
+#define SLOT_EMPTY 0
+#define SLOT_READY 1
+#define SLOT_DONE 2
+
+typedef struct {
+    atomic_int state;
+    int tuples;
+} BatchDescriptor;
+
+__kernel void computeNesMapPersistent(__global BatchDescriptor *ring, const int ringSize, __global uchar *inputSlots, __global uchar *resultSlots, const ulong inputSlotSize, const ulong resultSlotSize, __global atomic_int *shutdown)
+{
+    __local int tuples;
+    __local int stop;
+    int lid = get_local_id(0);
+
+    for (int slot = 0;; slot = (slot + 1) % ringSize) {
+        // Work-item 0 waits for the next batch and broadcasts it to the work-group
+        if (lid == 0) {
+            stop = 0;
+            tuples = -1;
+            while (tuples < 0) {
+                if (atomic_load_explicit(&ring[slot].state, memory_order_acquire, memory_scope_all_svm_devices) == SLOT_READY) {
+                    tuples = ring[slot].tuples;
+                } else if (atomic_load_explicit(shutdown, memory_order_acquire, memory_scope_all_svm_devices)) {
+                    tuples = 0;
+                    stop = 1;
+                }
+            }
+        }
+        work_group_barrier(CLK_LOCAL_MEM_FENCE);
+        if (stop) {
+            return;
+        }
+
+        __global uchar *inputTuples = inputSlots + slot * inputSlotSize;
+        __global uchar *resultTuples = resultSlots + slot * resultSlotSize;
+        __global const int *input = (__global const int *) (inputTuples + *((__global const ulong *) inputTuples));
+        __global int *result = (__global int *) (resultTuples + *((__global const ulong *) resultTuples));
+        for (int i = lid; i < tuples; i += get_local_size(0)) {
+            int2 tuple = vload2(i, input);
+            vstore4(mapTuple(tuple), i, result);
+        }
+
+        // Every result of the batch is visible before the slot is handed back
+        work_group_barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE, memory_scope_all_svm_devices);
+        if (lid == 0) {
+            atomic_store_explicit(&ring[slot].state, SLOT_DONE, memory_order_release, memory_scope_all_svm_devices);
+        }
+    }
+}
@@ -0,0 +1,612 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Roofline report of the kernels of this repository. The peak bandwidth and
+// the peak compute of the device are measured with STREAM-like and FMA
+// micro-benchmarks (roofline.cl). Every kernel declares the bytes it moves and
+// the FLOPs it executes, from which the achieved GB/s and GFLOP/s and the
+// arithmetic intensity are placed on that roofline. With --perf on Linux, the
+// perf_event counters of the process are read around the kernels running on
+// a CPU device.
+
+#include <iostream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#define CL_USE_DEPRECATED_OPENCL_2_0_APIS
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/peaks.h"
+
+using namespace std;
+
+int platformId = 0;
+const int LOCAL_WORK_SIZE = 256;
+const int ITERATIONS = 10;
+
+// Size of the tuple buffer header of the query kernel (see the header of
+// query-execution-test/host.cpp); the kernel only reads its first word
+const cl_ulong TUPLE_DATA_OFFSET = 64;
+
+// Hardware counters of the process (--perf), for CPU devices on Linux
+enum PerfCounter {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_REFERENCES, PERF_CACHE_MISSES, NUMBER_OF_PERF_COUNTERS};
+bool perfCounters = false;
+vector<int> perfDescriptors[NUMBER_OF_PERF_COUNTERS];
+
+int elements = 1 << 20;
+
+// Roofline of the device, in bytes/ns (GB/s) and FLOPs/ns (GFLOP/s)
+double peakBandwidth;
+double peakCompute;
+
+string platformName;
+cl_platform_id *platforms;
+cl_device_id *devices;
+cl_device_type deviceType;
+cl_context context;
+cl_command_queue commandQueue;
+cl_program program;
+char *source;
+
+int openclInitialization() {
+    cl_int status;
+    cl_uint numPlatforms = 0;
+
+    status = clGetPlatformIDs(0, NULL, &numPlatforms);
+
+    if (numPlatforms == 0) {
+        cout << "No platform detected" << endl;
+        return status;
+    }
+
+    platforms = (cl_platform_id *) malloc(numPlatforms * sizeof(cl_platform_id));
+    if (platforms == NULL) {
+        cout << "malloc platform_id failed" << endl;
+        return status;
+    }
+
+    status = clGetPlatformIDs(numPlatforms, platforms, NULL);
+    if (status != CL_SUCCESS) {
+        cout << "clGetPlatformIDs failed" << endl;
+        return status;
+    }
+
+    cout << numPlatforms << " has been detected" << endl;
+    for (int i = 0; i < numPlatforms; i++) {
+        char buf[10000];
+        cout << "Platform: " << i << endl;
+        status = clGetPlatformInfo(platforms[i], CL_PLATFORM_VENDOR, sizeof(buf), buf, NULL);
+        if (i == platformId) {
+            platformName += buf;
+        }
+        cout << "\tVendor: " << buf << endl;
+        status = clGetPlatformInfo(platforms[i], CL_PLATFORM_NAME, sizeof(buf), buf, NULL);
+        cout << "\tName  : " << buf << endl;
+    }
+
+    cl_uint numDevices = 0;
+    cl_platform_id platform = platforms[platformId];
+    std::cout << "Using platform: " << platformId << " --> " << platformName << std::endl;
+
+    status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 0, NULL, &numDevices);
+
+    if (status != CL_SUCCESS) {
+        cout << "[WARNING] Using CPU, no GPU available" << endl;
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 0, NULL, &numDevices);
+        devices = (cl_device_id *) malloc(numDevices * sizeof(cl_device_id));
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, numDevices, devices, NULL);
+    } else {
+        devices = (cl_device_id *) malloc(numDevices * sizeof(cl_device_id));
+        cout << "Using accelerator" << endl;
+        status = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, numDevices, devices, NULL);
+    }
+    char buf[1000];
+    clGetDeviceInfo(devices[0], CL_DEVICE_NAME, sizeof(buf), buf, NULL);
+    cout << "\tDEVICE NAME: " << buf << endl;
+    clGetDeviceInfo(devices[0], CL_DEVICE_TYPE, sizeof(deviceType), &deviceType, NULL);
+
+    context = clCreateContext(NULL, 1, devices, NULL, NULL, &status);
+    if (status != CL_SUCCESS) {
+        cout << "Error in clCreateContext" << endl;
+        return status;
+    }
+
+    commandQueue = clCreateCommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE, &status);
+    if (status != CL_SUCCESS || commandQueue == NULL) {
+        cout << "Error in clCreateCommandQueue" << endl;
+        return status;
+    }
+
+    // Build the micro-benchmarks
+    const char *sourceFile = "roofline.cl";
+    source = readsource(sourceFile);
+    program = clCreateProgramWithSource(context, 1, (const char **) &source, NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateProgramWithSource" << endl;
+        return status;
+    }
+    status = clBuildProgram(program, 1, devices, NULL, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clBuildProgram" << endl;
+        printBuildLog(program, devices[0]);
+        return status;
+    }
+    return status;
+}
+
+// Device buffer filled with a constant float. The kernels only need finite,
+// non-zero inputs (the KTM map divides by the sine of its lean angle).
+cl_mem createBuffer(size_t bytes, cl_int *status) {
+    cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, status);
+    if (CL_SUCCESS != *status) {
+        cout << "Error in clCreateBuffer, " << bytes << " bytes" << endl;
+        return NULL;
+    }
+    float pattern = 0.5f;
+    *status = clEnqueueFillBuffer(commandQueue, buffer, &pattern, sizeof(pattern), 0, bytes, 0, NULL, NULL);
+    if (CL_SUCCESS != *status) {
+        cout << "Error in clEnqueueFillBuffer" << endl;
+        return NULL;
+    }
+    return buffer;
+}
+
+#ifdef __linux__
+long perfEventOpen(struct perf_event_attr *attr, pid_t tid) {
+    return syscall(__NR_perf_event_open, attr, tid, -1, -1, 0);
+}
+#endif
+
+void closePerfCounters() {
+#ifdef __linux__
+    for (int c = 0; c < NUMBER_OF_PERF_COUNTERS; c++) {
+        for (size_t i = 0; i < perfDescriptors[c].size(); i++) {
+            close(perfDescriptors[c][i]);
+        }
+        perfDescriptors[c].clear();
+    }
+#endif
+}
+
+// Opens one counter per event and per thread of the process, as the CPU
+// runtimes execute the work-groups on their own worker threads. Only user
+// space is counted, which the default perf_event_paranoid level allows. The
+// counters are opened after a warm-up launch, once the worker threads exist.
+int openPerfCounters() {
+#ifdef __linux__
+    const cl_ulong configs[NUMBER_OF_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                        PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+    DIR *tasks = opendir("/proc/self/task");
+    if (tasks == NULL) {
+        cout << "Error opening /proc/self/task" << endl;
+        return -1;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(tasks)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        pid_t tid = atoi(entry->d_name);
+        for (int c = 0; c < NUMBER_OF_PERF_COUNTERS; c++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[c];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = perfEventOpen(&attr, tid);
+            if (fd < 0 && errno == ESRCH) {
+                // The thread exited in the meantime
+                break;
+            }
+            if (fd < 0) {
+                cout << "Error in perf_event_open: " << strerror(errno) << " (see /proc/sys/kernel/perf_event_paranoid)" << endl;
+                closedir(tasks);
+                closePerfCounters();
+                return -1;
+            }
+            perfDescriptors[c].push_back(fd);
+        }
+    }
+    closedir(tasks);
+    return 0;
+#else
+    cout << "perf_event counters are only available on Linux" << endl;
+    return -1;
+#endif
+}
+
+void startPerfCounters() {
+#ifdef __linux__
+    for (int c = 0; c < NUMBER_OF_PERF_COUNTERS; c++) {
+        for (size_t i = 0; i < perfDescriptors[c].size(); i++) {
+            ioctl(perfDescriptors[c][i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perfDescriptors[c][i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+// Stops the counters and sums them over the threads
+void stopPerfCounters(cl_ulong *counts) {
+    for (int c = 0; c < NUMBER_OF_PERF_COUNTERS; c++) {
+        counts[c] = 0;
+#ifdef __linux__
+        for (size_t i = 0; i < perfDescriptors[c].size(); i++) {
+            ioctl(perfDescriptors[c][i], PERF_EVENT_IOC_DISABLE, 0);
+            cl_ulong value = 0;
+            if (read(perfDescriptors[c][i], &value, sizeof(value)) == sizeof(value)) {
+                counts[c] += value;
+            }
+        }
+#endif
+    }
+}
+
+// Median kernel time of ITERATIONS launches after one warm-up launch, with the
+// perf_event counters of the process read over the timed launches
+double timeCountedKernel(cl_kernel kernel, size_t globalWorkSize, cl_ulong *counts, cl_int *status) {
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    *status = warmUpKernel(commandQueue, kernel, globalWorkSize, localWorkSize);
+    if (CL_SUCCESS != *status) {
+        return 0;
+    }
+    bool counting = openPerfCounters() == 0;
+    if (counting) {
+        startPerfCounters();
+    }
+    double time = medianKernelTime(commandQueue, kernel, globalWorkSize, localWorkSize, ITERATIONS, status);
+    if (counting) {
+        stopPerfCounters(counts);
+        closePerfCounters();
+    } else {
+        memset(counts, 0, sizeof(cl_ulong) * NUMBER_OF_PERF_COUNTERS);
+    }
+    return time;
+}
+
+// Places one kernel on the roofline. The bound is given by the arithmetic
+// intensity against the ridge point, and the efficiency is the fraction of
+// the peak of that bound (bandwidth or compute) the kernel achieves.
+void printAnalysis(const char *name, double kernelTime, double bytes, double flops, const cl_ulong *counts) {
+    double bandwidth = kernelTime > 0 ? bytes / kernelTime : 0;
+    double compute = kernelTime > 0 ? flops / kernelTime : 0;
+    double intensity = flops / bytes;
+    double attainable = min(peakCompute, intensity * peakBandwidth);
+    bool memoryBound = intensity < peakCompute / peakBandwidth;
+    double efficiency = memoryBound ? bandwidth / peakBandwidth : compute / peakCompute;
+
+    cout << name << ": Median KernelTime " << kernelTime << " (ns)"
+         << ", Bytes " << bytes << ", FLOPs " << flops << endl;
+    cout << "\tBandwidth " << bandwidth << " GB/s, Compute " << compute << " GFLOP/s"
+         << ", Intensity " << intensity << " FLOP/byte, Attainable " << attainable << " GFLOP/s" << endl;
+    cout << "\t" << (memoryBound ? "memory-bound" : "compute-bound") << ", " << efficiency * 100 << "% of the roofline" << endl;
+    if (counts != NULL && counts[PERF_CYCLES] > 0) {
+        cout << "\tIPC " << (double) counts[PERF_INSTRUCTIONS] / counts[PERF_CYCLES]
+             << ", Cache misses " << counts[PERF_CACHE_MISSES] / ITERATIONS << " per launch ("
+             << (counts[PERF_CACHE_REFERENCES] > 0 ? 100.0 * counts[PERF_CACHE_MISSES] / counts[PERF_CACHE_REFERENCES] : 0)
+             << "% of the references)" << endl;
+    }
+}
+
+// Peak bandwidth (best of the STREAM kernels) and peak compute (fmaPeak)
+int measureRoofline() {
+    cl_int status;
+    size_t vectors = elements / 4;
+    size_t bytes = 4 * sizeof(cl_float) * vectors;
+    cl_mem a = createBuffer(bytes, &status);
+    cl_mem b = createBuffer(bytes, &status);
+    cl_mem c = createBuffer(bytes, &status);
+    cl_mem fmaOutput = createBuffer(sizeof(cl_float) * FMA_WORK_ITEMS, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    const char *streamNames[] = {"streamCopy", "streamScale", "streamAdd", "streamTriad"};
+    const int streamArrays[] = {2, 2, 3, 3};
+    const int streamFlops[] = {0, 4, 4, 8};
+    float scalar = 3.0f;
+    double streamTimes[4];
+    for (int s = 0; s < 4; s++) {
+        cl_kernel stream = clCreateKernel(program, streamNames[s], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << streamNames[s] << " kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(stream, devices[0], streamNames[s], LOCAL_WORK_SIZE);
+        if (s == 0) {
+            status = clSetKernelArg(stream, 0, sizeof(cl_mem), &a);
+            status |= clSetKernelArg(stream, 1, sizeof(cl_mem), &c);
+        } else if (s == 1) {
+            status = clSetKernelArg(stream, 0, sizeof(cl_mem), &c);
+            status |= clSetKernelArg(stream, 1, sizeof(cl_mem), &b);
+            status |= clSetKernelArg(stream, 2, sizeof(cl_float), &scalar);
+        } else if (s == 2) {
+            status = clSetKernelArg(stream, 0, sizeof(cl_mem), &a);
+            status |= clSetKernelArg(stream, 1, sizeof(cl_mem), &b);
+            status |= clSetKernelArg(stream, 2, sizeof(cl_mem), &c);
+        } else {
+            status = clSetKernelArg(stream, 0, sizeof(cl_mem), &b);
+            status |= clSetKernelArg(stream, 1, sizeof(cl_mem), &c);
+            status |= clSetKernelArg(stream, 2, sizeof(cl_mem), &a);
+            status |= clSetKernelArg(stream, 3, sizeof(cl_float), &scalar);
+        }
+        if (CL_SUCCESS != status) {
+            cout << "Error in clSetKernelArg" << endl;
+            return status;
+        }
+        streamTimes[s] = timeKernel(commandQueue, stream, vectors, localWorkSize, ITERATIONS, &status);
+        clReleaseKernel(stream);
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        if (streamTimes[s] > 0) {
+            peakBandwidth = max(peakBandwidth, (double) streamArrays[s] * bytes / streamTimes[s]);
+        }
+    }
+
+    cl_kernel fmaKernel = createFmaPeakKernel(program, fmaOutput, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    checkLocalWorkSize(fmaKernel, devices[0], "fmaPeak", LOCAL_WORK_SIZE);
+    double fmaTime = timeKernel(commandQueue, fmaKernel, FMA_WORK_ITEMS, localWorkSize, ITERATIONS, &status);
+    clReleaseKernel(fmaKernel);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    peakCompute = fmaTime > 0 ? FMA_FLOPS / fmaTime : 0;
+    if (peakBandwidth == 0 || peakCompute == 0) {
+        cout << "Error measuring the roofline" << endl;
+        return -1;
+    }
+
+    cout << "Peak bandwidth: " << peakBandwidth << " GB/s" << endl;
+    cout << "Peak compute  : " << peakCompute << " GFLOP/s" << endl;
+    cout << "Ridge point   : " << peakCompute / peakBandwidth << " FLOP/byte" << endl;
+    cout << "\n";
+    for (int s = 0; s < 4; s++) {
+        printAnalysis(streamNames[s], streamTimes[s], (double) streamArrays[s] * bytes, (double) streamFlops[s] * vectors, NULL);
+    }
+    printAnalysis("fmaPeak", fmaTime, sizeof(cl_float) * FMA_WORK_ITEMS, FMA_FLOPS, NULL);
+    cout << "\n";
+
+    clReleaseMemObject(a);
+    clReleaseMemObject(b);
+    clReleaseMemObject(c);
+    clReleaseMemObject(fmaOutput);
+    return CL_SUCCESS;
+}
+
+// One kernel of the repository: its sources, the file of the kernel last, the
+// arguments it is launched with and the traffic and FLOPs it declares for one
+// launch
+struct KernelAnalysis {
+    const char *name;
+    vector<const char *> fileNames;
+    const char *kernelName;
+    vector<size_t> bufferSizes;
+    vector<cl_ulong> headers;   // tuple buffer header written to each buffer, 0 for none
+    cl_int scalar;              // last argument: size, number of elements or tuples
+    bool floatScalar;           // the last argument is a float (saxpy alpha)
+    size_t globalWorkSize;
+    double bytes;
+    double flops;
+};
+
+int analyzeKernel(const KernelAnalysis &analysis) {
+    cl_int status;
+    vector<char *> kernelSources(analysis.fileNames.size());
+    cl_program kernelProgram = buildProgramFromFiles(context, devices[0], analysis.fileNames.size(), (const char **) &analysis.fileNames[0], NULL, false, &kernelSources[0], &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel kernel = clCreateKernel(kernelProgram, analysis.kernelName, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateKernel, " << analysis.kernelName << " kernel" << endl;
+        return status;
+    }
+    checkLocalWorkSize(kernel, devices[0], analysis.kernelName, LOCAL_WORK_SIZE);
+
+    vector<cl_mem> buffers;
+    for (size_t i = 0; i < analysis.bufferSizes.size(); i++) {
+        buffers.push_back(createBuffer(analysis.bufferSizes[i], &status));
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+        if (analysis.headers[i] != 0) {
+            status = clEnqueueWriteBuffer(commandQueue, buffers[i], CL_TRUE, 0, sizeof(cl_ulong), &analysis.headers[i], 0, NULL, NULL);
+        }
+        status |= clSetKernelArg(kernel, i, sizeof(cl_mem), &buffers[i]);
+    }
+    float alpha = 2.0f;
+    if (analysis.floatScalar) {
+        status |= clSetKernelArg(kernel, buffers.size(), sizeof(cl_float), &alpha);
+    } else {
+        status |= clSetKernelArg(kernel, buffers.size(), sizeof(cl_int), &analysis.scalar);
+    }
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, " << analysis.kernelName << " kernel" << endl;
+        return status;
+    }
+
+    cl_ulong counts[NUMBER_OF_PERF_COUNTERS];
+    size_t localWorkSize[1] = {LOCAL_WORK_SIZE};
+    double kernelTime = perfCounters ? timeCountedKernel(kernel, analysis.globalWorkSize, counts, &status)
+                                     : timeKernel(commandQueue, kernel, analysis.globalWorkSize, localWorkSize, ITERATIONS, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    printAnalysis(analysis.name, kernelTime, analysis.bytes, analysis.flops, perfCounters ? counts : NULL);
+
+    for (size_t i = 0; i < buffers.size(); i++) {
+        clReleaseMemObject(buffers[i]);
+    }
+    clReleaseKernel(kernel);
+    clReleaseProgram(kernelProgram);
+    for (size_t i = 0; i < kernelSources.size(); i++) {
+        free(kernelSources[i]);
+    }
+    return CL_SUCCESS;
+}
+
+// The declared traffic is the compulsory one: every input read once and every
+// output written once. FLOPs count the arithmetic operations and the calls to
+// math built-ins of the kernel body.
+vector<KernelAnalysis> repositoryKernels() {
+    vector<KernelAnalysis> kernels;
+    double n = elements;
+
+    // c = alpha * a + b: 2 reads and 1 write, 1 fma
+    KernelAnalysis saxpy = {"saxpy", {"../saxpy/mykernel.cl"}, "saxpy"};
+    saxpy.bufferSizes.assign(3, sizeof(cl_float) * elements);
+    saxpy.headers.assign(3, 0);
+    saxpy.floatScalar = true;
+    saxpy.globalWorkSize = elements;
+    saxpy.bytes = 3 * sizeof(cl_float) * n;
+    saxpy.flops = 2 * n;
+    kernels.push_back(saxpy);
+
+    // C = A * B for a square A of about elements values: A and B read once,
+    // 1 fma per value of A
+    int size = max(LOCAL_WORK_SIZE, (int) sqrt(n) / LOCAL_WORK_SIZE * LOCAL_WORK_SIZE);
+    double values = (double) size * size;
+    KernelAnalysis mxm = {"matrixVectorMultiplication", {"../mxm/mykernel.cl"}, "matrixVectorMultiplication"};
+    mxm.bufferSizes.push_back(sizeof(cl_float) * size * size);
+    mxm.bufferSizes.push_back(sizeof(cl_float) * size);
+    mxm.bufferSizes.push_back(sizeof(cl_float) * size);
+    mxm.headers.assign(3, 0);
+    mxm.scalar = size;
+    mxm.floatScalar = false;
+    mxm.globalWorkSize = size;
+    mxm.bytes = sizeof(cl_float) * (values + 2.0 * size);
+    mxm.flops = 2 * values;
+    kernels.push_back(mxm);
+
+    // 16-byte CanData in, 12-byte AggregationInput out: cos, sin, 3 divisions
+    // and 2 multiplications per record
+    KernelAnalysis map = {"map (KTM)", {"../ktm-udf-example/map.cl"}, "map"};
+    map.bufferSizes.push_back(16 * (size_t) elements);
+    map.bufferSizes.push_back(12 * (size_t) elements);
+    map.headers.assign(2, 0);
+    map.scalar = elements;
+    map.floatScalar = false;
+    map.globalWorkSize = elements;
+    map.bytes = 28 * n;
+    map.flops = 7 * n;
+    kernels.push_back(map);
+
+    // 8-byte tuples in, 16-byte tuples out, integer arithmetic only. mapTuple
+    // is in tuplemap.cl.
+    KernelAnalysis query = {"computeNesMap", {"../query-execution-test/tuplemap.cl", "../query-execution-test/mykernel.cl"}, "computeNesMap"};
+    query.bufferSizes.push_back(TUPLE_DATA_OFFSET + 8 * (size_t) elements);
+    query.bufferSizes.push_back(TUPLE_DATA_OFFSET + 16 * (size_t) elements);
+    query.headers.assign(2, TUPLE_DATA_OFFSET);
+    query.scalar = elements;
+    query.floatScalar = false;
+    query.globalWorkSize = elements;
+    query.bytes = 24 * n;
+    query.flops = 0;
+    kernels.push_back(query);
+    return kernels;
+}
+
+void freeMemory() {
+    clReleaseProgram(program);
+    clReleaseCommandQueue(commandQueue);
+    clReleaseContext(context);
+    free(source);
+    free(platforms);
+    free(devices);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 2) {
+        platformId = atoi(argv[1]);
+        elements = atoi(argv[2]);
+    } else {
+        cout << "Run: ./host <platformId> <elements> [--perf]" << endl;
+        return -1;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--perf") == 0) {
+            perfCounters = true;
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
+    if (elements <= 0 || elements % (4 * LOCAL_WORK_SIZE) != 0) {
+        cout << "The number of elements must be a multiple of " << 4 * LOCAL_WORK_SIZE << endl;
+        return -1;
+    }
+
+    cout << "OpenCL Roofline " << endl;
+    cout << "Number of Elements = " << elements << endl;
+
+    if (openclInitialization() != CL_SUCCESS) {
+        return -1;
+    }
+    if (perfCounters && deviceType != CL_DEVICE_TYPE_CPU) {
+        cout << "[WARNING] --perf ignored, the perf_event counters only cover a CPU device" << endl;
+        perfCounters = false;
+    }
+
+    if (measureRoofline() != CL_SUCCESS) {
+        return -1;
+    }
+    vector<KernelAnalysis> kernels = repositoryKernels();
+    for (size_t k = 0; k < kernels.size(); k++) {
+        if (analyzeKernel(kernels[k]) != CL_SUCCESS) {
+            return -1;
+        }
+    }
+
+    freeMemory();
+    return 0;
+}
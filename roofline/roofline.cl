@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Micro-benchmarks that measure the roofline of the device: STREAM kernels
+// (copy, scale, add, triad) on float4 elements for the peak bandwidth and a
+// chain of fused multiply-adds for the peak compute.
+
+__kernel void streamCopy(__global const float4 *a, __global float4 *c)
+{
+    int i = get_global_id(0);
+    c[i] = a[i];
+}
+
+__kernel void streamScale(__global const float4 *c, __global float4 *b, const float scalar)
+{
+    int i = get_global_id(0);
+    b[i] = scalar * c[i];
+}
+
+__kernel void streamAdd(__global const float4 *a, __global const float4 *b, __global float4 *c)
+{
+    int i = get_global_id(0);
+    c[i] = a[i] + b[i];
+}
+
+__kernel void streamTriad(__global const float4 *b, __global const float4 *c, __global float4 *a, const float scalar)
+{
+    int i = get_global_id(0);
+    a[i] = b[i] + scalar * c[i];
+}
+
+// Eight independent chains per work-item hide the latency of the fma. With a
+// multiplier below one the values converge instead of overflowing, and the sum
+// is stored so that the compiler cannot remove the loop. Every iteration is
+// 8 chains x 4 lanes x 2 FLOPs.
+__kernel void fmaPeak(__global float *output, const int iterations, const float multiplier, const float addend)
+{
+    float seed = (float) get_global_id(0);
+    float4 x0 = (float4)(seed, seed + 1.0F, seed + 2.0F, seed + 3.0F);
+    float4 x1 = x0 + 4.0F;
+    float4 x2 = x0 + 8.0F;
+    float4 x3 = x0 + 12.0F;
+    float4 x4 = x0 + 16.0F;
+    float4 x5 = x0 + 20.0F;
+    float4 x6 = x0 + 24.0F;
+    float4 x7 = x0 + 28.0F;
+    for (int i = 0; i < iterations; i++) {
+        x0 = fma(x0, multiplier, addend);
+        x1 = fma(x1, multiplier, addend);
+        x2 = fma(x2, multiplier, addend);
+        x3 = fma(x3, multiplier, addend);
+        x4 = fma(x4, multiplier, addend);
+        x5 = fma(x5, multiplier, addend);
+        x6 = fma(x6, multiplier, addend);
+        x7 = fma(x7, multiplier, addend);
+    }
+    float4 sum = ((x0 + x1) + (x2 + x3)) + ((x4 + x5) + (x6 + x7));
+    output[get_global_id(0)] = sum.s0 + sum.s1 + sum.s2 + sum.s3;
+}
@@ -0,0 +1,208 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2022, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// BLAS level-1 kernels. The reductions (dot, nrm2, asum, iamax) run in two
+// passes: every work-group reduces a grid-stride slice of the input in local
+// memory to one partial, and a second launch with a single work-group
+// combines the partials. The work-group size must be a power of two. The
+// inputs are read with vload4; the n % 4 last elements are handled one by one.
+
+// Tree reduction of one value per work-item; returns the sum of the work-group
+float workGroupSum(float value, __local float *scratch)
+{
+    int lid = get_local_id(0);
+    scratch[lid] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+        if (lid < stride) {
+            scratch[lid] += scratch[lid + stride];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    return scratch[0];
+}
+
+void storePartial(float sum, __global float *partials, __local float *scratch)
+{
+    sum = workGroupSum(sum, scratch);
+    if (get_local_id(0) == 0) {
+        partials[get_group_id(0)] = sum;
+    }
+}
+
+__kernel void dotPartials(__global const float *x, __global const float *y, const int n, __global float *partials, __local float *scratch)
+{
+    int vectors = n / 4;
+    float4 sum4 = (float4)(0.0F);
+    for (int i = get_global_id(0); i < vectors; i += get_global_size(0)) {
+        sum4 = fma(vload4(i, x), vload4(i, y), sum4);
+    }
+    float sum = (sum4.s0 + sum4.s1) + (sum4.s2 + sum4.s3);
+    for (int i = vectors * 4 + get_global_id(0); i < n; i += get_global_size(0)) {
+        sum = fma(x[i], y[i], sum);
+    }
+    storePartial(sum, partials, scratch);
+}
+
+// Sum of squares, without the rescaling of the reference BLAS: the inputs must
+// stay far from the float overflow threshold
+__kernel void nrm2Partials(__global const float *x, const int n, __global float *partials, __local float *scratch)
+{
+    int vectors = n / 4;
+    float4 sum4 = (float4)(0.0F);
+    for (int i = get_global_id(0); i < vectors; i += get_global_size(0)) {
+        float4 value = vload4(i, x);
+        sum4 = fma(value, value, sum4);
+    }
+    float sum = (sum4.s0 + sum4.s1) + (sum4.s2 + sum4.s3);
+    for (int i = vectors * 4 + get_global_id(0); i < n; i += get_global_size(0)) {
+        sum = fma(x[i], x[i], sum);
+    }
+    storePartial(sum, partials, scratch);
+}
+
+__kernel void asumPartials(__global const float *x, const int n, __global float *partials, __local float *scratch)
+{
+    int vectors = n / 4;
+    float4 sum4 = (float4)(0.0F);
+    for (int i = get_global_id(0); i < vectors; i += get_global_size(0)) {
+        sum4 += fabs(vload4(i, x));
+    }
+    float sum = (sum4.s0 + sum4.s1) + (sum4.s2 + sum4.s3);
+    for (int i = vectors * 4 + get_global_id(0); i < n; i += get_global_size(0)) {
+        sum += fabs(x[i]);
+    }
+    storePartial(sum, partials, scratch);
+}
+
+// Second pass of dot, nrm2 and asum, with one work-group. nrm2 takes the
+// square root of the sum.
+__kernel void sumPartials(__global const float *partials, const int n, __global float *result, const int squareRoot, __local float *scratch)
+{
+    float sum = 0.0F;
+    for (int i = get_local_id(0); i < n; i += get_local_size(0)) {
+        sum += partials[i];
+    }
+    sum = workGroupSum(sum, scratch);
+    if (get_local_id(0) == 0) {
+        *result = squareRoot ? sqrt(sum) : sum;
+    }
+}
+
+// Keeps the larger magnitude, and the smaller index on ties, as BLAS returns
+// the first maximum. Indices are 0-based.
+void iamaxSelect(float *value, int *index, float otherValue, int otherIndex)
+{
+    if (otherValue > *value || (otherValue == *value && otherIndex < *index)) {
+        *value = otherValue;
+        *index = otherIndex;
+    }
+}
+
+void workGroupIamax(float *value, int *index, __local float *values, __local int *indices)
+{
+    int lid = get_local_id(0);
+    values[lid] = *value;
+    indices[lid] = *index;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (int stride = get_local_size(0) / 2; stride > 0; stride >>= 1) {
+        if (lid < stride) {
+            float reduced = values[lid];
+            int reducedIndex = indices[lid];
+            iamaxSelect(&reduced, &reducedIndex, values[lid + stride], indices[lid + stride]);
+            values[lid] = reduced;
+            indices[lid] = reducedIndex;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    *value = values[0];
+    *index = indices[0];
+}
+
+__kernel void iamaxPartials(__global const float *x, const int n, __global float *partialValues, __global int *partialIndices,
+                            __local float *values, __local int *indices)
+{
+    int vectors = n / 4;
+    float value = -1.0F;
+    int index = INT_MAX;
+    for (int i = get_global_id(0); i < vectors; i += get_global_size(0)) {
+        float4 magnitude = fabs(vload4(i, x));
+        iamaxSelect(&value, &index, magnitude.s0, 4 * i);
+        iamaxSelect(&value, &index, magnitude.s1, 4 * i + 1);
+        iamaxSelect(&value, &index, magnitude.s2, 4 * i + 2);
+        iamaxSelect(&value, &index, magnitude.s3, 4 * i + 3);
+    }
+    for (int i = vectors * 4 + get_global_id(0); i < n; i += get_global_size(0)) {
+        iamaxSelect(&value, &index, fabs(x[i]), i);
+    }
+    workGroupIamax(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        partialValues[get_group_id(0)] = value;
+        partialIndices[get_group_id(0)] = index;
+    }
+}
+
+__kernel void iamaxCombine(__global const float *partialValues, __global const int *partialIndices, const int n, __global int *result,
+                           __local float *values, __local int *indices)
+{
+    float value = -1.0F;
+    int index = INT_MAX;
+    for (int i = get_local_id(0); i < n; i += get_local_size(0)) {
+        iamaxSelect(&value, &index, partialValues[i], partialIndices[i]);
+    }
+    workGroupIamax(&value, &index, values, indices);
+    if (get_local_id(0) == 0) {
+        *result = index;
+    }
+}
+
+// x = alpha * x
+__kernel void scal(__global float *x, const float alpha, const int n)
+{
+    int vectors = n / 4;
+    for (int i = get_global_id(0); i < vectors; i += get_global_size(0)) {
+        vstore4(alpha * vload4(i, x), i, x);
+    }
+    for (int i = vectors * 4 + get_global_id(0); i < n; i += get_global_size(0)) {
+        x[i] = alpha * x[i];
+    }
+}
+
+// y = alpha * x + y for a batch of problems of n elements stored one after
+// the other. Dimension 1 selects the problem and one work-group works on it.
+__kernel void axpyBatched(__global const float *x, __global float *y, __global const float *alphas, const int n)
+{
+    int batch = get_global_id(1);
+    __global const float *batchX = x + (size_t) batch * n;
+    __global float *batchY = y + (size_t) batch * n;
+    float4 alpha = (float4)(alphas[batch]);
+    int vectors = n / 4;
+    for (int i = get_local_id(0); i < vectors; i += get_local_size(0)) {
+        vstore4(fma(alpha, vload4(i, batchX), vload4(i, batchY)), i, batchY);
+    }
+    for (int i = vectors * 4 + get_local_id(0); i < n; i += get_local_size(0)) {
+        batchY[i] = fma(alpha.s0, batchX[i], batchY[i]);
+    }
+}
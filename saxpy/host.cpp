@@ -28,10 +28,14 @@
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <chrono>
 #include <vector>
 #include <algorithm>
+#include <math.h>
+#include <map>
+#include <climits>
 
 using namespace std;
 
@@ -45,11 +49,55 @@ const bool CHECK_RESULT = true;
 #include <CL/cl.h>
 #endif
 
+#include "../common/kernelinfo.h"
+#include "../common/clutils.h"
+#include "../common/hostdata.h"
+#include "../common/specialize.h"
+#include "../common/storage.h"
+
 int platformId = 0;
 const int LOCAL_WORK_SIZE = 16;
 const int ITERATIONS = 1;
 
-int elements = 1024;
+// Seed of the input data (--seed <n>)
+cl_ulong seed = 42;
+
+// Reduced-precision storage compared with fp32 (--storage): the inputs are
+// stored as half, bfloat16 or int8 and widened to fp32 in storage.cl
+const char *STORAGE_KERNELS[] = {"saxpyHalf", "saxpyBf16", "saxpyInt8"};
+bool storage = false;
+
+// BLAS level-1 suite (--blas1): dot, nrm2, asum, iamax, scal and a batched
+// axpy (blas1.cl) on A and B, checked against the CPU and reported in GB/s
+const int BLAS1_WORK_GROUP_SIZE = 256;
+const int BLAS1_MAX_GROUPS = 256;
+const int BLAS1_BATCHES = 64;
+const int BLAS1_ITERATIONS = 10;
+const double BLAS1_TOLERANCE = 1e-4;
+bool blas1 = false;
+
+// A/B benchmark of the generic and the specialized kernel (--specialize)
+bool specialize = false;
+SpecializationCache specializationCache;
+
+// Resource report of the kernels of every program built (--kernel-report)
+bool kernelReport = false;
+
+// Concurrent execution of independent problems (--concurrent <problems> [--queues <n>])
+const int CONCURRENT_ITERATIONS = 5;
+int concurrentProblems = 0;
+int numberOfQueues = 4;
+
+long elements = 1024;
+
+// Datasets larger than one device allocation (CL_DEVICE_MAX_MEM_ALLOC_SIZE) are
+// processed in chunks that fit in one, and chunks of more work-items than
+// MAX_LAUNCH_ITEMS are split into launches with global offsets. mykernel.cl is
+// built with -DLONG_INDEX when an index within a chunk can exceed INT_MAX.
+const size_t MAX_LAUNCH_ITEMS = (size_t) 1 << 30;
+cl_ulong maxAllocationSize;
+size_t chunkElements;
+bool longIndex = false;
 
 float alpha;
 
@@ -82,65 +130,6 @@ long kernelTime;
 long writeTime;
 long readTime;
 
-long getTime(cl_event event) {
-    clWaitForEvents(1, &event);
-    cl_ulong time_start, time_end;
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(time_start), &time_start, NULL);
-    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
-    return (time_end - time_start);
-}
-
-char *readsource(const char *sourceFilename) {
-    FILE *fp;
-    int err;
-    int size;
-    char *source;
-
-    fp = fopen(sourceFilename, "rb");
-
-    if (fp == NULL) {
-        printf("Could not open kernel file: %s\n", sourceFilename);
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_END);
-
-    if (err != 0) {
-        printf("Error seeking to end of file\n");
-        exit(-1);
-
-    }
-    size = ftell(fp);
-
-    if (size < 0) {
-        printf("Error getting file position\n");
-        exit(-1);
-    }
-
-    err = fseek(fp, 0, SEEK_SET);
-    if (err != 0) {
-        printf("Error seeking to start of file\n");
-        exit(-1);
-
-    }
-
-    source = (char *) malloc(size + 1);
-
-    if (source == NULL) {
-        printf("Error allocating %d bytes for the program source\n", size + 1);
-        exit(-1);
-    }
-
-    err = fread(source, 1, size, fp);
-    if (err != size) {
-        printf("only read %d bytes\n", err);
-        exit(0);
-    }
-
-    source[size] = '\0';
-    return source;
-}
-
 int openclInitialization() {
     cl_int status;
     cl_uint numPlatforms = 0;
@@ -210,6 +199,10 @@ int openclInitialization() {
         return status;
     }
 
+    clGetDeviceInfo(devices[0], CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(maxAllocationSize), &maxAllocationSize, NULL);
+    chunkElements = min((cl_ulong) elements, maxAllocationSize / sizeof(float));
+    longIndex = chunkElements > INT_MAX;
+
     // Build from source
     const char *sourceFile = "mykernel.cl";
     source = readsource(sourceFile);
@@ -218,9 +211,10 @@ int openclInitialization() {
         cout << "Error in clCreateProgramWithSource" << endl;
         return status;
     }
-    status = clBuildProgram(program, numDevices, devices, NULL, NULL, NULL);
+    status = clBuildProgram(program, numDevices, devices, longIndex ? "-DLONG_INDEX" : NULL, NULL, NULL);
     if (CL_SUCCESS != status) {
         cout << "Error in clBuildProgram" << endl;
+        printBuildLog(program, devices[0]);
         return status;
     }
     kernel = clCreateKernel(program, "saxpy", &status);
@@ -228,72 +222,111 @@ int openclInitialization() {
         cout << "Error in clCreateKernel, saxpy kernel" << endl;
         return status;
     }
+    if (kernelReport) {
+        printProgramReport(program, devices[0], sourceFile);
+    }
 
     return status;
 }
 
-void hostDataInitialization(int elements) {
+void hostDataInitialization(long elements) {
     datasize = sizeof(float) * elements;
     alpha = 12.0f;
 
-    cl_mem ddA = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
-    cl_mem ddB = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
-    cl_mem ddC = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
-
-    A = (float *) clEnqueueMapBuffer(commandQueue, ddA, CL_TRUE, CL_MAP_WRITE, 0, datasize, 0, NULL, NULL, NULL);
-    B = (float *) clEnqueueMapBuffer(commandQueue, ddB, CL_TRUE, CL_MAP_WRITE, 0, datasize, 0, NULL, NULL, NULL);
-    C = (float *) clEnqueueMapBuffer(commandQueue, ddC, CL_TRUE, CL_MAP_READ, 0, datasize, 0, NULL, NULL, NULL);
+    // Pinned host memory is itself a buffer, so it is limited to one device
+    // allocation; larger datasets are kept in pageable memory
+    if (datasize <= maxAllocationSize) {
+        cl_mem ddA = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
+        cl_mem ddB = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
+        cl_mem ddC = clCreateBuffer(context, CL_MEM_ALLOC_HOST_PTR, datasize, NULL, NULL);
 
-    #pragma omp parallel for
-    for (int i = 0; i < elements; i++) {
-        A[i] = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-        B[i] = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+        A = (float *) clEnqueueMapBuffer(commandQueue, ddA, CL_TRUE, CL_MAP_WRITE, 0, datasize, 0, NULL, NULL, NULL);
+        B = (float *) clEnqueueMapBuffer(commandQueue, ddB, CL_TRUE, CL_MAP_WRITE, 0, datasize, 0, NULL, NULL, NULL);
+        C = (float *) clEnqueueMapBuffer(commandQueue, ddC, CL_TRUE, CL_MAP_READ, 0, datasize, 0, NULL, NULL, NULL);
+    } else {
+        A = (float *) malloc(datasize);
+        B = (float *) malloc(datasize);
+        C = (float *) malloc(datasize);
     }
+
+    generateInParallel(elements, [](long i) {
+        A[i] = randomFloat(seed, 2 * (cl_ulong) i);
+        B[i] = randomFloat(seed, 2 * (cl_ulong) i + 1);
+    });
 }
 
 int allocateBuffersOnGPU() {
     cl_int status;
-    d_A = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * sizeof(float), NULL, &status);
+    d_A = clCreateBuffer(context, CL_MEM_READ_WRITE, chunkElements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_A" << endl;
     }
-    d_B = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * sizeof(float), NULL, &status);
+    d_B = clCreateBuffer(context, CL_MEM_READ_WRITE, chunkElements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_B" << endl;
     }
-    d_C = clCreateBuffer(context, CL_MEM_READ_WRITE, elements * sizeof(float), NULL, &status);
+    d_C = clCreateBuffer(context, CL_MEM_READ_WRITE, chunkElements * sizeof(float), NULL, &status);
     if (CL_SUCCESS != status) {
         cout << "Error in clCreateBuffer for array d_C" << endl;
     }
     return status;
 }
 
-void writeBuffer() {
-    clEnqueueWriteBuffer(commandQueue, d_A, CL_TRUE, 0, elements * sizeof(float), A, 0, NULL, &writeEvent1);
-    clEnqueueWriteBuffer(commandQueue, d_B, CL_TRUE, 0, elements * sizeof(float), B, 0, NULL, &writeEvent2);
+// Writes the chunk [offset, offset + count) of A and B to the device buffers
+void writeBuffer(size_t offset, size_t count) {
+    clEnqueueWriteBuffer(commandQueue, d_A, CL_TRUE, 0, count * sizeof(float), A + offset, 0, NULL, &writeEvent1);
+    clEnqueueWriteBuffer(commandQueue, d_B, CL_TRUE, 0, count * sizeof(float), B + offset, 0, NULL, &writeEvent2);
     clFlush(commandQueue);
 }
 
-int runKernel() {
+// Runs saxpy on the chunk in the device buffers, in launches of at most
+// MAX_LAUNCH_ITEMS work-items, and reads it back to C + offset. The time of
+// every launch is added to kernelTime; kernelEvent is the last launch.
+int runKernel(size_t offset, size_t count) {
     cl_int status;
     status = clSetKernelArg(kernel, 0, sizeof(cl_mem), &d_A);
     status |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &d_B);
     status |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &d_C);
     status |= clSetKernelArg(kernel, 3, sizeof(cl_float), &alpha);
 
-    size_t globalWorkSize[1];
-    size_t localWorkSize[1];
+    vector<cl_event> launches;
+    for (size_t first = 0; first < count && CL_SUCCESS == status; first += MAX_LAUNCH_ITEMS) {
+        size_t globalWorkOffset[1] = {first};
+        size_t globalWorkSize[1] = {min(MAX_LAUNCH_ITEMS, count - first)};
+        status = clEnqueueNDRangeKernel(commandQueue, kernel, 1, globalWorkOffset, globalWorkSize, NULL, 0, NULL, &kernelEvent);
+        launches.push_back(kernelEvent);
+    }
+    if (CL_SUCCESS != status) {
+        cout << "Error in clEnqueueNDRangeKernel" << endl;
+        return status;
+    }
+    clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * count, C + offset, 0, NULL, &readEvent1);
+    for (size_t l = 0; l < launches.size(); l++) {
+        kernelTime += getTime(launches[l]);
+        if (l + 1 < launches.size()) {
+            clReleaseEvent(launches[l]);
+        }
+    }
 
-    globalWorkSize[0] = elements;
-    localWorkSize[0] = LOCAL_WORK_SIZE;
+    return status;
+}
 
-    clEnqueueNDRangeKernel(commandQueue, kernel, 1, NULL, globalWorkSize, NULL, 0, NULL, &kernelEvent);
-    clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * elements, C, 0, NULL, &readEvent1);
+int runKernel() {
+    return runKernel(0, elements);
+}
 
-    return status;
+// The benchmarks other than the main run take the whole dataset in one device
+// allocation and one launch, with int sizes
+bool fitsOneLaunch(const char *option) {
+    if ((size_t) elements > chunkElements || (size_t) elements > MAX_LAUNCH_ITEMS) {
+        cout << "Error: " << option << " needs at most " << min(chunkElements, MAX_LAUNCH_ITEMS) << " elements" << endl;
+        return false;
+    }
+    return true;
 }
 
 void freeMemory() {
+    releaseSpecializedKernels(specializationCache);
     clReleaseKernel(kernel);
     clReleaseProgram(program);
     clReleaseCommandQueue(commandQueue);
@@ -307,40 +340,498 @@ void freeMemory() {
     free(devices);
 }
 
-double median(vector<long> data) {
-    if (data.empty()) {
-        return 0;
+cl_command_queue createQueue(cl_command_queue_properties properties, cl_int *status) {
+    cl_command_queue queue = clCreateCommandQueue(context, devices[0], CL_QUEUE_PROFILING_ENABLE | properties, status);
+    if (*status != CL_SUCCESS || queue == NULL) {
+        cout << "Error in clCreateCommandQueue" << endl;
+    }
+    return queue;
+}
+
+// Enqueues every problem on the given queues (round-robin) and waits for all of
+// them. Each problem is chained write -> kernel -> read by events, which an
+// out-of-order queue needs and in-order queues ignore.
+double runProblems(const vector<cl_command_queue> &queues, const vector<cl_kernel> &problemKernels, const vector<cl_mem> &problemBuffers, float *problemResults) {
+    vector<cl_event> events;
+    size_t globalWorkSize[1];
+    globalWorkSize[0] = elements;
+
+    auto start_time = chrono::high_resolution_clock::now();
+    for (size_t p = 0; p < problemKernels.size(); p++) {
+        cl_command_queue queue = queues[p % queues.size()];
+        cl_event writes[2];
+        cl_event kernelDone;
+        cl_event readDone;
+        clEnqueueWriteBuffer(queue, problemBuffers[3 * p], CL_FALSE, 0, datasize, A, 0, NULL, &writes[0]);
+        clEnqueueWriteBuffer(queue, problemBuffers[3 * p + 1], CL_FALSE, 0, datasize, B, 0, NULL, &writes[1]);
+        clEnqueueNDRangeKernel(queue, problemKernels[p], 1, NULL, globalWorkSize, NULL, 2, writes, &kernelDone);
+        clEnqueueReadBuffer(queue, problemBuffers[3 * p + 2], CL_FALSE, 0, datasize, problemResults + p * elements, 1, &kernelDone, &readDone);
+        events.push_back(writes[0]);
+        events.push_back(writes[1]);
+        events.push_back(kernelDone);
+        events.push_back(readDone);
+    }
+    for (size_t q = 0; q < queues.size(); q++) {
+        clFlush(queues[q]);
+    }
+    for (size_t q = 0; q < queues.size(); q++) {
+        clFinish(queues[q]);
+    }
+    auto end_time = chrono::high_resolution_clock::now();
+
+    for (size_t e = 0; e < events.size(); e++) {
+        clReleaseEvent(events[e]);
+    }
+    return chrono::duration_cast<chrono::nanoseconds>(end_time - start_time).count();
+}
+
+// Runs concurrentProblems independent saxpy problems serialized on one in-order
+// queue, spread over a pool of in-order queues and on one out-of-order queue,
+// and reports the aggregate throughput of each configuration.
+int runConcurrent(int problems) {
+    cl_int status;
+    vector<cl_kernel> problemKernels;
+    vector<cl_mem> problemBuffers;
+    for (int p = 0; p < problems; p++) {
+        for (int b = 0; b < 3; b++) {
+            problemBuffers.push_back(clCreateBuffer(context, CL_MEM_READ_WRITE, datasize, NULL, &status));
+            if (CL_SUCCESS != status) {
+                cout << "Error in clCreateBuffer for problem " << p << endl;
+                return status;
+            }
+        }
+        cl_kernel problemKernel = clCreateKernel(program, "saxpy", &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, saxpy kernel" << endl;
+            return status;
+        }
+        status = clSetKernelArg(problemKernel, 0, sizeof(cl_mem), &problemBuffers[3 * p]);
+        status |= clSetKernelArg(problemKernel, 1, sizeof(cl_mem), &problemBuffers[3 * p + 1]);
+        status |= clSetKernelArg(problemKernel, 2, sizeof(cl_mem), &problemBuffers[3 * p + 2]);
+        status |= clSetKernelArg(problemKernel, 3, sizeof(cl_float), &alpha);
+        problemKernels.push_back(problemKernel);
+    }
+    float *problemResults = (float *) malloc(datasize * problems);
+
+    cl_command_queue_properties supported = 0;
+    clGetDeviceInfo(devices[0], CL_DEVICE_QUEUE_PROPERTIES, sizeof(supported), &supported, NULL);
+
+    vector<cl_command_queue> serialQueue(1, commandQueue);
+    vector<cl_command_queue> queuePool;
+    for (int q = 0; q < numberOfQueues; q++) {
+        queuePool.push_back(createQueue(0, &status));
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+    }
+    vector<cl_command_queue> outOfOrderQueue;
+    if (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+        outOfOrderQueue.push_back(createQueue(CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &status));
+        if (CL_SUCCESS != status) {
+            return status;
+        }
     } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
+        cout << "[WARNING] Out-of-order queues not supported by the device" << endl;
+    }
+
+    const char *names[] = {"In-order queue     ", "In-order queue pool", "Out-of-order queue "};
+    vector<cl_command_queue> *configurations[] = {&serialQueue, &queuePool, &outOfOrderQueue};
+    double serialTime = 0;
+    bool valid = true;
+
+    cout << "Concurrent saxpy: " << problems << " problems of " << elements << " elements, pool of " << numberOfQueues << " queues" << endl;
+    for (int c = 0; c < 3; c++) {
+        if (configurations[c]->empty()) {
+            continue;
+        }
+        vector<double> timers;
+        for (int i = 0; i < CONCURRENT_ITERATIONS; i++) {
+            memset(problemResults, 0, datasize * problems);
+            timers.push_back(runProblems(*configurations[c], problemKernels, problemBuffers, problemResults));
+            if (CHECK_RESULT) {
+                for (long e = 0; e < (long) problems * elements; e++) {
+                    int idx = e % elements;
+                    if (fabs(problemResults[e] - ((alpha * A[idx]) + B[idx])) > 0.01f) {
+                        valid = false;
+                        break;
+                    }
+                }
+            }
+        }
+        double time = median(timers);
+        if (c == 0) {
+            serialTime = time;
+        }
+        cout << names[c] << ": " << time << " (ns), " << ((double) problems * elements / (time * 1e-9)) << " elements/s";
+        cout << ", speedup " << (time > 0 ? serialTime / time : 0) << "x" << endl;
+    }
+    cout << (valid ? "Result is correct" : "Result is not correct") << endl;
+
+    for (size_t q = 0; q < queuePool.size(); q++) {
+        clReleaseCommandQueue(queuePool[q]);
+    }
+    for (size_t q = 0; q < outOfOrderQueue.size(); q++) {
+        clReleaseCommandQueue(outOfOrderQueue[q]);
+    }
+    for (size_t k = 0; k < problemKernels.size(); k++) {
+        clReleaseKernel(problemKernels[k]);
+    }
+    for (size_t b = 0; b < problemBuffers.size(); b++) {
+        clReleaseMemObject(problemBuffers[b]);
+    }
+    free(problemResults);
+    return valid ? CL_SUCCESS : -1;
+}
+
+// Runs saxpy on the same inputs stored as half, bf16 and int8, with the result
+// stored in the same format, and compares it with the fp32 kernel
+int runStorageBenchmark() {
+    cl_int status;
+    // The main kernel keeps the arguments of its last run
+    double fp32Time = timeStorageKernel(commandQueue, kernel, elements, NULL, &status);
+    vector<float> reference(elements);
+    status |= clEnqueueReadBuffer(commandQueue, d_C, CL_TRUE, 0, sizeof(float) * elements, &reference[0], 0, NULL, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error running the fp32 kernel" << endl;
+        return status;
+    }
+    printStorageResult("fp32", fp32Time, 3.0 * sizeof(float) * elements, fp32Time, 0, 0);
+
+    char *storageSource;
+    cl_program storageProgram = buildProgramFromFile(context, devices[0], "storage.cl", NULL, kernelReport, &storageSource, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    float scaleA;
+    float scaleB;
+    storageScales(A, elements, 1, &scaleA);
+    storageScales(B, elements, 1, &scaleB);
+    // Bound of |alpha * a + b|, so the int8 result does not saturate
+    float scaleC = fabsf(alpha) * scaleA + scaleB;
+    vector<float> values(elements);
+    for (int f = 0; f < NUMBER_OF_STORAGE_FORMATS; f++) {
+        vector<cl_uchar> a = encodeStorage(f, A, elements, &scaleA, 1);
+        vector<cl_uchar> b = encodeStorage(f, B, elements, &scaleB, 1);
+        vector<cl_uchar> c(elements * STORAGE_BYTES[f]);
+        cl_mem d_a = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, a.size(), &a[0], &status);
+        cl_mem d_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, b.size(), &b[0], &status);
+        cl_mem d_c = clCreateBuffer(context, CL_MEM_WRITE_ONLY, c.size(), NULL, &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateBuffer for the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+        cl_kernel storageKernel = clCreateKernel(storageProgram, STORAGE_KERNELS[f], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << STORAGE_KERNELS[f] << " kernel" << endl;
+            return status;
         }
+        status = clSetKernelArg(storageKernel, 0, sizeof(cl_mem), &d_a);
+        status |= clSetKernelArg(storageKernel, 1, sizeof(cl_mem), &d_b);
+        status |= clSetKernelArg(storageKernel, 2, sizeof(cl_mem), &d_c);
+        status |= clSetKernelArg(storageKernel, 3, sizeof(cl_float), &alpha);
+        if (f == STORAGE_INT8) {
+            status |= clSetKernelArg(storageKernel, 4, sizeof(cl_float), &scaleA);
+            status |= clSetKernelArg(storageKernel, 5, sizeof(cl_float), &scaleB);
+            status |= clSetKernelArg(storageKernel, 6, sizeof(cl_float), &scaleC);
+        }
+        double kernelTime = timeStorageKernel(commandQueue, storageKernel, elements, NULL, &status);
+        status |= clEnqueueReadBuffer(commandQueue, d_c, CL_TRUE, 0, c.size(), &c[0], 0, NULL, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error running the " << STORAGE_NAMES[f] << " storage variant" << endl;
+            return status;
+        }
+
+        decodeStorage(f, c, elements, &scaleC, 1, &values[0]);
+        double maxError;
+        double rmsError;
+        storageError(&reference[0], &values[0], elements, &maxError, &rmsError);
+        printStorageResult(STORAGE_NAMES[f], kernelTime, 3.0 * STORAGE_BYTES[f] * elements, fp32Time, maxError, rmsError);
+
+        clReleaseKernel(storageKernel);
+        clReleaseMemObject(d_a);
+        clReleaseMemObject(d_b);
+        clReleaseMemObject(d_c);
     }
+    cout << "\n";
+
+    clReleaseProgram(storageProgram);
+    free(storageSource);
+    return CL_SUCCESS;
 }
 
-double median(vector<double> data) {
-    if (data.empty()) {
+// Launches one BLAS level-1 kernel and returns its time on the device
+long launchBlas1Kernel(cl_kernel blasKernel, cl_uint dimensions, const size_t *globalWorkSize, const size_t *localWorkSize, cl_int *status) {
+    cl_event event;
+    *status = clEnqueueNDRangeKernel(commandQueue, blasKernel, dimensions, NULL, globalWorkSize, localWorkSize, 0, NULL, &event);
+    if (CL_SUCCESS != *status) {
+        cout << "Error in clEnqueueNDRangeKernel" << endl;
         return 0;
-    } else {
-        sort(data.begin(), data.end());
-        if (data.size() % 2 == 0) {
-            return (data[data.size() / 2 - 1] + data[data.size() / 2]) / 2;
-        } else {
-            return double(data[data.size() / 2]);
+    }
+    long time = getTime(event);
+    clReleaseEvent(event);
+    return time;
+}
+
+void printBlas1Result(const char *operation, double kernelTime, double bytes, bool valid) {
+    cout << "BLAS1 " << operation << ": Median KernelTime " << kernelTime << " (ns)"
+         << ", Bandwidth " << (kernelTime > 0 ? bytes / kernelTime : 0) << " GB/s"
+         << ", " << (valid ? "Result is correct" : "Result is not correct") << endl;
+}
+
+bool blas1CloseTo(double value, double reference) {
+    return fabs(value - reference) <= BLAS1_TOLERANCE * fabs(reference);
+}
+
+// Runs the BLAS level-1 kernels with x = A and y = B. The time of a reduction
+// is that of both passes; scal and axpy restore their output vector from the
+// host before every launch, outside of the timed region.
+int runBlas1Suite() {
+    enum {DOT, NRM2, ASUM, SUM, IAMAX, IAMAX_COMBINE, SCAL, AXPY_BATCHED, NUMBER_OF_BLAS1_KERNELS};
+    const char *kernelNames[] = {"dotPartials", "nrm2Partials", "asumPartials", "sumPartials", "iamaxPartials", "iamaxCombine", "scal", "axpyBatched"};
+    cl_int status;
+    char *blas1Source;
+    cl_program blas1Program = buildProgramFromFile(context, devices[0], "blas1.cl", NULL, kernelReport, &blas1Source, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+    cl_kernel kernels[NUMBER_OF_BLAS1_KERNELS];
+    for (int k = 0; k < NUMBER_OF_BLAS1_KERNELS; k++) {
+        kernels[k] = clCreateKernel(blas1Program, kernelNames[k], &status);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clCreateKernel, " << kernelNames[k] << " kernel" << endl;
+            return status;
+        }
+        checkLocalWorkSize(kernels[k], devices[0], kernelNames[k], BLAS1_WORK_GROUP_SIZE);
+    }
+
+    cl_int n = elements;
+    int groups = min(BLAS1_MAX_GROUPS, max(1, (n / 4 + BLAS1_WORK_GROUP_SIZE - 1) / BLAS1_WORK_GROUP_SIZE));
+    size_t globalWorkSize[2] = {(size_t) groups * BLAS1_WORK_GROUP_SIZE, 1};
+    size_t localWorkSize[2] = {BLAS1_WORK_GROUP_SIZE, 1};
+    size_t combineWorkSize[1] = {BLAS1_WORK_GROUP_SIZE};
+    cl_mem d_x = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, datasize, A, &status);
+    cl_mem d_y = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, datasize, B, &status);
+    cl_mem d_partials = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float) * groups, NULL, &status);
+    cl_mem d_partialIndices = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int) * groups, NULL, &status);
+    cl_mem d_result = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_float), NULL, &status);
+    cl_mem d_index = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_int), NULL, &status);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clCreateBuffer for the BLAS1 suite" << endl;
+        return status;
+    }
+
+    // CPU references, accumulated in double
+    double dot = 0;
+    double squares = 0;
+    double asum = 0;
+    #pragma omp parallel for schedule(static) reduction(+:dot, squares, asum)
+    for (int i = 0; i < elements; i++) {
+        dot += (double) A[i] * B[i];
+        squares += (double) A[i] * A[i];
+        asum += fabs(A[i]);
+    }
+    int iamax = 0;
+    for (int i = 1; i < elements; i++) {
+        if (fabsf(A[i]) > fabsf(A[iamax])) {
+            iamax = i;
+        }
+    }
+
+    // dot, nrm2 and asum: partials of every work-group, then one work-group
+    const int reductions[] = {DOT, NRM2, ASUM};
+    const char *reductionNames[] = {"dot", "nrm2", "asum"};
+    const double references[] = {dot, sqrt(squares), asum};
+    for (int r = 0; r < 3; r++) {
+        cl_kernel partialKernel = kernels[reductions[r]];
+        int argument = 0;
+        cl_int squareRoot = reductions[r] == NRM2;
+        status = clSetKernelArg(partialKernel, argument++, sizeof(cl_mem), &d_x);
+        if (reductions[r] == DOT) {
+            status |= clSetKernelArg(partialKernel, argument++, sizeof(cl_mem), &d_y);
+        }
+        status |= clSetKernelArg(partialKernel, argument++, sizeof(cl_int), &n);
+        status |= clSetKernelArg(partialKernel, argument++, sizeof(cl_mem), &d_partials);
+        status |= clSetKernelArg(partialKernel, argument++, sizeof(cl_float) * BLAS1_WORK_GROUP_SIZE, NULL);
+        status |= clSetKernelArg(kernels[SUM], 0, sizeof(cl_mem), &d_partials);
+        status |= clSetKernelArg(kernels[SUM], 1, sizeof(cl_int), &groups);
+        status |= clSetKernelArg(kernels[SUM], 2, sizeof(cl_mem), &d_result);
+        status |= clSetKernelArg(kernels[SUM], 3, sizeof(cl_int), &squareRoot);
+        status |= clSetKernelArg(kernels[SUM], 4, sizeof(cl_float) * BLAS1_WORK_GROUP_SIZE, NULL);
+        if (CL_SUCCESS != status) {
+            cout << "Error in clSetKernelArg, " << reductionNames[r] << endl;
+            return status;
+        }
+        vector<long> timers;
+        for (int i = 0; i < BLAS1_ITERATIONS; i++) {
+            long time = launchBlas1Kernel(partialKernel, 1, globalWorkSize, localWorkSize, &status);
+            time += launchBlas1Kernel(kernels[SUM], 1, combineWorkSize, combineWorkSize, &status);
+            if (CL_SUCCESS != status) {
+                return status;
+            }
+            timers.push_back(time);
+        }
+        float result;
+        clEnqueueReadBuffer(commandQueue, d_result, CL_TRUE, 0, sizeof(cl_float), &result, 0, NULL, NULL);
+        double bytes = (reductions[r] == DOT ? 2.0 : 1.0) * datasize;
+        printBlas1Result(reductionNames[r], median(timers), bytes, blas1CloseTo(result, references[r]));
+    }
+
+    // iamax: (magnitude, index) pairs reduced the same way
+    status = clSetKernelArg(kernels[IAMAX], 0, sizeof(cl_mem), &d_x);
+    status |= clSetKernelArg(kernels[IAMAX], 1, sizeof(cl_int), &n);
+    status |= clSetKernelArg(kernels[IAMAX], 2, sizeof(cl_mem), &d_partials);
+    status |= clSetKernelArg(kernels[IAMAX], 3, sizeof(cl_mem), &d_partialIndices);
+    status |= clSetKernelArg(kernels[IAMAX], 4, sizeof(cl_float) * BLAS1_WORK_GROUP_SIZE, NULL);
+    status |= clSetKernelArg(kernels[IAMAX], 5, sizeof(cl_int) * BLAS1_WORK_GROUP_SIZE, NULL);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 0, sizeof(cl_mem), &d_partials);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 1, sizeof(cl_mem), &d_partialIndices);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 2, sizeof(cl_int), &groups);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 3, sizeof(cl_mem), &d_index);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 4, sizeof(cl_float) * BLAS1_WORK_GROUP_SIZE, NULL);
+    status |= clSetKernelArg(kernels[IAMAX_COMBINE], 5, sizeof(cl_int) * BLAS1_WORK_GROUP_SIZE, NULL);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, iamax" << endl;
+        return status;
+    }
+    vector<long> timers;
+    for (int i = 0; i < BLAS1_ITERATIONS; i++) {
+        long time = launchBlas1Kernel(kernels[IAMAX], 1, globalWorkSize, localWorkSize, &status);
+        time += launchBlas1Kernel(kernels[IAMAX_COMBINE], 1, combineWorkSize, combineWorkSize, &status);
+        if (CL_SUCCESS != status) {
+            return status;
         }
+        timers.push_back(time);
     }
+    cl_int index;
+    clEnqueueReadBuffer(commandQueue, d_index, CL_TRUE, 0, sizeof(cl_int), &index, 0, NULL, NULL);
+    printBlas1Result("iamax", median(timers), datasize, index == iamax);
+
+    // scal: x = alpha * x
+    status = clSetKernelArg(kernels[SCAL], 0, sizeof(cl_mem), &d_x);
+    status |= clSetKernelArg(kernels[SCAL], 1, sizeof(cl_float), &alpha);
+    status |= clSetKernelArg(kernels[SCAL], 2, sizeof(cl_int), &n);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, scal" << endl;
+        return status;
+    }
+    timers.clear();
+    for (int i = 0; i < BLAS1_ITERATIONS; i++) {
+        clEnqueueWriteBuffer(commandQueue, d_x, CL_TRUE, 0, datasize, A, 0, NULL, NULL);
+        timers.push_back(launchBlas1Kernel(kernels[SCAL], 1, globalWorkSize, localWorkSize, &status));
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+    }
+    vector<float> values(elements);
+    clEnqueueReadBuffer(commandQueue, d_x, CL_TRUE, 0, datasize, &values[0], 0, NULL, NULL);
+    bool valid = true;
+    for (int i = 0; i < elements && valid; i++) {
+        valid = blas1CloseTo(values[i], alpha * A[i]);
+    }
+    printBlas1Result("scal", median(timers), 2.0 * datasize, valid);
+
+    // Batched axpy: BLAS1_BATCHES problems on consecutive slices of A and B,
+    // each with its own alpha
+    int batchSize = max(1, n / BLAS1_BATCHES);
+    int batches = n / batchSize;
+    vector<float> alphas(batches);
+    for (int b = 0; b < batches; b++) {
+        alphas[b] = alpha + b;
+    }
+    cl_mem d_alphas = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float) * batches, &alphas[0], &status);
+    clEnqueueWriteBuffer(commandQueue, d_x, CL_TRUE, 0, datasize, A, 0, NULL, NULL);
+    status |= clSetKernelArg(kernels[AXPY_BATCHED], 0, sizeof(cl_mem), &d_x);
+    status |= clSetKernelArg(kernels[AXPY_BATCHED], 1, sizeof(cl_mem), &d_y);
+    status |= clSetKernelArg(kernels[AXPY_BATCHED], 2, sizeof(cl_mem), &d_alphas);
+    status |= clSetKernelArg(kernels[AXPY_BATCHED], 3, sizeof(cl_int), &batchSize);
+    if (CL_SUCCESS != status) {
+        cout << "Error in clSetKernelArg, axpyBatched" << endl;
+        return status;
+    }
+    size_t batchedWorkSize[2] = {BLAS1_WORK_GROUP_SIZE, (size_t) batches};
+    timers.clear();
+    for (int i = 0; i < BLAS1_ITERATIONS; i++) {
+        clEnqueueWriteBuffer(commandQueue, d_y, CL_TRUE, 0, datasize, B, 0, NULL, NULL);
+        timers.push_back(launchBlas1Kernel(kernels[AXPY_BATCHED], 2, batchedWorkSize, localWorkSize, &status));
+        if (CL_SUCCESS != status) {
+            return status;
+        }
+    }
+    clEnqueueReadBuffer(commandQueue, d_y, CL_TRUE, 0, datasize, &values[0], 0, NULL, NULL);
+    valid = true;
+    for (int i = 0; i < batches * batchSize && valid; i++) {
+        valid = blas1CloseTo(values[i], fmaf(alphas[i / batchSize], A[i], B[i]));
+    }
+    string axpyName = "axpyBatched (" + to_string(batches) + "x" + to_string(batchSize) + ")";
+    printBlas1Result(axpyName.c_str(), median(timers), 3.0 * sizeof(float) * batches * batchSize, valid);
+    cout << "\n";
+
+    for (int k = 0; k < NUMBER_OF_BLAS1_KERNELS; k++) {
+        clReleaseKernel(kernels[k]);
+    }
+    clReleaseMemObject(d_x);
+    clReleaseMemObject(d_y);
+    clReleaseMemObject(d_partials);
+    clReleaseMemObject(d_partialIndices);
+    clReleaseMemObject(d_result);
+    clReleaseMemObject(d_index);
+    clReleaseMemObject(d_alphas);
+    clReleaseProgram(blas1Program);
+    free(blas1Source);
+    return CL_SUCCESS;
+}
+
+// Records of the specialization benchmark that match
+bool sameValue(const float &value, const float &reference) {
+    return fabs(value - reference) <= 0.01f;
+}
+
+// A/B benchmark of the generic kernel against the variant specialized for the
+// current alpha (ALPHA)
+int benchmarkSpecialization() {
+    cl_int status;
+    map<string, string> constants;
+    // Hexadecimal float literal, so that the constant is exactly alpha
+    char alphaLiteral[64];
+    snprintf(alphaLiteral, sizeof(alphaLiteral), "%af", alpha);
+    constants["ALPHA"] = alphaLiteral;
+    cl_kernel specialized = getSpecializedKernel(specializationCache, context, devices[0], 1, (const char **) &source, "", "saxpy", constants, &status);
+    if (CL_SUCCESS != status) {
+        return status;
+    }
+
+    return runSpecializationBenchmark(kernel, specialized, runKernel, kernelEvent, readEvent1, C, elements, sameValue);
 }
 
 int main(int argc, char **argv) {
     if (argc > 2) {
         platformId = atoi(argv[1]);
-        elements = atoi(argv[2]);
+        elements = atol(argv[2]);
     } else {
-        cout << "Run: ./host-mxm <platformId> <elements>" << endl;
+        cout << "Run: ./host-mxm <platformId> <elements> [--specialize] [--seed <n>] [--storage] [--blas1] [--concurrent <problems>] [--queues <n>] [--kernel-report]" << endl;
         return -1;
     }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--specialize") == 0) {
+            specialize = true;
+        } else if (strcmp(argv[i], "--storage") == 0) {
+            storage = true;
+        } else if (strcmp(argv[i], "--blas1") == 0) {
+            blas1 = true;
+        } else if (strcmp(argv[i], "--kernel-report") == 0) {
+            kernelReport = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--concurrent") == 0 && i + 1 < argc) {
+            concurrentProblems = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--queues") == 0 && i + 1 < argc) {
+            numberOfQueues = max(1, atoi(argv[++i]));
+        } else {
+            cout << "Unknown option: " << argv[i] << endl;
+            return -1;
+        }
+    }
 
     cout << "OpenCL MxM " << endl;
     cout << "Number of Elements = " << elements << endl;
@@ -353,7 +844,14 @@ int main(int argc, char **argv) {
     if (openclInitialization() != CL_SUCCESS) {
         return -1;
     }
-    hostDataInitialization(elements);
+    if (chunkElements < (size_t) elements) {
+        cout << "Chunks of " << chunkElements << " elements (CL_DEVICE_MAX_MEM_ALLOC_SIZE = " << maxAllocationSize << " bytes)" << endl;
+    }
+    if ((specialize && !fitsOneLaunch("--specialize")) || (storage && !fitsOneLaunch("--storage")) || (blas1 && !fitsOneLaunch("--blas1"))
+        || (concurrentProblems > 0 && !fitsOneLaunch("--concurrent"))) {
+        return -1;
+    }
+    timeHostDataInitialization(hostDataInitialization, elements);
     if (allocateBuffersOnGPU() != CL_SUCCESS) {
         return -1;
     }
@@ -364,15 +862,17 @@ int main(int argc, char **argv) {
         readTime = 0;
 
         auto start_time = chrono::high_resolution_clock::now();
-        writeBuffer();
-        if (runKernel() != CL_SUCCESS) {
-            return -1;
+        for (size_t offset = 0; offset < (size_t) elements; offset += chunkElements) {
+            size_t count = min(chunkElements, elements - offset);
+            writeBuffer(offset, count);
+            if (runKernel(offset, count) != CL_SUCCESS) {
+                return -1;
+            }
+            writeTime += getTime(writeEvent1);
+            writeTime += getTime(writeEvent2);
+            readTime += getTime(readEvent1);
         }
         auto end_time = chrono::high_resolution_clock::now();
-        writeTime = getTime(writeEvent1);
-        writeTime += getTime(writeEvent2);
-        kernelTime = getTime(kernelEvent);
-        readTime = getTime(readEvent1);
 
         kernelTimers.push_back(kernelTime);
         writeTimers.push_back(writeTime);
@@ -391,7 +891,7 @@ int main(int argc, char **argv) {
 
         if (CHECK_RESULT) {
             bool valid = true;
-            for (int i = 0; i < elements; i++) {
+            for (long i = 0; i < elements; i++) {
                 if (abs(C[i] - ((alpha * A[i]) + B[i])) > 0.01f) {
                     cout << C[i] << "  != " << (alpha * A[i]) + B[i] << " ::IDX: " << i << endl;
                     valid = false;
@@ -408,6 +908,22 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (specialize && benchmarkSpecialization() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (storage && runStorageBenchmark() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (blas1 && runBlas1Suite() != CL_SUCCESS) {
+        return -1;
+    }
+
+    if (concurrentProblems > 0 && runConcurrent(concurrentProblems) != CL_SUCCESS) {
+        return -1;
+    }
+
     freeMemory();
 
     // Compute median
@@ -23,13 +23,29 @@
  * SOFTWARE.
  */
  
+// Building with -DALPHA=<value> specializes the kernel for one alpha; the alpha
+// argument is then ignored.
+#ifdef ALPHA
+#define SAXPY_ALPHA ALPHA
+#else
+#define SAXPY_ALPHA alpha
+#endif
+
+// Building with -DLONG_INDEX computes the global index in 64 bits, for chunks
+// of more than INT_MAX elements.
+#ifdef LONG_INDEX
+#define INDEX long
+#else
+#define INDEX int
+#endif
+
 __kernel void saxpy(__global uchar * a,
                     __global uchar * b,
                     __global uchar * c,
                     const float alpha)
 {
   float f_12, f_8, f_10;
-  int i_3;
+  INDEX i_3;
   ulong ul_9, ul_7, ul_11, ul_2, ul_1, ul_0;
   long l_4, l_5, l_6;
 
@@ -46,7 +62,7 @@ __kernel void saxpy(__global uchar * a,
   ul_9  =  ul_0 + l_6;
   f_10  =  *((__global float *) ul_9);
   ul_11  =  ul_2 + l_6;
-  f_12  =  fma(f_10, alpha, f_8);
+  f_12  =  fma(f_10, SAXPY_ALPHA, f_8);
   *((__global float *) ul_11)  =  f_12;
   return;
 }  //  kernel
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023, APT Group, Department of Computer Science,
+ * The University of Manchester.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Reduced-precision storage variants of saxpy. a, b and c are stored as half,
+// bfloat16 or int8 and the arithmetic is done in fp32. Half values are accessed
+// with vload_half/vstore_half, which do not need cl_khr_fp16. int8 values are
+// symmetrically quantized: value = q * scale, with one scale per array.
+
+float bf16ToFloat(ushort value)
+{
+    return as_float(((uint) value) << 16);
+}
+
+// Round to nearest even; NaN inputs are not expected
+ushort floatToBf16(float value)
+{
+    uint bits = as_uint(value);
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return (ushort) (bits >> 16);
+}
+
+__kernel void saxpyHalf(__global const half *a, __global const half *b, __global half *c, const float alpha)
+{
+    int i = get_global_id(0);
+    vstore_half_rte(fma(vload_half(i, a), alpha, vload_half(i, b)), i, c);
+}
+
+__kernel void saxpyBf16(__global const ushort *a, __global const ushort *b, __global ushort *c, const float alpha)
+{
+    int i = get_global_id(0);
+    c[i] = floatToBf16(fma(bf16ToFloat(a[i]), alpha, bf16ToFloat(b[i])));
+}
+
+__kernel void saxpyInt8(__global const char *a, __global const char *b, __global char *c, const float alpha, const float scaleA, const float scaleB, const float scaleC)
+{
+    int i = get_global_id(0);
+    float value = fma(a[i] * scaleA, alpha, b[i] * scaleB);
+    c[i] = convert_char_sat_rte(value / scaleC);
+}